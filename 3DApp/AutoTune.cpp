@@ -0,0 +1,254 @@
+#include "AutoTune.h"
+#include "CommandBuffer.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include "glm/gtc/matrix_transform.hpp"
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define RASTER_TUNE_CPUID
+#elif defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#define RASTER_TUNE_CPUID
+#endif
+
+namespace
+{
+    const int TUNE_TILE_SIZES[] = { 16, 32, 64, 128 };
+    // per candidate, the median of the timed ones counts
+    constexpr int TUNE_WARMUP_FRAMES = 2;
+    constexpr int TUNE_FRAMES = 5;
+
+    std::string Trim(const std::string& text)
+    {
+        const size_t first = text.find_first_not_of(" \t\r\n");
+        if (first == std::string::npos)
+            return std::string();
+        const size_t last = text.find_last_not_of(" \t\r\n");
+        return text.substr(first, last - first + 1);
+    }
+
+    void BuildSphere(Mesh& mesh, int rings, int segments)
+    {
+        const float pi = 3.14159265f;
+        for (int ring = 0; ring <= rings; ring++)
+        {
+            const float theta = pi * ring / rings;
+            for (int segment = 0; segment <= segments; segment++)
+            {
+                const float phi = 2.0f * pi * segment / segments;
+                mesh.mX.push_back(0.5f * std::sin(theta) * std::cos(phi));
+                mesh.mY.push_back(0.5f * std::cos(theta));
+                mesh.mZ.push_back(0.5f * std::sin(theta) * std::sin(phi));
+            }
+        }
+        for (int ring = 0; ring < rings; ring++)
+        {
+            for (int segment = 0; segment < segments; segment++)
+            {
+                const uint32_t a = ring * (segments + 1) + segment;
+                const uint32_t b = a + segments + 1;
+                mesh.mIndices.insert(mesh.mIndices.end(), { a, b, a + 1, a + 1, b, b + 1 });
+            }
+        }
+        mesh.ComputeBounds();
+    }
+
+    // lines of the cache file that aren't comments
+    std::vector<std::string> ReadEntries(const std::string& path)
+    {
+        std::vector<std::string> entries;
+        std::ifstream file(path);
+        std::string line;
+        while (std::getline(file, line))
+        {
+            line = Trim(line);
+            if (!line.empty() && line[0] != '#')
+                entries.push_back(line);
+        }
+        return entries;
+    }
+
+    bool ParseEntry(const std::string& line, std::string& key, TuneSettings& settings)
+    {
+        std::istringstream in(line);
+        in >> settings.mTileSize >> settings.mThreadCount >> settings.mFrameMs;
+        std::getline(in, key);
+        key = Trim(key);
+        return in && settings.mTileSize >= Rasterizer::MIN_TILE_SIZE && settings.mThreadCount >= 1;
+    }
+}
+
+std::string CpuModel()
+{
+    std::string model;
+#ifdef RASTER_TUNE_CPUID
+    // the brand string is 48 characters in three extended leaves
+    unsigned registers[12] = {};
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0x80000000);
+    if (static_cast<unsigned>(info[0]) >= 0x80000004)
+    {
+        for (int i = 0; i < 3; i++)
+            __cpuid(reinterpret_cast<int*>(registers + i * 4), 0x80000002 + i);
+    }
+#else
+    if (__get_cpuid_max(0x80000000, nullptr) >= 0x80000004)
+    {
+        for (unsigned i = 0; i < 3; i++)
+            __get_cpuid(0x80000002 + i, &registers[i * 4], &registers[i * 4 + 1], &registers[i * 4 + 2], &registers[i * 4 + 3]);
+    }
+#endif
+    char brand[sizeof(registers) + 1] = {};
+    std::memcpy(brand, registers, sizeof(registers));
+    model = brand;
+#else
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::string line;
+    while (model.empty() && std::getline(cpuinfo, line))
+    {
+        if (line.compare(0, 10, "model name") == 0 && line.find(':') != std::string::npos)
+            model = line.substr(line.find(':') + 1);
+    }
+#endif
+    model = Trim(model);
+    return model.empty() ? "unknown" : model;
+}
+
+std::string TuneKey(int width, int height)
+{
+    std::ostringstream key;
+    key << CpuModel() << ", " << std::max(1u, std::thread::hardware_concurrency()) << " threads, " << width << "x" << height;
+    return key.str();
+}
+
+TuneSettings CalibrateRasterizer(int width, int height)
+{
+    Mesh sphere;
+    BuildSphere(sphere, 200, 400);
+    Mesh shell;
+    BuildSphere(shell, 50, 100);
+
+    ImageTarget canvas;
+    Rasterizer rast(&canvas);
+    rast.Resize(width, height);
+    rast.proj = glm::perspective(glm::radians(45.0f), static_cast<float>(width) / height, 0.1f, 100.0f);
+    rast.invProj = glm::inverse(rast.proj);
+    CommandBuffer commands;
+
+    // the same frames for every candidate
+    auto render = [&](int frame) {
+        const glm::mat4 model = glm::rotate(glm::scale(glm::mat4(1.0f), glm::vec3(0.6f)), 0.05f * frame,
+            glm::normalize(glm::vec3(1.0f, 1.0f, 0.0f)));
+        commands.Reset();
+        commands.BindMesh(&sphere);
+        commands.Draw(model);
+        commands.SetBlendMode(BlendMode::WeightedBlended);
+        commands.BindMesh(&shell);
+        commands.Draw(glm::scale(model, glm::vec3(1.4f)), Color(120, 180, 255, 90));
+        commands.Draw(glm::scale(model, glm::vec3(1.8f)), Color(255, 160, 60, 60));
+        const auto start = std::chrono::steady_clock::now();
+        commands.Submit(rast);
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    // powers of two up to every hardware thread, where SMT may or may not pay off
+    const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<unsigned> threadCounts;
+    for (unsigned count = 1; count < cores; count *= 2)
+        threadCounts.push_back(count);
+    threadCounts.push_back(cores);
+
+    TuneSettings best;
+    best.mFrameMs = std::numeric_limits<double>::max();
+    for (unsigned threadCount : threadCounts)
+    {
+        rast.SetThreadCount(threadCount);
+        for (int tileSize : TUNE_TILE_SIZES)
+        {
+            rast.SetTileSize(tileSize);
+            for (int frame = 0; frame < TUNE_WARMUP_FRAMES; frame++)
+                render(frame);
+            std::vector<double> frameMs;
+            for (int frame = 0; frame < TUNE_FRAMES; frame++)
+                frameMs.push_back(render(TUNE_WARMUP_FRAMES + frame));
+            std::sort(frameMs.begin(), frameMs.end());
+            const double median = frameMs[frameMs.size() / 2];
+            if (median < best.mFrameMs)
+            {
+                best.mTileSize = tileSize;
+                best.mThreadCount = threadCount;
+                best.mFrameMs = median;
+            }
+        }
+    }
+    return best;
+}
+
+bool LoadTuneSettings(const std::string& path, const std::string& key, TuneSettings& settings)
+{
+    for (const std::string& line : ReadEntries(path))
+    {
+        std::string entryKey;
+        TuneSettings entry;
+        if (ParseEntry(line, entryKey, entry) && entryKey == key)
+        {
+            settings = entry;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool SaveTuneSettings(const std::string& path, const std::string& key, const TuneSettings& settings)
+{
+    std::vector<std::string> entries = ReadEntries(path);
+    entries.erase(std::remove_if(entries.begin(), entries.end(), [&](const std::string& line) {
+        std::string entryKey;
+        TuneSettings entry;
+        return !ParseEntry(line, entryKey, entry) || entryKey == key;
+    }), entries.end());
+    std::ostringstream entry;
+    entry.setf(std::ios::fixed);
+    entry.precision(3);
+    entry << settings.mTileSize << " " << settings.mThreadCount << " " << settings.mFrameMs << " " << key;
+    entries.push_back(entry.str());
+
+    std::ofstream file(path, std::ios::trunc);
+    if (!file)
+    {
+        std::cerr << "AutoTune: " << path << ": cannot open for writing" << std::endl;
+        return false;
+    }
+    file << "# tile size, thread count, calibration frame ms, machine\n";
+    for (const std::string& line : entries)
+        file << line << "\n";
+    if (!file)
+    {
+        std::cerr << "AutoTune: " << path << ": write failed" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+TuneSettings AutoTune(Rasterizer& rast, const std::string& cachePath, bool recalibrate)
+{
+    const std::string key = TuneKey(rast.Width(), rast.Height());
+    TuneSettings settings;
+    if (recalibrate || !LoadTuneSettings(cachePath, key, settings))
+    {
+        settings = CalibrateRasterizer(rast.Width(), rast.Height());
+        SaveTuneSettings(cachePath, key, settings);
+    }
+    rast.SetTileSize(settings.mTileSize);
+    rast.SetThreadCount(settings.mThreadCount);
+    return settings;
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <string>
+#include "Rasterizer.h"
+
+// Picks the rasterizer settings that depend on the host (cache sizes, core count, SMT)
+// by measuring instead of guessing: CalibrateRasterizer() renders a short workload, a
+// dense sphere under two translucent shells, with every candidate tile size and thread
+// count and keeps the fastest. Results are cached in a text file, one line per machine:
+//   <tile size> <thread count> <frame ms> <key>
+// where the key is TuneKey(), so a cache file can be shared between machines.
+constexpr char DEFAULT_TUNE_CACHE[] = "raster3d_tuning.txt";
+
+struct TuneSettings
+{
+    int mTileSize = Rasterizer::DEFAULT_TILE_SIZE;
+    unsigned mThreadCount = 1;
+    double mFrameMs = 0.0; // of the calibration workload
+};
+
+// the processor's brand string, "unknown" where it can't be read
+std::string CpuModel();
+// the CPU model, hardware thread count and frame size the settings were measured for
+std::string TuneKey(int width, int height);
+
+// Takes about a second on a desktop CPU, longer the more cores there are to try.
+TuneSettings CalibrateRasterizer(int width, int height);
+
+// False if the file has no entry for `key`; a missing file isn't an error.
+bool LoadTuneSettings(const std::string& path, const std::string& key, TuneSettings& settings);
+// Replaces the entry for `key`, other entries stay. Prints the reason to std::cerr and
+// returns false when the file can't be written.
+bool SaveTuneSettings(const std::string& path, const std::string& key, const TuneSettings& settings);
+
+// Gives `rast` the cached settings for this machine at its current size, calibrating and
+// caching them first if there are none or `recalibrate` is set.
+TuneSettings AutoTune(Rasterizer& rast, const std::string& cachePath = DEFAULT_TUNE_CACHE, bool recalibrate = false);
@@ -0,0 +1,587 @@
+#include "Bvh.h"
+#include <algorithm>
+#include <cfloat>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RASTER_USE_SSE 1
+#include <emmintrin.h>
+#endif
+
+constexpr uint32_t Bvh::EMPTY;
+constexpr uint32_t Bvh::OBJECT_BIT;
+
+namespace
+{
+    const int SAH_BINS = 16;
+
+    Aabb EmptyBox()
+    {
+        Aabb box;
+        box.mMin = glm::vec3(FLT_MAX);
+        box.mMax = glm::vec3(-FLT_MAX);
+        return box;
+    }
+
+    void Grow(Aabb& box, const Aabb& other)
+    {
+        box.mMin = glm::min(box.mMin, other.mMin);
+        box.mMax = glm::max(box.mMax, other.mMax);
+    }
+
+    float HalfArea(const Aabb& box)
+    {
+        const glm::vec3 e = glm::max(box.mMax - box.mMin, glm::vec3(0.0f));
+        return e.x * e.y + e.y * e.z + e.z * e.x;
+    }
+
+    glm::vec3 Centroid(const Aabb& box)
+    {
+        return (box.mMin + box.mMax) * 0.5f;
+    }
+
+    // Splits objects[0, count) in two where the surface area heuristic is cheapest, with
+    // the centroids binned along each axis; returns the size of the first part and the
+    // bounds of both. Falls back to halving when all the centroids are in one place.
+    size_t SplitSah(uint32_t* objects, size_t count, const std::vector<Aabb>& bounds,
+        const std::vector<glm::vec3>& centroids, Aabb& firstBounds, Aabb& secondBounds)
+    {
+        glm::vec3 lo = centroids[objects[0]];
+        glm::vec3 hi = lo;
+        for (size_t i = 1; i < count; i++)
+        {
+            lo = glm::min(lo, centroids[objects[i]]);
+            hi = glm::max(hi, centroids[objects[i]]);
+        }
+        const glm::vec3 extent = hi - lo;
+        const glm::vec3 scale(extent.x > 0.0f ? SAH_BINS / extent.x : 0.0f,
+            extent.y > 0.0f ? SAH_BINS / extent.y : 0.0f, extent.z > 0.0f ? SAH_BINS / extent.z : 0.0f);
+        auto binOf = [&](uint32_t object, int axis) {
+            return std::min(static_cast<int>((centroids[object][axis] - lo[axis]) * scale[axis]), SAH_BINS - 1);
+        };
+
+        // all three axes in one pass over the objects
+        Aabb binBounds[3][SAH_BINS];
+        size_t binCount[3][SAH_BINS] = {};
+        for (int axis = 0; axis < 3; axis++)
+        {
+            for (Aabb& box : binBounds[axis])
+                box = EmptyBox();
+        }
+        for (size_t i = 0; i < count; i++)
+        {
+            const Aabb& box = bounds[objects[i]];
+            for (int axis = 0; axis < 3; axis++)
+            {
+                const int bin = binOf(objects[i], axis);
+                binCount[axis][bin]++;
+                Grow(binBounds[axis][bin], box);
+            }
+        }
+
+        float bestCost = FLT_MAX;
+        int bestAxis = -1;
+        int bestBin = 0;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            if (extent[axis] <= 0.0f)
+                continue;
+            // areas of everything right of each split, then sweep from the left
+            float rightArea[SAH_BINS];
+            size_t rightCount[SAH_BINS];
+            Aabb right = EmptyBox();
+            size_t rightTotal = 0;
+            for (int bin = SAH_BINS - 1; bin > 0; bin--)
+            {
+                Grow(right, binBounds[axis][bin]);
+                rightTotal += binCount[axis][bin];
+                rightArea[bin] = HalfArea(right);
+                rightCount[bin] = rightTotal;
+            }
+            Aabb left = EmptyBox();
+            size_t leftTotal = 0;
+            for (int bin = 1; bin < SAH_BINS; bin++)
+            {
+                Grow(left, binBounds[axis][bin - 1]);
+                leftTotal += binCount[axis][bin - 1];
+                if (leftTotal == 0 || rightCount[bin] == 0)
+                    continue;
+                const float cost = HalfArea(left) * leftTotal + rightArea[bin] * rightCount[bin];
+                if (cost < bestCost)
+                {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestBin = bin;
+                }
+            }
+        }
+
+        firstBounds = EmptyBox();
+        secondBounds = EmptyBox();
+        if (bestAxis < 0)
+        {
+            const size_t half = count / 2;
+            for (size_t i = 0; i < count; i++)
+                Grow(i < half ? firstBounds : secondBounds, bounds[objects[i]]);
+            return half;
+        }
+        for (int bin = 0; bin < SAH_BINS; bin++)
+            Grow(bin < bestBin ? firstBounds : secondBounds, binBounds[bestAxis][bin]);
+        uint32_t* middle = std::partition(objects, objects + count, [&](uint32_t object) { return binOf(object, bestAxis) < bestBin; });
+        return static_cast<size_t>(middle - objects);
+    }
+
+    struct RayTest
+    {
+        glm::vec3 mOrigin;
+        glm::vec3 mInverse;
+    };
+
+    // per child, whether the ray enters its box between 0 and `limit`, and where
+    int RayMask(const float* minX, const float* minY, const float* minZ,
+        const float* maxX, const float* maxY, const float* maxZ,
+        const RayTest& ray, float limit, float* entry)
+    {
+#ifdef RASTER_USE_SSE
+        const __m128 ox = _mm_set1_ps(ray.mOrigin.x), oy = _mm_set1_ps(ray.mOrigin.y), oz = _mm_set1_ps(ray.mOrigin.z);
+        const __m128 ix = _mm_set1_ps(ray.mInverse.x), iy = _mm_set1_ps(ray.mInverse.y), iz = _mm_set1_ps(ray.mInverse.z);
+        const __m128 x0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(minX), ox), ix);
+        const __m128 x1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(maxX), ox), ix);
+        const __m128 y0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(minY), oy), iy);
+        const __m128 y1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(maxY), oy), iy);
+        const __m128 z0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(minZ), oz), iz);
+        const __m128 z1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(maxZ), oz), iz);
+        const __m128 near = _mm_max_ps(_mm_max_ps(_mm_min_ps(x0, x1), _mm_min_ps(y0, y1)), _mm_max_ps(_mm_min_ps(z0, z1), _mm_setzero_ps()));
+        const __m128 far = _mm_min_ps(_mm_min_ps(_mm_max_ps(x0, x1), _mm_max_ps(y0, y1)), _mm_min_ps(_mm_max_ps(z0, z1), _mm_set1_ps(limit)));
+        _mm_storeu_ps(entry, near);
+        return _mm_movemask_ps(_mm_cmple_ps(near, far));
+#else
+        int mask = 0;
+        for (int i = 0; i < 4; i++)
+        {
+            const float x0 = (minX[i] - ray.mOrigin.x) * ray.mInverse.x, x1 = (maxX[i] - ray.mOrigin.x) * ray.mInverse.x;
+            const float y0 = (minY[i] - ray.mOrigin.y) * ray.mInverse.y, y1 = (maxY[i] - ray.mOrigin.y) * ray.mInverse.y;
+            const float z0 = (minZ[i] - ray.mOrigin.z) * ray.mInverse.z, z1 = (maxZ[i] - ray.mOrigin.z) * ray.mInverse.z;
+            entry[i] = std::max(std::max(std::min(x0, x1), std::min(y0, y1)), std::max(std::min(z0, z1), 0.0f));
+            const float exit = std::min(std::min(std::max(x0, x1), std::max(y0, y1)), std::min(std::max(z0, z1), limit));
+            if (entry[i] <= exit)
+                mask |= 1 << i;
+        }
+        return mask;
+#endif
+    }
+}
+
+uint32_t Bvh::NewNode(uint32_t parent)
+{
+    Node node;
+    for (int i = 0; i < 4; i++)
+    {
+        node.mMinX[i] = node.mMinY[i] = node.mMinZ[i] = FLT_MAX;
+        node.mMaxX[i] = node.mMaxY[i] = node.mMaxZ[i] = -FLT_MAX;
+        node.mChild[i] = EMPTY;
+        node.mPadding[i % 3] = 0;
+    }
+    node.mParent = parent;
+    mNodes.push_back(node);
+    return static_cast<uint32_t>(mNodes.size() - 1);
+}
+
+void Bvh::SetChild(uint32_t node, int slot, uint32_t child, const Aabb& bounds)
+{
+    Node& n = mNodes[node];
+    n.mChild[slot] = child;
+    n.mMinX[slot] = bounds.mMin.x;
+    n.mMinY[slot] = bounds.mMin.y;
+    n.mMinZ[slot] = bounds.mMin.z;
+    n.mMaxX[slot] = bounds.mMax.x;
+    n.mMaxY[slot] = bounds.mMax.y;
+    n.mMaxZ[slot] = bounds.mMax.z;
+    if (child == EMPTY)
+        return;
+    if (child & OBJECT_BIT)
+        mObjectSlot[child & ~OBJECT_BIT] = node * 4 + slot;
+    else
+        mNodes[child].mParent = node * 4 + slot;
+}
+
+Aabb Bvh::ChildBounds(uint32_t node, int slot) const
+{
+    const Node& n = mNodes[node];
+    Aabb box;
+    box.mMin = glm::vec3(n.mMinX[slot], n.mMinY[slot], n.mMinZ[slot]);
+    box.mMax = glm::vec3(n.mMaxX[slot], n.mMaxY[slot], n.mMaxZ[slot]);
+    return box;
+}
+
+Aabb Bvh::NodeBounds(uint32_t node) const
+{
+    Aabb box = EmptyBox();
+    for (int slot = 0; slot < 4; slot++)
+    {
+        if (mNodes[node].mChild[slot] != EMPTY)
+            Grow(box, ChildBounds(node, slot));
+    }
+    return box;
+}
+
+void Bvh::Clear()
+{
+    mNodes.clear();
+    mObjectBounds.clear();
+    mObjectSlot.clear();
+    mFreeObjects.clear();
+}
+
+void Bvh::Build(const Aabb* bounds, size_t count)
+{
+    Clear();
+    if (count == 0)
+        return;
+    mObjectBounds.assign(bounds, bounds + count);
+    mObjectSlot.assign(count, EMPTY);
+    mNodes.reserve(count / 2 + 1);
+
+    std::vector<uint32_t> objects(count);
+    std::vector<glm::vec3> centroids(count);
+    Aabb all = EmptyBox();
+    for (size_t i = 0; i < count; i++)
+    {
+        objects[i] = static_cast<uint32_t>(i);
+        centroids[i] = Centroid(bounds[i]);
+        Grow(all, bounds[i]);
+    }
+    BuildNode(NewNode(EMPTY), objects.data(), count, all, centroids);
+}
+
+void Bvh::BuildNode(uint32_t node, uint32_t* objects, size_t count, const Aabb& bounds, const std::vector<glm::vec3>& centroids)
+{
+    // split the largest part in two until there are four, one per child
+    struct Part
+    {
+        uint32_t* mObjects;
+        size_t mCount;
+        Aabb mBounds;
+    };
+    Part parts[4];
+    int partCount = 1;
+    parts[0] = { objects, count, bounds };
+    while (partCount < 4)
+    {
+        int largest = -1;
+        for (int p = 0; p < partCount; p++)
+        {
+            if (parts[p].mCount > 1 && (largest < 0 || HalfArea(parts[p].mBounds) > HalfArea(parts[largest].mBounds)))
+                largest = p;
+        }
+        if (largest < 0)
+            break;
+
+        Part& part = parts[largest];
+        Part& second = parts[partCount++];
+        const size_t split = SplitSah(part.mObjects, part.mCount, mObjectBounds, centroids, part.mBounds, second.mBounds);
+        second.mObjects = part.mObjects + split;
+        second.mCount = part.mCount - split;
+        part.mCount = split;
+    }
+
+    for (int p = 0; p < partCount; p++)
+    {
+        if (parts[p].mCount == 1)
+        {
+            SetChild(node, p, OBJECT_BIT | parts[p].mObjects[0], parts[p].mBounds);
+        }
+        else
+        {
+            const uint32_t child = NewNode(node * 4 + p);
+            SetChild(node, p, child, parts[p].mBounds);
+            BuildNode(child, parts[p].mObjects, parts[p].mCount, parts[p].mBounds, centroids);
+        }
+    }
+}
+
+uint32_t Bvh::Insert(const Aabb& bounds)
+{
+    uint32_t object;
+    if (!mFreeObjects.empty())
+    {
+        object = mFreeObjects.back();
+        mFreeObjects.pop_back();
+        mObjectBounds[object] = bounds;
+    }
+    else
+    {
+        object = static_cast<uint32_t>(mObjectBounds.size());
+        mObjectBounds.push_back(bounds);
+        mObjectSlot.push_back(EMPTY);
+    }
+    if (mNodes.empty())
+        NewNode(EMPTY);
+
+    // down the children whose surface area grows least, growing their boxes on the way
+    uint32_t node = 0;
+    for (;;)
+    {
+        const Node& n = mNodes[node];
+        int best = -1;
+        float bestGrowth = FLT_MAX;
+        float bestArea = FLT_MAX;
+        for (int slot = 0; slot < 4; slot++)
+        {
+            if (n.mChild[slot] == EMPTY)
+            {
+                SetChild(node, slot, OBJECT_BIT | object, bounds);
+                return object;
+            }
+            Aabb grown = ChildBounds(node, slot);
+            const float area = HalfArea(grown);
+            Grow(grown, bounds);
+            const float growth = HalfArea(grown) - area;
+            if (growth < bestGrowth || (growth == bestGrowth && area < bestArea))
+            {
+                best = slot;
+                bestGrowth = growth;
+                bestArea = area;
+            }
+        }
+
+        const uint32_t child = n.mChild[best];
+        Aabb grown = ChildBounds(node, best);
+        Grow(grown, bounds);
+        if (child & OBJECT_BIT)
+        {
+            // two objects under a new node where the one object was
+            const uint32_t pair = NewNode(node * 4 + best);
+            SetChild(pair, 0, child, mObjectBounds[child & ~OBJECT_BIT]);
+            SetChild(pair, 1, OBJECT_BIT | object, bounds);
+            SetChild(node, best, pair, grown);
+            return object;
+        }
+        SetChild(node, best, child, grown);
+        node = child;
+    }
+}
+
+void Bvh::Remove(uint32_t object)
+{
+    const uint32_t slot = mObjectSlot[object];
+    if (slot == EMPTY)
+        return;
+    // the boxes above stay as they are until the next Refit()
+    SetChild(slot / 4, static_cast<int>(slot % 4), EMPTY, EmptyBox());
+    mObjectSlot[object] = EMPTY;
+    mFreeObjects.push_back(object);
+}
+
+void Bvh::SetBounds(uint32_t object, const Aabb& bounds)
+{
+    mObjectBounds[object] = bounds;
+}
+
+void Bvh::Refit()
+{
+    for (size_t object = 0; object < mObjectBounds.size(); object++)
+    {
+        const uint32_t slot = mObjectSlot[object];
+        if (slot != EMPTY)
+            SetChild(slot / 4, static_cast<int>(slot % 4), OBJECT_BIT | static_cast<uint32_t>(object), mObjectBounds[object]);
+    }
+    // children come after their parents, so backwards is bottom up
+    for (size_t node = mNodes.size(); node-- > 1;)
+    {
+        const uint32_t parent = mNodes[node].mParent;
+        SetChild(parent / 4, static_cast<int>(parent % 4), static_cast<uint32_t>(node), NodeBounds(static_cast<uint32_t>(node)));
+    }
+}
+
+void Bvh::CollectSubtree(uint32_t node, std::vector<uint32_t>& objects) const
+{
+    for (int slot = 0; slot < 4; slot++)
+    {
+        const uint32_t child = mNodes[node].mChild[slot];
+        if (child == EMPTY)
+            continue;
+        if (child & OBJECT_BIT)
+            objects.push_back(child & ~OBJECT_BIT);
+        else
+            CollectSubtree(child, objects);
+    }
+}
+
+void Bvh::QueryFrustum(const Frustum& frustum, std::vector<uint32_t>& objects) const
+{
+    if (mNodes.empty())
+        return;
+
+    std::vector<uint32_t> stack(1, 0);
+    while (!stack.empty())
+    {
+        const uint32_t node = stack.back();
+        stack.pop_back();
+        const Node& n = mNodes[node];
+
+        // a child is culled if its corner furthest along a plane's normal is outside,
+        // and entirely inside if its nearest corner is inside every plane
+        int visible, inside;
+#ifdef RASTER_USE_SSE
+        const __m128 minX = _mm_loadu_ps(n.mMinX), minY = _mm_loadu_ps(n.mMinY), minZ = _mm_loadu_ps(n.mMinZ);
+        const __m128 maxX = _mm_loadu_ps(n.mMaxX), maxY = _mm_loadu_ps(n.mMaxY), maxZ = _mm_loadu_ps(n.mMaxZ);
+        __m128 outsideAny = _mm_setzero_ps();
+        __m128 outsideNone = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (const Plane& plane : frustum.mPlanes)
+        {
+            const __m128 nx = _mm_set1_ps(plane.mNormal.x), ny = _mm_set1_ps(plane.mNormal.y), nz = _mm_set1_ps(plane.mNormal.z);
+            const __m128 d = _mm_set1_ps(plane.mDistance);
+            const __m128 farX = plane.mNormal.x >= 0.0f ? maxX : minX, nearX = plane.mNormal.x >= 0.0f ? minX : maxX;
+            const __m128 farY = plane.mNormal.y >= 0.0f ? maxY : minY, nearY = plane.mNormal.y >= 0.0f ? minY : maxY;
+            const __m128 farZ = plane.mNormal.z >= 0.0f ? maxZ : minZ, nearZ = plane.mNormal.z >= 0.0f ? minZ : maxZ;
+            const __m128 farDistance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, farX), _mm_mul_ps(ny, farY)), _mm_add_ps(_mm_mul_ps(nz, farZ), d));
+            const __m128 nearDistance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nearX), _mm_mul_ps(ny, nearY)), _mm_add_ps(_mm_mul_ps(nz, nearZ), d));
+            outsideAny = _mm_or_ps(outsideAny, _mm_cmplt_ps(farDistance, _mm_setzero_ps()));
+            outsideNone = _mm_and_ps(outsideNone, _mm_cmpge_ps(nearDistance, _mm_setzero_ps()));
+        }
+        visible = ~_mm_movemask_ps(outsideAny) & 0xf;
+        inside = _mm_movemask_ps(outsideNone);
+#else
+        visible = 0xf;
+        inside = 0xf;
+        for (const Plane& plane : frustum.mPlanes)
+        {
+            for (int i = 0; i < 4; i++)
+            {
+                const float farDistance = plane.SignedDistance(glm::vec3(
+                    plane.mNormal.x >= 0.0f ? n.mMaxX[i] : n.mMinX[i],
+                    plane.mNormal.y >= 0.0f ? n.mMaxY[i] : n.mMinY[i],
+                    plane.mNormal.z >= 0.0f ? n.mMaxZ[i] : n.mMinZ[i]));
+                const float nearDistance = plane.SignedDistance(glm::vec3(
+                    plane.mNormal.x >= 0.0f ? n.mMinX[i] : n.mMaxX[i],
+                    plane.mNormal.y >= 0.0f ? n.mMinY[i] : n.mMaxY[i],
+                    plane.mNormal.z >= 0.0f ? n.mMinZ[i] : n.mMaxZ[i]));
+                if (farDistance < 0.0f)
+                    visible &= ~(1 << i);
+                if (nearDistance < 0.0f)
+                    inside &= ~(1 << i);
+            }
+        }
+#endif
+
+        for (int slot = 0; slot < 4; slot++)
+        {
+            const uint32_t child = n.mChild[slot];
+            if (child == EMPTY || !(visible & (1 << slot)))
+                continue;
+            if (child & OBJECT_BIT)
+                objects.push_back(child & ~OBJECT_BIT);
+            else if (inside & (1 << slot))
+                CollectSubtree(child, objects);
+            else
+                stack.push_back(child);
+        }
+    }
+}
+
+void Bvh::QueryBox(const Aabb& box, std::vector<uint32_t>& objects) const
+{
+    if (mNodes.empty())
+        return;
+
+    std::vector<uint32_t> stack(1, 0);
+    while (!stack.empty())
+    {
+        const uint32_t node = stack.back();
+        stack.pop_back();
+        const Node& n = mNodes[node];
+
+        int overlap;
+#ifdef RASTER_USE_SSE
+        const __m128 x = _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(n.mMinX), _mm_set1_ps(box.mMax.x)), _mm_cmpge_ps(_mm_loadu_ps(n.mMaxX), _mm_set1_ps(box.mMin.x)));
+        const __m128 y = _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(n.mMinY), _mm_set1_ps(box.mMax.y)), _mm_cmpge_ps(_mm_loadu_ps(n.mMaxY), _mm_set1_ps(box.mMin.y)));
+        const __m128 z = _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(n.mMinZ), _mm_set1_ps(box.mMax.z)), _mm_cmpge_ps(_mm_loadu_ps(n.mMaxZ), _mm_set1_ps(box.mMin.z)));
+        overlap = _mm_movemask_ps(_mm_and_ps(_mm_and_ps(x, y), z));
+#else
+        overlap = 0;
+        for (int i = 0; i < 4; i++)
+        {
+            if (n.mMinX[i] <= box.mMax.x && n.mMaxX[i] >= box.mMin.x
+                && n.mMinY[i] <= box.mMax.y && n.mMaxY[i] >= box.mMin.y
+                && n.mMinZ[i] <= box.mMax.z && n.mMaxZ[i] >= box.mMin.z)
+                overlap |= 1 << i;
+        }
+#endif
+
+        for (int slot = 0; slot < 4; slot++)
+        {
+            const uint32_t child = n.mChild[slot];
+            if (child == EMPTY || !(overlap & (1 << slot)))
+                continue;
+            if (child & OBJECT_BIT)
+                objects.push_back(child & ~OBJECT_BIT);
+            else
+                stack.push_back(child);
+        }
+    }
+}
+
+uint32_t Bvh::Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance,
+    float* distance, const std::function<float(uint32_t, float)>& exact) const
+{
+    uint32_t hit = INVALID_OBJECT;
+    float best = maxDistance;
+    if (mNodes.empty())
+        return hit;
+
+    RayTest ray;
+    ray.mOrigin = origin;
+    ray.mInverse = 1.0f / direction;
+
+    // nearest first, so boxes further than the best hit so far are skipped
+    struct Entry
+    {
+        uint32_t mNode;
+        float mDistance;
+    };
+    std::vector<Entry> stack(1, Entry{ 0, 0.0f });
+    while (!stack.empty())
+    {
+        const Entry entry = stack.back();
+        stack.pop_back();
+        if (entry.mDistance > best)
+            continue;
+        const Node& n = mNodes[entry.mNode];
+
+        float entries[4];
+        const int mask = RayMask(n.mMinX, n.mMinY, n.mMinZ, n.mMaxX, n.mMaxY, n.mMaxZ, ray, best, entries);
+        Entry children[4];
+        int childCount = 0;
+        for (int slot = 0; slot < 4; slot++)
+        {
+            const uint32_t child = n.mChild[slot];
+            if (child == EMPTY || !(mask & (1 << slot)) || entries[slot] > best)
+                continue;
+            if (child & OBJECT_BIT)
+            {
+                const uint32_t object = child & ~OBJECT_BIT;
+                const float t = exact ? exact(object, entries[slot]) : entries[slot];
+                if (t >= 0.0f && t <= best)
+                {
+                    best = t;
+                    hit = object;
+                }
+            }
+            else
+            {
+                children[childCount++] = { child, entries[slot] };
+            }
+        }
+        // furthest pushed first
+        for (int i = 1; i < childCount; i++)
+        {
+            for (int j = i; j > 0 && children[j].mDistance > children[j - 1].mDistance; j--)
+                std::swap(children[j], children[j - 1]);
+        }
+        stack.insert(stack.end(), children, children + childCount);
+    }
+
+    if (distance && hit != INVALID_OBJECT)
+        *distance = best;
+    return hit;
+}
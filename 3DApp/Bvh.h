@@ -0,0 +1,81 @@
+#pragma once
+#include <vector>
+#include <functional>
+#include <cstddef>
+#include <cstdint>
+#include "glm/glm.hpp"
+#include "Mesh.h"
+#include "Frustum.h"
+
+constexpr uint32_t INVALID_OBJECT = 0xffffffffu;
+
+// Bounding volume hierarchy over object boxes, for culling and picking many objects
+// without testing each one. Nodes have four children each, stored as SoA boxes so one
+// node is tested against a frustum, ray or box with 4-wide SIMD. Build() splits by the
+// surface area heuristic, which is what static content should use. Moving objects are
+// handled by SetBounds() + Refit(), which keeps the tree and just regrows its boxes, and
+// Insert() adds objects without a rebuild; both let the tree get worse than a fresh
+// Build() over time.
+class Bvh
+{
+public:
+    // replaces the contents, the objects get ids 0 to count - 1
+    void Build(const Aabb* bounds, size_t count);
+    void Clear();
+
+    // id of the new object, reusing removed ones
+    uint32_t Insert(const Aabb& bounds);
+    void Remove(uint32_t object);
+    // only stores the box, Refit() grows or shrinks the nodes to match
+    void SetBounds(uint32_t object, const Aabb& bounds);
+    void Refit();
+
+    // objects whose box is at least partly inside, in no particular order, appended
+    void QueryFrustum(const Frustum& frustum, std::vector<uint32_t>& objects) const;
+    void QueryBox(const Aabb& box, std::vector<uint32_t>& objects) const;
+    // Nearest object whose box the ray hits within `maxDistance`, in units of `direction`,
+    // or INVALID_OBJECT. `exact`, if given, refines a box hit: it gets the object and the
+    // distance to its box, and returns the distance to the object itself or a negative
+    // value if the ray misses it.
+    uint32_t Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance,
+        float* distance = nullptr, const std::function<float(uint32_t, float)>& exact = nullptr) const;
+
+    size_t ObjectCount() const { return mObjectBounds.size() - mFreeObjects.size(); }
+    size_t NodeCount() const { return mNodes.size(); }
+    const Aabb& Bounds(uint32_t object) const { return mObjectBounds[object]; }
+
+private:
+    static constexpr uint32_t EMPTY = 0xffffffffu;
+    static constexpr uint32_t OBJECT_BIT = 0x80000000u;
+
+    struct Node
+    {
+        // boxes of the four children
+        float mMinX[4], mMinY[4], mMinZ[4];
+        float mMaxX[4], mMaxY[4], mMaxZ[4];
+        // EMPTY, OBJECT_BIT | object id, or a node index; EMPTY has OBJECT_BIT set too
+        uint32_t mChild[4];
+        uint32_t mParent; // node * 4 + child slot, EMPTY for the root
+        uint32_t mPadding[3];
+    };
+
+    std::vector<Node> mNodes; // children always come after their parent
+    std::vector<Aabb> mObjectBounds;
+    std::vector<uint32_t> mObjectSlot; // node * 4 + child slot, EMPTY for removed objects
+    std::vector<uint32_t> mFreeObjects;
+
+    uint32_t NewNode(uint32_t parent);
+    void SetChild(uint32_t node, int slot, uint32_t child, const Aabb& bounds);
+    Aabb ChildBounds(uint32_t node, int slot) const;
+    Aabb NodeBounds(uint32_t node) const;
+    void BuildNode(uint32_t node, uint32_t* objects, size_t count, const Aabb& bounds, const std::vector<glm::vec3>& centroids);
+    void CollectSubtree(uint32_t node, std::vector<uint32_t>& objects) const;
+};
+
+inline Aabb SphereBounds(const BoundingSphere& sphere)
+{
+    Aabb box;
+    box.mMin = sphere.mCenter - glm::vec3(sphere.mRadius);
+    box.mMax = sphere.mCenter + glm::vec3(sphere.mRadius);
+    return box;
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <cstdint>
+
+// 8 bit RGBA color, laid out like the rasterizer's color buffer.
+struct Color
+{
+    uint8_t r;
+    uint8_t g;
+    uint8_t b;
+    uint8_t a;
+
+    Color() : r(0), g(0), b(0), a(255) {}
+    Color(uint8_t red, uint8_t green, uint8_t blue, uint8_t alpha = 255) : r(red), g(green), b(blue), a(alpha) {}
+
+    static const Color Black;
+    static const Color White;
+    static const Color Red;
+    static const Color Green;
+    static const Color Blue;
+    static const Color Yellow;
+    static const Color Magenta;
+    static const Color Cyan;
+    static const Color Transparent;
+};
+
+inline bool operator==(const Color& left, const Color& right)
+{
+    return left.r == right.r && left.g == right.g && left.b == right.b && left.a == right.a;
+}
+
+inline bool operator!=(const Color& left, const Color& right)
+{
+    return !(left == right);
+}
+
+// modulates channel by channel, White leaves a color as it is
+inline Color operator*(const Color& left, const Color& right)
+{
+    return Color(
+        static_cast<uint8_t>(left.r * right.r / 255),
+        static_cast<uint8_t>(left.g * right.g / 255),
+        static_cast<uint8_t>(left.b * right.b / 255),
+        static_cast<uint8_t>(left.a * right.a / 255));
+}
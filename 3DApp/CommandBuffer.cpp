@@ -0,0 +1,305 @@
+#include "CommandBuffer.h"
+#include "RadixSort.h"
+#include "Trace.h"
+#include "FrameCapture.h"
+#include <algorithm>
+
+namespace
+{
+    // spreads hashes that only differ in a few bits, like aligned pointers, over the slots
+    uint64_t MixHash(uint64_t hash)
+    {
+        hash ^= hash >> 33;
+        hash *= 0xff51afd7ed558ccdull;
+        hash ^= hash >> 33;
+        return hash;
+    }
+}
+
+template <typename T, typename Hash>
+uint32_t CommandBuffer::RankTable<T, Hash>::Rank(const T& value)
+{
+    if ((mValues.size() + 1) * 2 > mSlots.size())
+        Grow();
+    const size_t mask = mSlots.size() - 1;
+    for (size_t slot = static_cast<size_t>(MixHash(Hash()(value))) & mask;; slot = (slot + 1) & mask)
+    {
+        const uint32_t entry = mSlots[slot];
+        if (entry == 0)
+        {
+            mValues.push_back(value);
+            mSlots[slot] = static_cast<uint32_t>(mValues.size());
+            return static_cast<uint32_t>(mValues.size()) - 1;
+        }
+        if (mValues[entry - 1] == value)
+            return entry - 1;
+    }
+}
+
+template <typename T, typename Hash>
+void CommandBuffer::RankTable<T, Hash>::Clear()
+{
+    mValues.clear();
+    std::fill(mSlots.begin(), mSlots.end(), 0u);
+}
+
+template <typename T, typename Hash>
+void CommandBuffer::RankTable<T, Hash>::Grow()
+{
+    mSlots.assign(std::max<size_t>(64, mSlots.size() * 2), 0u);
+    const size_t mask = mSlots.size() - 1;
+    for (size_t rank = 0; rank < mValues.size(); rank++)
+    {
+        size_t slot = static_cast<size_t>(MixHash(Hash()(mValues[rank]))) & mask;
+        while (mSlots[slot] != 0)
+            slot = (slot + 1) & mask;
+        mSlots[slot] = static_cast<uint32_t>(rank + 1);
+    }
+}
+
+size_t CommandBuffer::MeshViewHash::operator()(const MeshView& view) const
+{
+    // the fields that usually tell views apart, operator== settles the rest
+    const std::hash<const void*> hash;
+    size_t result = hash(view.mX);
+    result = result * 31 + hash(view.mIndices);
+    result = result * 31 + view.mIndexCount;
+    result = result * 31 + hash(view.mLods);
+    result = result * 31 + hash(view.mMeshlets);
+    return result;
+}
+
+void CommandBuffer::SetRenderTarget(RenderTarget* target)
+{
+    Command command;
+    command.mType = CommandType::SetRenderTarget;
+    command.mTarget = target;
+    Push(command);
+}
+
+void CommandBuffer::SetBlendMode(BlendMode mode)
+{
+    Command command;
+    command.mType = CommandType::SetBlendMode;
+    command.mBlendMode = mode;
+    Push(command);
+}
+
+void CommandBuffer::SetShader(ShaderFn shader)
+{
+    Command command;
+    command.mType = CommandType::SetShader;
+    command.mShader = shader;
+    Push(command);
+}
+
+void CommandBuffer::BindMesh(const MeshView& mesh)
+{
+    Command command;
+    command.mType = CommandType::BindMesh;
+    command.mMesh = mArena.New<MeshView>(mesh);
+    Push(command);
+}
+
+void CommandBuffer::Draw(const glm::mat4& model, Color color)
+{
+    Command command;
+    command.mType = CommandType::Draw;
+    command.mInstance = mArena.New<InstanceData>(InstanceData{ model, color });
+    Push(command);
+}
+
+void CommandBuffer::Push(const Command& command)
+{
+    if (mTail == nullptr || mTail->mCount == COMMANDS_PER_CHUNK)
+    {
+        CommandChunk* chunk = static_cast<CommandChunk*>(mArena.Allocate(sizeof(CommandChunk), alignof(CommandChunk)));
+        chunk->mNext = nullptr;
+        chunk->mCount = 0;
+        if (mTail != nullptr)
+            mTail->mNext = chunk;
+        else
+            mHead = chunk;
+        mTail = chunk;
+    }
+    mTail->mCommands[mTail->mCount++] = command;
+    mCommandCount++;
+}
+
+void CommandBuffer::Reset()
+{
+    mArena.Reset();
+    mHead = nullptr;
+    mTail = nullptr;
+    mCommandCount = 0;
+}
+
+void CommandBuffer::CollectDrawItems(const Rasterizer& rast, SortContext& context) const
+{
+    // draws sort by target rank, transparency, shader rank and then the key:
+    // depth (32) | mesh rank (32)
+    // transparent draws are order independent, they only sort by mesh to batch better
+    RenderTarget* target = rast.GetCanvas();
+    BlendMode blendMode = BlendMode::Opaque;
+    ShaderFn shader = rast.GetShader();
+    const MeshView* mesh = nullptr;
+
+    for (const CommandChunk* chunk = mHead; chunk != nullptr; chunk = chunk->mNext)
+    {
+        for (uint32_t c = 0; c < chunk->mCount; c++)
+        {
+            const Command& command = chunk->mCommands[c];
+            switch (command.mType)
+            {
+            case CommandType::SetRenderTarget: target = command.mTarget ? command.mTarget : rast.GetCanvas(); break;
+            case CommandType::SetBlendMode: blendMode = command.mBlendMode; break;
+            case CommandType::SetShader: shader = command.mShader; break;
+            case CommandType::BindMesh: mesh = command.mMesh; break;
+            case CommandType::Draw:
+            {
+                if (mesh == nullptr)
+                    break;
+
+                const uint32_t targetRank = context.mTargets.Rank(target);
+                const uint32_t shaderRank = context.mShaders.Rank(shader);
+                const uint32_t meshRank = context.mMeshes.Rank(*mesh);
+
+                uint64_t key = meshRank;
+                if (blendMode != BlendMode::WeightedBlended)
+                {
+                    const float depth = (rast.proj * command.mInstance->mModel * glm::vec4(mesh->mBounds.mCenter, 1.0f)).z;
+                    key |= static_cast<uint64_t>(SortableFloat(depth)) << 32;
+                }
+                context.mDrawItems.push_back({ key, target, shader, mesh, command.mInstance, targetRank, shaderRank, meshRank,
+                    blendMode, static_cast<uint32_t>(context.mDrawItems.size()) });
+                break;
+            }
+            }
+        }
+    }
+}
+
+void CommandBuffer::Execute(Rasterizer& rast, SortContext& context)
+{
+    RenderTarget* const savedCanvas = rast.GetCanvas();
+    const BlendMode savedBlendMode = rast.GetBlendMode();
+    const ShaderFn savedShader = rast.GetShader();
+    std::vector<DrawItem>& items = context.mDrawItems;
+
+    // every draw of a target ends up in one run, however many targets there are; equal
+    // keys keep buffer and recording order, unlike std::stable_sort this doesn't allocate
+    // a temporary buffer every frame
+    std::sort(items.begin(), items.end(), [](const DrawItem& a, const DrawItem& b) {
+        if (a.mTargetRank != b.mTargetRank)
+            return a.mTargetRank < b.mTargetRank;
+        const bool aTransparent = a.mBlendMode == BlendMode::WeightedBlended;
+        const bool bTransparent = b.mBlendMode == BlendMode::WeightedBlended;
+        if (aTransparent != bTransparent)
+            return bTransparent;
+        if (a.mShaderRank != b.mShaderRank)
+            return a.mShaderRank < b.mShaderRank;
+        return a.mKey != b.mKey ? a.mKey < b.mKey : a.mSequence < b.mSequence;
+    });
+
+    if (items.empty())
+    {
+        rast.Clear();
+        rast.Flush();
+    }
+
+    size_t i = 0;
+    while (i < items.size())
+    {
+        RenderTarget* const currentTarget = items[i].mTarget;
+        rast.SetCanvas(currentTarget);
+        rast.Clear();
+
+        while (i < items.size() && items[i].mTarget == currentTarget)
+        {
+            const DrawItem& first = items[i];
+            context.mBatch.clear();
+            while (i < items.size()
+                && items[i].mTarget == currentTarget
+                && items[i].mMeshRank == first.mMeshRank
+                && items[i].mShader == first.mShader
+                && items[i].mBlendMode == first.mBlendMode)
+            {
+                context.mBatch.push_back(*items[i].mInstance);
+                i++;
+            }
+
+            rast.SetBlendMode(first.mBlendMode);
+            rast.SetShader(first.mShader);
+            rast.DrawInstanced(*first.mMesh, context.mBatch.data(), context.mBatch.size());
+        }
+
+        rast.Flush();
+    }
+
+    rast.SetCanvas(savedCanvas);
+    rast.SetBlendMode(savedBlendMode);
+    rast.SetShader(savedShader);
+
+    context.mTargets.Clear();
+    context.mShaders.Clear();
+    context.mMeshes.Clear();
+    context.mDrawItems.clear();
+}
+
+void CommandBuffer::Submit(Rasterizer& rast)
+{
+    TRACE_ZONE("submit");
+    {
+        TRACE_ZONE("collect");
+        CollectDrawItems(rast, mContext);
+    }
+    Execute(rast, mContext);
+}
+
+bool CommandBuffer::Capture(const Rasterizer& rast, const std::string& path) const
+{
+    SortContext context;
+    CollectDrawItems(rast, context);
+    return WriteCapture(rast, path, context);
+}
+
+bool CommandBuffer::WriteCapture(const Rasterizer& rast, const std::string& path, const SortContext& context)
+{
+    // unsorted, replaying them through Submit() sorts them the same way again
+    std::vector<CapturedDraw> draws;
+    draws.reserve(context.mDrawItems.size());
+    for (const DrawItem& item : context.mDrawItems)
+        draws.push_back({ item.mTarget, item.mBlendMode, item.mShader, item.mMesh, *item.mInstance });
+    return WriteFrameCapture(path, rast, draws);
+}
+
+CommandQueue::CommandQueue(size_t bufferCount)
+{
+    for (size_t i = 0; i < bufferCount; i++)
+        mBuffers.emplace_back(new CommandBuffer());
+}
+
+void CommandQueue::Reset()
+{
+    for (auto& buffer : mBuffers)
+        buffer->Reset();
+}
+
+void CommandQueue::Submit(Rasterizer& rast)
+{
+    TRACE_ZONE("submit");
+    {
+        TRACE_ZONE("collect");
+        for (auto& buffer : mBuffers)
+            buffer->CollectDrawItems(rast, mContext);
+    }
+    CommandBuffer::Execute(rast, mContext);
+}
+
+bool CommandQueue::Capture(const Rasterizer& rast, const std::string& path) const
+{
+    CommandBuffer::SortContext context;
+    for (auto& buffer : mBuffers)
+        buffer->CollectDrawItems(rast, context);
+    return CommandBuffer::WriteCapture(rast, path, context);
+}
@@ -0,0 +1,151 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <string>
+#include <functional>
+#include <cstdint>
+#include "Rasterizer.h"
+#include "LinearAllocator.h"
+
+class CommandQueue;
+
+// Records render commands instead of drawing immediately. Submit() sorts the draws by
+// render target, blend mode, shader and depth (front-to-back for opaque), then replays
+// them, changing rasterizer state only between batches and merging consecutive draws
+// of the same mesh into one DrawInstanced call.
+// Commands live in a bump allocator owned by the buffer, so recording never takes a
+// lock and one buffer per thread can be recorded concurrently (see CommandQueue).
+class CommandBuffer
+{
+public:
+    // nullptr draws to the rasterizer's own canvas
+    void SetRenderTarget(RenderTarget* target);
+    void SetBlendMode(BlendMode mode);
+    void SetShader(ShaderFn shader);
+    // the view is copied, the data it points to must outlive Submit()
+    void BindMesh(const MeshView& mesh);
+    void BindMesh(const Mesh* mesh) { BindMesh(mesh->View()); }
+    void Draw(const glm::mat4& model, Color color = Color::White);
+
+    void Reset();
+    size_t CommandCount() const { return mCommandCount; }
+
+    // Renders the recorded frame, each target is cleared, drawn and flushed once.
+    // The rasterizer's canvas, blend mode and shader are restored afterwards.
+    void Submit(Rasterizer& rast);
+    // Writes what Submit() would render with `rast` to a frame capture (FrameCapture.h),
+    // to be called right before Submit().
+    bool Capture(const Rasterizer& rast, const std::string& path) const;
+
+private:
+    friend class CommandQueue;
+
+    enum class CommandType : uint8_t
+    {
+        SetRenderTarget,
+        SetBlendMode,
+        SetShader,
+        BindMesh,
+        Draw,
+    };
+
+    struct Command
+    {
+        CommandType mType;
+        union
+        {
+            RenderTarget* mTarget;
+            BlendMode mBlendMode;
+            ShaderFn mShader;
+            const MeshView* mMesh;
+            const InstanceData* mInstance;
+        };
+    };
+
+    static constexpr uint32_t COMMANDS_PER_CHUNK = 256;
+
+    struct CommandChunk
+    {
+        CommandChunk* mNext;
+        uint32_t mCount;
+        Command mCommands[COMMANDS_PER_CHUNK];
+    };
+
+    struct DrawItem
+    {
+        uint64_t mKey; // depth and mesh rank, see CollectDrawItems()
+        RenderTarget* mTarget;
+        ShaderFn mShader;
+        const MeshView* mMesh;
+        const InstanceData* mInstance;
+        uint32_t mTargetRank;
+        uint32_t mShaderRank;
+        uint32_t mMeshRank;
+        BlendMode mBlendMode;
+        uint32_t mSequence; // recording order across all buffers, breaks key ties
+    };
+
+    // Ranks values in the order they are first seen. Open addressing over a slot array,
+    // so clearing keeps the memory and lookups stop allocating once the table has grown.
+    template <typename T, typename Hash>
+    class RankTable
+    {
+    public:
+        uint32_t Rank(const T& value);
+        void Clear();
+
+    private:
+        std::vector<T> mValues; // by rank
+        std::vector<uint32_t> mSlots; // rank + 1, 0 when empty; a power of two in size
+
+        void Grow();
+    };
+
+    struct MeshViewHash
+    {
+        size_t operator()(const MeshView& view) const;
+    };
+
+    // state shared by every buffer that takes part in one submission
+    struct SortContext
+    {
+        RankTable<RenderTarget*, std::hash<RenderTarget*>> mTargets;
+        RankTable<ShaderFn, std::hash<ShaderFn>> mShaders;
+        RankTable<MeshView, MeshViewHash> mMeshes; // equal views are one mesh, wherever they were bound
+        std::vector<DrawItem> mDrawItems;
+        std::vector<InstanceData> mBatch;
+    };
+
+    LinearAllocator mArena;
+    CommandChunk* mHead = nullptr;
+    CommandChunk* mTail = nullptr;
+    size_t mCommandCount = 0;
+    SortContext mContext;
+
+    void Push(const Command& command);
+
+    // Appends the draws of this buffer, each buffer starts from the rasterizer's state.
+    void CollectDrawItems(const Rasterizer& rast, SortContext& context) const;
+    static void Execute(Rasterizer& rast, SortContext& context);
+    static bool WriteCapture(const Rasterizer& rast, const std::string& path, const SortContext& context);
+};
+
+// One CommandBuffer per recording thread. Threads only touch their own buffer, so
+// recording is lock free; Submit() merges the buffers in index order, which keeps the
+// result independent of thread timing.
+class CommandQueue
+{
+public:
+    explicit CommandQueue(size_t bufferCount);
+
+    size_t BufferCount() const { return mBuffers.size(); }
+    CommandBuffer& GetBuffer(size_t index) { return *mBuffers[index]; }
+
+    void Reset();
+    void Submit(Rasterizer& rast);
+    bool Capture(const Rasterizer& rast, const std::string& path) const;
+
+private:
+    std::vector<std::unique_ptr<CommandBuffer>> mBuffers;
+    CommandBuffer::SortContext mContext;
+};
@@ -0,0 +1,78 @@
+#include "DepthPyramid.h"
+#include <algorithm>
+
+void DepthPyramid::Build(const float* depth, int width, int height, JobSystem& jobs)
+{
+    // odd sizes round up, the edge texels just cover fewer pixels
+    int levelWidth = width;
+    int levelHeight = height;
+    size_t size = 0;
+    mLevelCount = 0;
+    do
+    {
+        levelWidth = (levelWidth + 1) / 2;
+        levelHeight = (levelHeight + 1) / 2;
+        mWidth[mLevelCount] = levelWidth;
+        mHeight[mLevelCount] = levelHeight;
+        mOffset[mLevelCount] = size;
+        size += static_cast<size_t>(levelWidth) * levelHeight;
+        mLevelCount++;
+    } while ((levelWidth > 1 || levelHeight > 1) && mLevelCount < MAX_LEVELS);
+    mTexels.resize(size);
+
+    const float* source = depth;
+    int sourceWidth = width;
+    int sourceHeight = height;
+    for (int level = 0; level < mLevelCount; level++)
+    {
+        float* target = &mTexels[mOffset[level]];
+        // about 16k source pixels per job
+        const size_t grain = std::max<size_t>(1, 8 * 1024 / sourceWidth);
+        jobs.ParallelFor(mHeight[level], grain, [&](size_t begin, size_t end, unsigned) {
+            for (int y = static_cast<int>(begin); y < static_cast<int>(end); y++)
+            {
+                const float* row0 = source + static_cast<size_t>(y * 2) * sourceWidth;
+                const float* row1 = y * 2 + 1 < sourceHeight ? row0 + sourceWidth : row0;
+                for (int x = 0; x < mWidth[level]; x++)
+                {
+                    const int x0 = x * 2;
+                    const int x1 = std::min(x0 + 1, sourceWidth - 1);
+                    target[x + y * mWidth[level]] = std::max(std::max(row0[x0], row0[x1]), std::max(row1[x0], row1[x1]));
+                }
+            }
+        });
+        source = target;
+        sourceWidth = mWidth[level];
+        sourceHeight = mHeight[level];
+    }
+}
+
+bool DepthPyramid::IsOccluded(int x0, int y0, int x1, int y1, float nearestDepth) const
+{
+    if (mLevelCount == 0)
+        return false;
+
+    // the finest level where the rectangle spans at most 4x4 texels
+    int level = 0;
+    int shift = 1;
+    while (level + 1 < mLevelCount && ((x1 >> shift) - (x0 >> shift) >= 4 || (y1 >> shift) - (y0 >> shift) >= 4))
+    {
+        level++;
+        shift++;
+    }
+
+    const int tx0 = std::max(x0 >> shift, 0);
+    const int ty0 = std::max(y0 >> shift, 0);
+    const int tx1 = std::min(x1 >> shift, mWidth[level] - 1);
+    const int ty1 = std::min(y1 >> shift, mHeight[level] - 1);
+    const float* texels = &mTexels[mOffset[level]];
+    for (int y = ty0; y <= ty1; y++)
+    {
+        for (int x = tx0; x <= tx1; x++)
+        {
+            if (texels[x + y * mWidth[level]] >= nearestDepth)
+                return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include "JobSystem.h"
+
+// Hierarchical depth: level 0 holds the farthest depth of each 2x2 pixel block, every
+// further level the farthest of 2x2 texels of the one before, down to a single texel.
+// Smaller depth is nearer, as in the rasterizer's depth buffer.
+class DepthPyramid
+{
+public:
+    // the rows of each level are split between the threads of `jobs`
+    void Build(const float* depth, int width, int height, JobSystem& jobs);
+    void Invalidate() { mLevelCount = 0; }
+    bool IsValid() const { return mLevelCount != 0; }
+
+    // True if every pixel of the inclusive rectangle already has depth nearer than
+    // `nearestDepth`. Conservative: reads at most 4x4 texels of the level that fits.
+    bool IsOccluded(int x0, int y0, int x1, int y1, float nearestDepth) const;
+
+private:
+    static constexpr int MAX_LEVELS = 16;
+
+    std::vector<float> mTexels;
+    int mWidth[MAX_LEVELS] = {};
+    int mHeight[MAX_LEVELS] = {};
+    size_t mOffset[MAX_LEVELS] = {};
+    int mLevelCount = 0;
+};
@@ -0,0 +1,44 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <cstddef>
+#include "LinearAllocator.h"
+
+// Transient memory of one frame: one LinearAllocator per worker thread, so workers
+// allocate without locks or malloc. Reset() drops everything allocated since the last
+// one in O(workers) and keeps the blocks, so a frame no bigger than an earlier one
+// doesn't allocate from the heap at all.
+class FrameArena
+{
+public:
+    static constexpr size_t DEFAULT_BLOCK_SIZE = 1 << 20;
+
+    explicit FrameArena(unsigned workerCount, size_t blockSize = DEFAULT_BLOCK_SIZE)
+    {
+        for (unsigned i = 0; i < workerCount; i++)
+            mWorkers.emplace_back(new LinearAllocator(blockSize));
+    }
+
+    // adds workers up to `workerCount`, the existing ones and their memory stay
+    void Grow(unsigned workerCount, size_t blockSize = DEFAULT_BLOCK_SIZE)
+    {
+        while (mWorkers.size() < workerCount)
+            mWorkers.emplace_back(new LinearAllocator(blockSize));
+    }
+
+    unsigned WorkerCount() const { return static_cast<unsigned>(mWorkers.size()); }
+    // only to be used from the worker's own thread
+    LinearAllocator& Worker(unsigned index) { return *mWorkers[index]; }
+
+    template <typename T>
+    ArenaAllocator<T> Allocator(unsigned worker) { return ArenaAllocator<T>(mWorkers[worker].get()); }
+
+    void Reset()
+    {
+        for (auto& worker : mWorkers)
+            worker->Reset();
+    }
+
+private:
+    std::vector<std::unique_ptr<LinearAllocator>> mWorkers;
+};
@@ -0,0 +1,229 @@
+#include "FrameCapture.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+namespace
+{
+    bool Fail(const std::string& path, const char* reason)
+    {
+        std::cerr << "FrameCapture: " << path << ": " << reason << std::endl;
+        return false;
+    }
+
+    uint64_t AlignUp(uint64_t value, uint64_t alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+
+    std::map<std::string, ShaderFn>& Shaders()
+    {
+        static std::map<std::string, ShaderFn> shaders = { { "default", ShaderFunction } };
+        return shaders;
+    }
+
+    std::string ShaderName(ShaderFn shader)
+    {
+        for (const auto& entry : Shaders())
+        {
+            if (entry.second == shader)
+                return entry.first;
+        }
+        return std::string();
+    }
+
+    template <typename T>
+    uint32_t IndexOf(std::vector<T>& table, const T& value)
+    {
+        auto it = std::find(table.begin(), table.end(), value);
+        if (it != table.end())
+            return static_cast<uint32_t>(it - table.begin());
+        table.push_back(value);
+        return static_cast<uint32_t>(table.size() - 1);
+    }
+}
+
+void RegisterShader(const std::string& name, ShaderFn shader)
+{
+    Shaders()[name.substr(0, CAPTURE_SHADER_NAME_SIZE - 1)] = shader;
+}
+
+bool WriteFrameCapture(const std::string& path, const Rasterizer& rast, const std::vector<CapturedDraw>& draws)
+{
+    std::vector<ShaderFn> shaders;
+    std::vector<MeshView> meshes; // equal views are one mesh, like Submit() treats them
+    std::vector<RenderTarget*> targets = { nullptr };
+    std::vector<CaptureDraw> captureDraws(draws.size());
+    for (size_t i = 0; i < draws.size(); i++)
+    {
+        const CapturedDraw& draw = draws[i];
+        CaptureDraw& out = captureDraws[i];
+        std::memcpy(out.mModel, &draw.mInstance.mModel[0][0], sizeof(out.mModel));
+        out.mColor[0] = draw.mInstance.mColor.r;
+        out.mColor[1] = draw.mInstance.mColor.g;
+        out.mColor[2] = draw.mInstance.mColor.b;
+        out.mColor[3] = draw.mInstance.mColor.a;
+        out.mMesh = IndexOf(meshes, *draw.mMesh);
+        out.mShader = IndexOf(shaders, draw.mShader);
+        out.mTarget = IndexOf(targets, draw.mTarget == rast.GetCanvas() ? nullptr : draw.mTarget);
+        out.mBlendMode = static_cast<uint32_t>(draw.mBlendMode);
+        out.mReserved = 0;
+    }
+
+    std::vector<CaptureShader> captureShaders(shaders.size());
+    for (size_t i = 0; i < shaders.size(); i++)
+    {
+        const std::string name = ShaderName(shaders[i]);
+        if (name.empty())
+            std::cerr << "FrameCapture: " << path << ": a shader isn't registered, replays use the default one" << std::endl;
+        std::memset(captureShaders[i].mName, 0, CAPTURE_SHADER_NAME_SIZE);
+        std::memcpy(captureShaders[i].mName, name.data(), name.size());
+    }
+
+    std::vector<std::string> images(meshes.size());
+    for (size_t i = 0; i < meshes.size(); i++)
+    {
+        std::ostringstream image(std::ios::binary);
+        if (!WriteMeshFile(image, meshes[i]))
+            return Fail(path, "can't write a mesh");
+        images[i] = image.str();
+    }
+
+    CaptureFileHeader header = {};
+    std::memcpy(header.mMagic, CAPTURE_FILE_MAGIC, sizeof(CAPTURE_FILE_MAGIC));
+    header.mVersion = CAPTURE_FILE_VERSION;
+    header.mWidth = rast.Width();
+    header.mHeight = rast.Height();
+    std::memcpy(header.mProj, &rast.proj[0][0], sizeof(header.mProj));
+    std::memcpy(header.mInvProj, &rast.invProj[0][0], sizeof(header.mInvProj));
+    header.mThreadCount = rast.GetThreadCount();
+    header.mClusterCulling = rast.GetClusterCulling();
+    header.mLodErrorThreshold = rast.GetLodErrorThreshold();
+    header.mDepthSortThreshold = rast.GetDepthSortThreshold();
+    header.mShaderCount = static_cast<uint32_t>(shaders.size());
+    header.mMeshCount = static_cast<uint32_t>(meshes.size());
+    header.mTargetCount = static_cast<uint32_t>(targets.size());
+    header.mDrawCount = static_cast<uint32_t>(draws.size());
+
+    std::vector<CaptureMesh> captureMeshes(meshes.size());
+    uint64_t offset = sizeof(CaptureFileHeader) + captureShaders.size() * sizeof(CaptureShader)
+        + captureMeshes.size() * sizeof(CaptureMesh) + captureDraws.size() * sizeof(CaptureDraw);
+    for (size_t i = 0; i < meshes.size(); i++)
+    {
+        offset = AlignUp(offset, MESH_FILE_ALIGNMENT);
+        captureMeshes[i].mOffset = offset;
+        captureMeshes[i].mSize = images[i].size();
+        offset += images[i].size();
+    }
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out)
+        return Fail(path, "can't open for writing");
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(captureShaders.data()), captureShaders.size() * sizeof(CaptureShader));
+    out.write(reinterpret_cast<const char*>(captureMeshes.data()), captureMeshes.size() * sizeof(CaptureMesh));
+    out.write(reinterpret_cast<const char*>(captureDraws.data()), captureDraws.size() * sizeof(CaptureDraw));
+    uint64_t written = sizeof(CaptureFileHeader) + captureShaders.size() * sizeof(CaptureShader)
+        + captureMeshes.size() * sizeof(CaptureMesh) + captureDraws.size() * sizeof(CaptureDraw);
+    const char padding[MESH_FILE_ALIGNMENT] = {};
+    for (size_t i = 0; i < meshes.size(); i++)
+    {
+        out.write(padding, static_cast<std::streamsize>(captureMeshes[i].mOffset - written));
+        out.write(images[i].data(), static_cast<std::streamsize>(images[i].size()));
+        written = captureMeshes[i].mOffset + images[i].size();
+    }
+    if (!out)
+        return Fail(path, "write failed");
+    return true;
+}
+
+bool FrameReplay::Open(const std::string& path)
+{
+    mHeader = nullptr;
+    mMeshes.clear();
+    mTargets.clear();
+    mCommands.Reset();
+    mTriangleCount = 0;
+
+    if (!mFile.Open(path))
+        return Fail(path, "can't map the file");
+    const unsigned char* data = mFile.Data();
+    const uint64_t size = mFile.Size();
+    if (size < sizeof(CaptureFileHeader))
+        return Fail(path, "truncated header");
+    const CaptureFileHeader* header = reinterpret_cast<const CaptureFileHeader*>(data);
+    if (std::memcmp(header->mMagic, CAPTURE_FILE_MAGIC, sizeof(CAPTURE_FILE_MAGIC)) != 0)
+        return Fail(path, "not a frame capture");
+    if (header->mVersion != CAPTURE_FILE_VERSION)
+        return Fail(path, "unsupported version");
+    if (header->mWidth <= 0 || header->mHeight <= 0 || header->mTargetCount == 0)
+        return Fail(path, "bad header");
+    const uint64_t tablesSize = header->mShaderCount * uint64_t(sizeof(CaptureShader))
+        + header->mMeshCount * uint64_t(sizeof(CaptureMesh)) + header->mDrawCount * uint64_t(sizeof(CaptureDraw));
+    if (sizeof(CaptureFileHeader) + tablesSize > size)
+        return Fail(path, "truncated tables");
+
+    const CaptureShader* captureShaders = reinterpret_cast<const CaptureShader*>(data + sizeof(CaptureFileHeader));
+    const CaptureMesh* captureMeshes = reinterpret_cast<const CaptureMesh*>(captureShaders + header->mShaderCount);
+    const CaptureDraw* captureDraws = reinterpret_cast<const CaptureDraw*>(captureMeshes + header->mMeshCount);
+
+    std::vector<ShaderFn> shaders(header->mShaderCount, ShaderFunction);
+    for (uint32_t i = 0; i < header->mShaderCount; i++)
+    {
+        const char* nameStart = captureShaders[i].mName;
+        const std::string name(nameStart, std::find(nameStart, nameStart + CAPTURE_SHADER_NAME_SIZE, '\0'));
+        auto found = Shaders().find(name);
+        if (found != Shaders().end())
+            shaders[i] = found->second;
+        else
+            std::cerr << "FrameCapture: " << path << ": shader '" << name << "' isn't registered, using the default one" << std::endl;
+    }
+
+    for (uint32_t i = 0; i < header->mMeshCount; i++)
+    {
+        const CaptureMesh& mesh = captureMeshes[i];
+        if (mesh.mOffset % MESH_FILE_ALIGNMENT != 0 || mesh.mOffset > size || mesh.mSize > size - mesh.mOffset)
+            return Fail(path, "bad mesh offset");
+        mMeshes.emplace_back(new MeshFile());
+        if (!mMeshes.back()->OpenMemory(data + mesh.mOffset, mesh.mSize, path) || mMeshes.back()->IsCompressed())
+            return Fail(path, "bad mesh");
+    }
+
+    for (uint32_t i = 1; i < header->mTargetCount; i++)
+        mTargets.emplace_back(new ImageTarget());
+
+    // the state is set before every draw, like it was recorded
+    for (uint32_t i = 0; i < header->mDrawCount; i++)
+    {
+        const CaptureDraw& draw = captureDraws[i];
+        if (draw.mMesh >= header->mMeshCount || draw.mShader >= header->mShaderCount || draw.mTarget >= header->mTargetCount
+            || draw.mBlendMode > static_cast<uint32_t>(BlendMode::WeightedBlended))
+            return Fail(path, "bad draw");
+        glm::mat4 model;
+        std::memcpy(&model[0][0], draw.mModel, sizeof(draw.mModel));
+        mCommands.SetRenderTarget(draw.mTarget == 0 ? nullptr : mTargets[draw.mTarget - 1].get());
+        mCommands.SetBlendMode(static_cast<BlendMode>(draw.mBlendMode));
+        mCommands.SetShader(shaders[draw.mShader]);
+        mCommands.BindMesh(mMeshes[draw.mMesh]->View());
+        mCommands.Draw(model, Color(draw.mColor[0], draw.mColor[1], draw.mColor[2], draw.mColor[3]));
+        mTriangleCount += mMeshes[draw.mMesh]->View().TriangleCount();
+    }
+
+    mHeader = header;
+    return true;
+}
+
+void FrameReplay::Submit(Rasterizer& rast)
+{
+    if (rast.Width() != mHeader->mWidth || rast.Height() != mHeader->mHeight)
+        rast.Resize(mHeader->mWidth, mHeader->mHeight);
+    std::memcpy(&rast.proj[0][0], mHeader->mProj, sizeof(mHeader->mProj));
+    std::memcpy(&rast.invProj[0][0], mHeader->mInvProj, sizeof(mHeader->mInvProj));
+    rast.SetClusterCulling(mHeader->mClusterCulling);
+    rast.SetLodErrorThreshold(mHeader->mLodErrorThreshold);
+    rast.SetDepthSortThreshold(static_cast<size_t>(mHeader->mDepthSortThreshold));
+    mCommands.Submit(rast);
+}
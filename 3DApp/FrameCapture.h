@@ -0,0 +1,113 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include "Rasterizer.h"
+#include "CommandBuffer.h"
+#include "MappedFile.h"
+#include "MeshFile.h"
+
+// Frame capture (.r3dc): everything one submission fed the rasterizer, to render the
+// same frame again offline (see CommandBuffer::Capture() and FrameReplay). Layout,
+// little endian:
+//   CaptureFileHeader
+//   CaptureShader[mShaderCount]
+//   CaptureMesh[mMeshCount]
+//   CaptureDraw[mDrawCount], in recording order with the state each draw was recorded with
+//   mesh images, complete .r3dm files each starting on a MESH_FILE_ALIGNMENT boundary
+// Shaders are function pointers, so they are stored by the name they were registered
+// under. The previous frame's depth isn't captured: a replay culls against the depth of
+// the replayed frame before it, which is why replays should run a warm-up frame first.
+constexpr char CAPTURE_FILE_MAGIC[4] = { 'R', '3', 'D', 'C' };
+constexpr uint32_t CAPTURE_FILE_VERSION = 1;
+constexpr size_t CAPTURE_SHADER_NAME_SIZE = 32;
+
+struct CaptureFileHeader
+{
+    char mMagic[4];
+    uint32_t mVersion;
+    int32_t mWidth;
+    int32_t mHeight;
+    float mProj[16];
+    float mInvProj[16];
+    uint32_t mThreadCount; // what the captured frame ran with, replays pick their own
+    uint32_t mClusterCulling;
+    float mLodErrorThreshold;
+    uint32_t mReserved;
+    uint64_t mDepthSortThreshold;
+    uint32_t mShaderCount;
+    uint32_t mMeshCount;
+    uint32_t mTargetCount; // target 0 is the rasterizer's canvas, the others are offscreen
+    uint32_t mDrawCount;
+};
+
+struct CaptureShader
+{
+    char mName[CAPTURE_SHADER_NAME_SIZE]; // zero terminated, empty if it wasn't registered
+};
+
+struct CaptureMesh
+{
+    uint64_t mOffset; // .r3dm image, from the start of the file
+    uint64_t mSize;
+};
+
+struct CaptureDraw
+{
+    float mModel[16];
+    uint8_t mColor[4];
+    uint32_t mMesh;
+    uint32_t mShader;
+    uint32_t mTarget;
+    uint32_t mBlendMode; // BlendMode
+    uint32_t mReserved;
+};
+
+static_assert(sizeof(CaptureFileHeader) == 184, "CaptureFileHeader layout is part of the file format");
+static_assert(sizeof(CaptureShader) == 32, "CaptureShader layout is part of the file format");
+static_assert(sizeof(CaptureMesh) == 16, "CaptureMesh layout is part of the file format");
+static_assert(sizeof(CaptureDraw) == 88, "CaptureDraw layout is part of the file format");
+
+// Names `shader` in captures; ShaderFunction is registered as "default". Replays can only
+// use shaders registered under the same name in the replaying program.
+void RegisterShader(const std::string& name, ShaderFn shader);
+
+// one draw as Submit() sees it, with the state it was recorded with
+struct CapturedDraw
+{
+    RenderTarget* mTarget; // nullptr for the rasterizer's canvas
+    BlendMode mBlendMode;
+    ShaderFn mShader;
+    const MeshView* mMesh;
+    InstanceData mInstance;
+};
+
+// Prints the reason to std::cerr and returns false when the file can't be written.
+bool WriteFrameCapture(const std::string& path, const Rasterizer& rast, const std::vector<CapturedDraw>& draws);
+
+// A capture opened for replay. The meshes are used straight from the mapped file.
+class FrameReplay
+{
+public:
+    // Prints the reason to std::cerr and returns false when the file can't be used.
+    bool Open(const std::string& path);
+
+    const CaptureFileHeader& Header() const { return *mHeader; }
+    int Width() const { return mHeader->mWidth; }
+    int Height() const { return mHeader->mHeight; }
+    size_t DrawCount() const { return mHeader->mDrawCount; }
+    size_t TriangleCount() const { return mTriangleCount; }
+
+    // Gives the rasterizer the captured size, projection and culling settings and renders
+    // the frame; what went to the captured canvas goes to the rasterizer's canvas.
+    void Submit(Rasterizer& rast);
+
+private:
+    MappedFile mFile;
+    const CaptureFileHeader* mHeader = nullptr;
+    std::vector<std::unique_ptr<MeshFile>> mMeshes;
+    std::vector<std::unique_ptr<ImageTarget>> mTargets; // offscreen, target 1 first
+    CommandBuffer mCommands; // recorded once by Open()
+    size_t mTriangleCount = 0;
+};
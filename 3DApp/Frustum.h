@@ -0,0 +1,70 @@
+#pragma once
+#include "glm/glm.hpp"
+#include "Mesh.h"
+
+struct Plane
+{
+    glm::vec3 mNormal;
+    float mDistance;
+
+    float SignedDistance(const glm::vec3& p) const { return glm::dot(mNormal, p) + mDistance; }
+};
+
+// Side planes of the visible volume of a transform, in the space the transform maps from.
+// The rasterizer maps clip x/y straight to the viewport (there is no perspective divide yet),
+// so the volume is |x| <= 1, |y| <= 1 in clip space and depth is unbounded.
+struct Frustum
+{
+    Plane mPlanes[4];
+
+    static Frustum FromMatrix(const glm::mat4& m)
+    {
+        const glm::vec4 rowX(m[0][0], m[1][0], m[2][0], m[3][0]);
+        const glm::vec4 rowY(m[0][1], m[1][1], m[2][1], m[3][1]);
+
+        Frustum f;
+        f.mPlanes[0] = { glm::vec3(rowX), rowX.w + 1.0f };   // x >= -1
+        f.mPlanes[1] = { -glm::vec3(rowX), 1.0f - rowX.w };  // x <= 1
+        f.mPlanes[2] = { glm::vec3(rowY), rowY.w + 1.0f };   // y >= -1
+        f.mPlanes[3] = { -glm::vec3(rowY), 1.0f - rowY.w };  // y <= 1
+        return f;
+    }
+
+    bool Intersects(const BoundingSphere& sphere) const
+    {
+        for (const Plane& plane : mPlanes)
+        {
+            // planes aren't normalized, scale the radius instead
+            if (plane.SignedDistance(sphere.mCenter) < -sphere.mRadius * glm::length(plane.mNormal))
+                return false;
+        }
+        return true;
+    }
+};
+
+// Pixels covered by an object space length under `m` at its largest, for picking levels
+// of detail. Like Frustum this follows the rasterizer's convention of mapping clip x/y
+// straight to the viewport, so only the transform's scale matters, not the distance.
+inline float ProjectedLength(const glm::mat4& m, float length, int viewportWidth, int viewportHeight)
+{
+    const float scaleX = glm::length(glm::vec3(m[0][0], m[1][0], m[2][0])) * 0.5f * viewportWidth;
+    const float scaleY = glm::length(glm::vec3(m[0][1], m[1][1], m[2][1])) * 0.5f * viewportHeight;
+    return length * glm::max(scaleX, scaleY);
+}
+
+// The object space points `m` maps to clip (x, y), as a ray from near to far (growing clip
+// z) for picking. Like Frustum this follows the rasterizer's convention of mapping clip x/y
+// straight to the viewport, so it's a line whatever the depth; `origin` is the point on it
+// nearest `around`, moved back by `reach`.
+inline void ClipRay(const glm::mat4& m, float clipX, float clipY, const glm::vec3& around, float reach,
+    glm::vec3& origin, glm::vec3& direction)
+{
+    const glm::vec4 rowX(m[0][0], m[1][0], m[2][0], m[3][0]);
+    const glm::vec4 rowY(m[0][1], m[1][1], m[2][1], m[3][1]);
+    const glm::vec3 rowZ(m[0][2], m[1][2], m[2][2]);
+    direction = glm::normalize(glm::cross(glm::vec3(rowX), glm::vec3(rowY)));
+    if (glm::dot(direction, rowZ) < 0.0f)
+        direction = -direction;
+    const glm::mat3 planes = glm::transpose(glm::mat3(glm::vec3(rowX), glm::vec3(rowY), direction));
+    origin = glm::inverse(planes) * glm::vec3(clipX - rowX.w, clipY - rowY.w, glm::dot(direction, around)) - direction * reach;
+}
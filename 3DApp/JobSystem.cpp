@@ -0,0 +1,296 @@
+#include "JobSystem.h"
+#include <algorithm>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace
+{
+    // spins of an idle worker before it sleeps
+    constexpr unsigned IDLE_SPINS = 64;
+
+    struct CurrentSlot
+    {
+        const JobSystem* mSystem = nullptr;
+        unsigned mSlot = 0;
+    };
+
+    thread_local CurrentSlot tCurrent;
+}
+
+struct JobSystem::Job
+{
+    JobFn mFn;
+    const void* mData;
+    size_t mBegin;
+    size_t mEnd;
+    size_t mGrain;
+    std::atomic<size_t>* mPending; // of the loop
+};
+
+// The owner pushes and pops at the bottom, thieves take from the top. Jobs are copied
+// out before the top is claimed; a thief whose claim fails drops its copy, and the owner
+// only reuses an entry once the top has moved past it, so a kept copy is never torn.
+struct JobSystem::Slot
+{
+    std::atomic<int64_t> mTop{ 0 };
+    char mTopPadding[64]; // thieves write the top, the owner the bottom
+    std::atomic<int64_t> mBottom{ 0 };
+    std::atomic<bool> mTaken{ false }; // caller slots only
+    uint32_t mRandom; // victim selection, only used by the owner
+    Job mJobs[JOB_DEQUE_SIZE];
+
+    bool Push(const Job& job)
+    {
+        const int64_t bottom = mBottom.load(std::memory_order_relaxed);
+        const int64_t top = mTop.load(std::memory_order_acquire);
+        if (bottom - top >= static_cast<int64_t>(JOB_DEQUE_SIZE))
+            return false;
+        mJobs[bottom & (JOB_DEQUE_SIZE - 1)] = job;
+        mBottom.store(bottom + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool Pop(Job& job)
+    {
+        const int64_t bottom = mBottom.load(std::memory_order_relaxed) - 1;
+        mBottom.store(bottom, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t top = mTop.load(std::memory_order_relaxed);
+        if (top > bottom)
+        {
+            mBottom.store(bottom + 1, std::memory_order_relaxed);
+            return false;
+        }
+        job = mJobs[bottom & (JOB_DEQUE_SIZE - 1)];
+        if (top < bottom)
+            return true;
+        // the last job, thieves may be after it too
+        const bool won = mTop.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+        mBottom.store(bottom + 1, std::memory_order_relaxed);
+        return won;
+    }
+
+    bool Steal(Job& job)
+    {
+        int64_t top = mTop.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const int64_t bottom = mBottom.load(std::memory_order_acquire);
+        if (top >= bottom)
+            return false;
+        job = mJobs[top & (JOB_DEQUE_SIZE - 1)];
+        return mTop.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+    }
+
+    bool Empty() const
+    {
+        return mTop.load(std::memory_order_acquire) >= mBottom.load(std::memory_order_acquire);
+    }
+};
+
+JobSystem::JobSystem(unsigned workerCount, unsigned callerCount) :
+    mCallerCount(std::max(callerCount, 1u))
+{
+    for (unsigned i = 0; i < mCallerCount + workerCount; i++)
+    {
+        mSlots.emplace_back(new Slot());
+        mSlots.back()->mRandom = 0x9e3779b9u * (i + 1);
+    }
+    for (unsigned i = 0; i < workerCount; i++)
+        mWorkers.emplace_back(&JobSystem::WorkerLoop, this, mCallerCount + i);
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(mSleepMutex);
+        mStop.store(true);
+    }
+    mWake.notify_all();
+    for (auto& worker : mWorkers)
+        worker.join();
+}
+
+bool JobSystem::PinWorkers()
+{
+    const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    bool pinned = true;
+    for (unsigned i = 0; i < mWorkers.size(); i++)
+    {
+        const unsigned core = (i + 1) % cores;
+#ifdef _WIN32
+        // the first processor group, 64 cores
+        pinned &= SetThreadAffinityMask(mWorkers[i].native_handle(), DWORD_PTR(1) << (core % 64)) != 0;
+#elif defined(__linux__)
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(core, &set);
+        pinned &= pthread_setaffinity_np(mWorkers[i].native_handle(), sizeof(set), &set) == 0;
+#else
+        (void)core;
+        pinned = false;
+#endif
+    }
+    return pinned;
+}
+
+JobSystem& JobSystem::Shared()
+{
+    // a few callers, importing on a loader thread mustn't wait for the main thread's loop
+    static JobSystem shared(std::max(1u, std::thread::hardware_concurrency()) - 1, 4);
+    return shared;
+}
+
+void JobSystem::Run(size_t count, size_t grain, JobFn fn, const void* data)
+{
+    if (count == 0)
+        return;
+
+    // threads of this system keep their slot, others take a free caller slot for the loop
+    const CurrentSlot previous = tCurrent;
+    const bool nested = previous.mSystem == this;
+    const unsigned slot = nested ? previous.mSlot : AcquireCallerSlot();
+    tCurrent.mSystem = this;
+    tCurrent.mSlot = slot;
+
+    grain = std::max<size_t>(grain, 1);
+    if (WorkerCount() == 0 || count <= grain)
+    {
+        fn(data, 0, count, slot);
+    }
+    else
+    {
+        std::atomic<size_t> pending(1);
+        Execute(slot, { fn, data, 0, count, grain, &pending });
+        Wait(slot, pending);
+    }
+
+    tCurrent = previous;
+    if (!nested)
+        mSlots[slot]->mTaken.store(false, std::memory_order_release);
+}
+
+void JobSystem::Execute(unsigned slot, Job job)
+{
+    Slot& self = *mSlots[slot];
+    while (job.mEnd - job.mBegin > job.mGrain)
+    {
+        Job upper = job;
+        upper.mBegin = job.mBegin + (job.mEnd - job.mBegin) / 2;
+        job.mPending->fetch_add(1, std::memory_order_relaxed);
+        if (!self.Push(upper))
+        {
+            // the deque is full, run the whole range here
+            job.mPending->fetch_sub(1, std::memory_order_relaxed);
+            break;
+        }
+        job.mEnd = upper.mBegin;
+        WakeWorker();
+    }
+    job.mFn(job.mData, job.mBegin, job.mEnd, slot);
+    job.mPending->fetch_sub(1, std::memory_order_release);
+}
+
+void JobSystem::Wait(unsigned slot, const std::atomic<size_t>& pending)
+{
+    Slot& self = *mSlots[slot];
+    while (pending.load(std::memory_order_acquire) != 0)
+    {
+        // the loop's own jobs are most likely at the bottom of this deque, or stolen
+        // from it; other jobs run too, the waiting thread would be idle otherwise
+        Job job;
+        if (self.Pop(job) || Steal(slot, job))
+            Execute(slot, job);
+        else
+            std::this_thread::yield();
+    }
+}
+
+bool JobSystem::Steal(unsigned slot, Job& job)
+{
+    // xorshift, so thieves don't all go for the same victim
+    Slot& self = *mSlots[slot];
+    self.mRandom ^= self.mRandom << 13;
+    self.mRandom ^= self.mRandom >> 17;
+    self.mRandom ^= self.mRandom << 5;
+    const unsigned count = SlotCount();
+    const unsigned first = self.mRandom % count;
+    for (unsigned i = 0; i < count; i++)
+    {
+        const unsigned victim = (first + i) % count;
+        if (victim != slot && mSlots[victim]->Steal(job))
+            return true;
+    }
+    return false;
+}
+
+bool JobSystem::HasJobs() const
+{
+    for (const auto& slot : mSlots)
+    {
+        if (!slot->Empty())
+            return true;
+    }
+    return false;
+}
+
+void JobSystem::WakeWorker()
+{
+    // pairs with the fence in WorkerLoop(): either the sleeper sees the job or this sees the sleeper
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (mSleeping.load(std::memory_order_relaxed) == 0)
+        return;
+    std::lock_guard<std::mutex> lock(mSleepMutex);
+    mWake.notify_one();
+}
+
+void JobSystem::WorkerLoop(unsigned slot)
+{
+    tCurrent.mSystem = this;
+    tCurrent.mSlot = slot;
+    Slot& self = *mSlots[slot];
+    unsigned idle = 0;
+    while (!mStop.load(std::memory_order_acquire))
+    {
+        Job job;
+        if (self.Pop(job) || Steal(slot, job))
+        {
+            Execute(slot, job);
+            idle = 0;
+            continue;
+        }
+        if (++idle < IDLE_SPINS)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mSleepMutex);
+        mSleeping.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!HasJobs() && !mStop.load(std::memory_order_relaxed))
+            mWake.wait(lock);
+        mSleeping.fetch_sub(1, std::memory_order_relaxed);
+        idle = 0;
+    }
+}
+
+unsigned JobSystem::AcquireCallerSlot()
+{
+    for (;;)
+    {
+        for (unsigned i = 0; i < mCallerCount; i++)
+        {
+            if (!mSlots[i]->mTaken.load(std::memory_order_relaxed)
+                && !mSlots[i]->mTaken.exchange(true, std::memory_order_acquire))
+                return i;
+        }
+        std::this_thread::yield();
+    }
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent worker threads for the parallel loops of the pipeline stages, so no stage
+// starts threads of its own. Every worker and every calling thread owns a deque of jobs.
+// A job covers a range of a loop and, while the range is larger than the loop's grain,
+// pushes its upper half onto its own deque and goes on with the lower one. Idle threads
+// steal the oldest, largest halves from a random other deque. The deques are lock-free
+// (Chase-Lev with a fixed size), the only lock is the one idle workers sleep on.
+// Each loop counts its pending jobs, and the thread that started it runs jobs until they
+// are done. A job that starts a loop of its own waits the same way, so it finishes only
+// after the jobs it split into.
+constexpr size_t JOB_DEQUE_SIZE = 1024; // per thread, a power of two
+
+// runs [begin, end) of a loop; `slot` identifies the thread, see JobSystem::SlotCount()
+using JobFn = void (*)(const void* data, size_t begin, size_t end, unsigned slot);
+
+class JobSystem
+{
+public:
+    // `workerCount` threads besides the callers; up to `callerCount` threads outside the
+    // system can run loops at the same time, more wait for a free slot
+    explicit JobSystem(unsigned workerCount, unsigned callerCount = 1);
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    unsigned WorkerCount() const { return SlotCount() - mCallerCount; }
+    // Jobs are told the slot of the thread they run on, which is below this. Callers come
+    // first, a system with a single caller runs that caller's jobs as slot 0.
+    unsigned SlotCount() const { return static_cast<unsigned>(mSlots.size()); }
+
+    // Binds worker i to core i + 1 (modulo the core count), leaving core 0 to the caller.
+    // Returns false where thread affinity isn't supported.
+    bool PinWorkers();
+
+    // Calls fn(begin, end, slot) for ranges covering [0, count), split down to `grain`
+    // items, and returns once all of them ran; the calling thread runs ranges as well.
+    // Without workers fn gets the whole range at once. Ranges run in no particular order.
+    template <typename Fn>
+    void ParallelFor(size_t count, size_t grain, const Fn& fn)
+    {
+        Run(count, grain, &CallRange<Fn>, &fn);
+    }
+
+    // one worker per core besides the caller, for loops outside a Rasterizer
+    static JobSystem& Shared();
+
+private:
+    struct Job;
+    struct Slot;
+
+    unsigned mCallerCount;
+    std::vector<std::unique_ptr<Slot>> mSlots; // callers, then workers; complete before the workers start
+    std::vector<std::thread> mWorkers;
+    std::atomic<bool> mStop{ false };
+    std::atomic<unsigned> mSleeping{ 0 };
+    std::mutex mSleepMutex;
+    std::condition_variable mWake;
+
+    template <typename Fn>
+    static void CallRange(const void* fn, size_t begin, size_t end, unsigned slot)
+    {
+        (*static_cast<const Fn*>(fn))(begin, end, slot);
+    }
+
+    void Run(size_t count, size_t grain, JobFn fn, const void* data);
+    void Execute(unsigned slot, Job job);
+    void Wait(unsigned slot, const std::atomic<size_t>& pending);
+    bool Steal(unsigned slot, Job& job);
+    bool HasJobs() const;
+    void WakeWorker();
+    void WorkerLoop(unsigned slot);
+    unsigned AcquireCallerSlot();
+};
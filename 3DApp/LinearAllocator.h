@@ -0,0 +1,160 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Bump allocator over a chain of blocks. Allocation is a pointer increment, memory
+// is never freed individually and Reset() makes every block reusable at once.
+// Blocks don't move, so pointers stay valid until Reset(). Not thread safe; give
+// each thread its own.
+class LinearAllocator
+{
+private:
+    struct Block
+    {
+        Block* mNext;
+        size_t mSize;
+    };
+
+    size_t mBlockSize;
+    Block* mFirst = nullptr;
+    Block* mCurrent = nullptr;
+    uintptr_t mCursor = 0;
+    uintptr_t mEnd = 0;
+
+    static uintptr_t BlockData(Block* block) { return reinterpret_cast<uintptr_t>(block + 1); }
+
+    void UseBlock(Block* block)
+    {
+        mCurrent = block;
+        mCursor = BlockData(block);
+        mEnd = mCursor + block->mSize;
+    }
+
+    Block* NewBlock(size_t size)
+    {
+        Block* block = static_cast<Block*>(::operator new(sizeof(Block) + size));
+        block->mNext = nullptr;
+        block->mSize = size;
+        return block;
+    }
+
+    void* AllocateSlow(size_t size, size_t alignment)
+    {
+        const size_t needed = size + alignment;
+
+        // reuse the blocks left from before the last Reset() when they fit
+        Block* previous = mCurrent;
+        Block* next = mCurrent ? mCurrent->mNext : nullptr;
+        while (next != nullptr && next->mSize < needed)
+        {
+            previous = next;
+            next = next->mNext;
+        }
+
+        if (next == nullptr)
+        {
+            next = NewBlock(needed > mBlockSize ? needed : mBlockSize);
+            if (previous != nullptr)
+                previous->mNext = next;
+            else
+                mFirst = next;
+        }
+
+        UseBlock(next);
+        return Allocate(size, alignment);
+    }
+
+public:
+    explicit LinearAllocator(size_t blockSize = 64 * 1024)
+        : mBlockSize(blockSize)
+    {
+    }
+
+    LinearAllocator(const LinearAllocator&) = delete;
+    LinearAllocator& operator=(const LinearAllocator&) = delete;
+
+    ~LinearAllocator()
+    {
+        for (Block* block = mFirst; block != nullptr;)
+        {
+            Block* next = block->mNext;
+            ::operator delete(block);
+            block = next;
+        }
+    }
+
+    // alignment must be a power of two
+    void* Allocate(size_t size, size_t alignment = alignof(std::max_align_t))
+    {
+        const uintptr_t aligned = (mCursor + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1);
+        if (mCurrent == nullptr || aligned + size > mEnd)
+            return AllocateSlow(size, alignment);
+        mCursor = aligned + size;
+        return reinterpret_cast<void*>(aligned);
+    }
+
+    // Objects are never destroyed, so only trivially destructible types are allowed.
+    template <typename T, typename... Args>
+    T* New(Args&&... args)
+    {
+        static_assert(std::is_trivially_destructible<T>::value, "LinearAllocator never runs destructors");
+        return new (Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    template <typename T>
+    T* NewArray(size_t count)
+    {
+        static_assert(std::is_trivially_destructible<T>::value, "LinearAllocator never runs destructors");
+        T* items = static_cast<T*>(Allocate(sizeof(T) * count, alignof(T)));
+        for (size_t i = 0; i < count; i++)
+            new (items + i) T();
+        return items;
+    }
+
+    // O(1), keeps all blocks for the next round
+    void Reset()
+    {
+        if (mFirst != nullptr)
+            UseBlock(mFirst);
+    }
+
+    size_t BlockSize() const { return mBlockSize; }
+};
+
+// STL allocator over a LinearAllocator, so standard containers can live in an arena.
+// deallocate() does nothing: a container's memory comes back with the arena's Reset(),
+// and a container has to be replaced by a fresh one before that, not just cleared.
+template <typename T>
+class ArenaAllocator
+{
+public:
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    // nullptr only for containers that are assigned a real one before they allocate
+    ArenaAllocator(LinearAllocator* arena = nullptr) : mArena(arena) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : mArena(other.Arena()) {}
+
+    T* allocate(size_t count) { return static_cast<T*>(mArena->Allocate(sizeof(T) * count, alignof(T))); }
+    void deallocate(T*, size_t) {}
+
+    LinearAllocator* Arena() const { return mArena; }
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>& other) const { return mArena == other.Arena(); }
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const { return mArena != other.Arena(); }
+
+private:
+    LinearAllocator* mArena;
+};
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
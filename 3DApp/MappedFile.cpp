@@ -0,0 +1,128 @@
+#include "MappedFile.h"
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+{
+    *this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+    if (this != &other)
+    {
+        Close();
+        std::swap(mData, other.mData);
+        std::swap(mSize, other.mSize);
+        std::swap(mFile, other.mFile);
+#ifdef _WIN32
+        std::swap(mMapping, other.mMapping);
+#endif
+    }
+    return *this;
+}
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const std::string& path)
+{
+    Close();
+
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    mFile = file;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+    {
+        Close();
+        return false;
+    }
+    mSize = static_cast<size_t>(size.QuadPart);
+
+    mMapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mMapping == nullptr)
+    {
+        Close();
+        return false;
+    }
+
+    mData = static_cast<const unsigned char*>(MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0));
+    if (mData == nullptr)
+    {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (mData != nullptr)
+        UnmapViewOfFile(mData);
+    if (mMapping != nullptr)
+        CloseHandle(mMapping);
+    if (mFile != nullptr)
+        CloseHandle(mFile);
+    mData = nullptr;
+    mMapping = nullptr;
+    mFile = nullptr;
+    mSize = 0;
+}
+
+#else
+
+bool MappedFile::Open(const std::string& path)
+{
+    Close();
+
+    mFile = open(path.c_str(), O_RDONLY);
+    if (mFile < 0)
+        return false;
+
+    struct stat info;
+    if (fstat(mFile, &info) != 0 || info.st_size == 0)
+    {
+        Close();
+        return false;
+    }
+    mSize = static_cast<size_t>(info.st_size);
+
+    void* data = mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, mFile, 0);
+    if (data == MAP_FAILED)
+    {
+        Close();
+        return false;
+    }
+    mData = static_cast<const unsigned char*>(data);
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (mData != nullptr)
+        munmap(const_cast<unsigned char*>(mData), mSize);
+    if (mFile >= 0)
+        close(mFile);
+    mData = nullptr;
+    mFile = -1;
+    mSize = 0;
+}
+
+#endif
@@ -0,0 +1,33 @@
+#pragma once
+#include <string>
+#include <cstddef>
+
+// Read-only memory mapping of a whole file. Pages are faulted in on first access,
+// nothing is read up front.
+class MappedFile
+{
+private:
+    const unsigned char* mData = nullptr;
+    size_t mSize = 0;
+#ifdef _WIN32
+    void* mFile = nullptr;
+    void* mMapping = nullptr;
+#else
+    int mFile = -1;
+#endif
+
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    ~MappedFile();
+
+    bool Open(const std::string& path);
+    void Close();
+
+    bool IsOpen() const { return mData != nullptr; }
+    const unsigned char* Data() const { return mData; }
+    size_t Size() const { return mSize; }
+};
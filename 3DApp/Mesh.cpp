@@ -0,0 +1,127 @@
+#include "Mesh.h"
+#include <algorithm>
+#include <map>
+#include <tuple>
+#include <cmath>
+
+void Mesh::ComputeBounds()
+{
+    if (mX.empty())
+    {
+        mBounds = BoundingSphere();
+        mAabb = Aabb();
+        return;
+    }
+
+    // center of the AABB, then the farthest vertex from it
+    glm::vec3 lo = Position(0);
+    glm::vec3 hi = lo;
+    for (uint32_t i = 1; i < VertexCount(); i++)
+    {
+        lo = glm::min(lo, Position(i));
+        hi = glm::max(hi, Position(i));
+    }
+    mAabb.mMin = lo;
+    mAabb.mMax = hi;
+    mBounds.mCenter = (lo + hi) * 0.5f;
+
+    float radiusSq = 0.0f;
+    for (uint32_t i = 0; i < VertexCount(); i++)
+    {
+        const glm::vec3 d = Position(i) - mBounds.mCenter;
+        radiusSq = std::max(radiusSq, glm::dot(d, d));
+    }
+    mBounds.mRadius = std::sqrt(radiusSq);
+}
+
+MeshView Mesh::View() const
+{
+    MeshView view;
+    view.mX = mX.data();
+    view.mY = mY.data();
+    view.mZ = mZ.data();
+    if (HasNormals())
+    {
+        view.mNX = mNX.data();
+        view.mNY = mNY.data();
+        view.mNZ = mNZ.data();
+    }
+    view.mIndices = mIndices.data();
+    view.mIndexSize = sizeof(uint32_t);
+    view.mVertexCount = mX.size();
+    view.mIndexCount = mIndices.size();
+    view.mBounds = mBounds;
+    view.mAabb = mAabb;
+    if (!mLods.empty())
+    {
+        view.mLods = mLods.data();
+        view.mLodCount = mLods.size();
+        view.mLodIndices = mLodIndices.data();
+    }
+    if (!mMeshlets.empty())
+    {
+        view.mMeshlets = mMeshlets.data();
+        view.mMeshletCount = mMeshlets.size();
+        view.mMeshletVertices = mMeshletVertices.data();
+        view.mMeshletTriangles = mMeshletTriangles.data();
+    }
+    return view;
+}
+
+MeshView MeshView::Level(size_t level) const
+{
+    MeshView view = *this;
+    view.mLods = nullptr;
+    view.mLodCount = 0;
+    view.mLodIndices = nullptr;
+    if (level == 0)
+        return view;
+
+    view.mMeshlets = nullptr;
+    view.mMeshletCount = 0;
+    view.mMeshletVertices = nullptr;
+    view.mMeshletTriangles = nullptr;
+    const MeshLod& lod = mLods[level - 1];
+    view.mIndices = static_cast<const unsigned char*>(mLodIndices) + static_cast<size_t>(lod.mFirstIndex) * mIndexSize;
+    view.mIndexCount = lod.mIndexCount;
+    view.mVertexCount = lod.mVertexCount;
+    return view;
+}
+
+Mesh Mesh::FromTriangles(const Triangle* triangles, size_t count)
+{
+    Mesh mesh;
+    std::map<std::tuple<float, float, float>, uint32_t> welded;
+    auto addVertex = [&](const Vector3& p) {
+        auto inserted = welded.emplace(std::make_tuple(p.x, p.y, p.z), static_cast<uint32_t>(mesh.mX.size()));
+        if (inserted.second)
+        {
+            mesh.mX.push_back(p.x);
+            mesh.mY.push_back(p.y);
+            mesh.mZ.push_back(p.z);
+        }
+        mesh.mIndices.push_back(inserted.first->second);
+    };
+
+    for (size_t i = 0; i < count; i++)
+    {
+        addVertex(triangles[i].mP1);
+        addVertex(triangles[i].mP2);
+        addVertex(triangles[i].mP3);
+    }
+    mesh.ComputeBounds();
+    return mesh;
+}
+
+bool MeshView::operator==(const MeshView& other) const
+{
+    return mX == other.mX && mY == other.mY && mZ == other.mZ
+        && mNX == other.mNX && mNY == other.mNY && mNZ == other.mNZ
+        && mIndices == other.mIndices && mIndexSize == other.mIndexSize
+        && mVertexCount == other.mVertexCount && mIndexCount == other.mIndexCount
+        && mBounds.mCenter == other.mBounds.mCenter && mBounds.mRadius == other.mBounds.mRadius
+        && mAabb.mMin == other.mAabb.mMin && mAabb.mMax == other.mAabb.mMax
+        && mLods == other.mLods && mLodCount == other.mLodCount && mLodIndices == other.mLodIndices
+        && mMeshlets == other.mMeshlets && mMeshletCount == other.mMeshletCount
+        && mMeshletVertices == other.mMeshletVertices && mMeshletTriangles == other.mMeshletTriangles;
+}
@@ -0,0 +1,163 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "glm/glm.hpp"
+
+using Vector3 = glm::vec3;
+
+struct Triangle {
+    Triangle(Vector3 p1, Vector3 p2, Vector3 p3)
+        : mP1(p1), mP2(p2), mP3(p3)
+    {
+    }
+    Vector3 mP1;
+    Vector3 mP2;
+    Vector3 mP3;
+};
+
+struct BoundingSphere
+{
+    glm::vec3 mCenter = glm::vec3(0.0f);
+    float mRadius = 0.0f;
+};
+
+struct Aabb
+{
+    glm::vec3 mMin = glm::vec3(0.0f);
+    glm::vec3 mMax = glm::vec3(0.0f);
+};
+
+// One coarser level of detail. Levels share the vertex buffer, which is ordered
+// coarsest level first, so a level only uses the first mVertexCount vertices.
+struct MeshLod
+{
+    uint32_t mFirstIndex; // into the LOD index buffer
+    uint32_t mIndexCount;
+    uint32_t mVertexCount;
+    float mError; // largest object space deviation from the full mesh
+};
+
+// A small cluster of the full mesh's triangles, culled as a whole before any of its
+// vertices are transformed (see BuildMeshlets). Its triangles index its own vertex list
+// with bytes, so a meshlet has at most MESHLET_VERTEX_LIMIT vertices.
+constexpr uint32_t MESHLET_VERTEX_LIMIT = 256;
+
+struct Meshlet
+{
+    uint32_t mVertexOffset;   // into the meshlet vertex buffer, which holds mesh vertex indices
+    uint32_t mTriangleOffset; // into the meshlet triangle buffer, 3 local vertex indices per triangle
+    uint32_t mVertexCount;
+    uint32_t mTriangleCount;
+    BoundingSphere mBounds;
+    // the triangle normals lie in a cone around mConeAxis, so a view direction d with
+    // dot(d, mConeAxis) > mConeCutoff sees every triangle from behind. The cutoff is 1
+    // when the cone is too wide for any direction to do that.
+    glm::vec3 mConeAxis;
+    float mConeCutoff;
+};
+
+// Non-owning view of indexed mesh data, either a Mesh or a memory mapped mesh file.
+struct MeshView
+{
+    const float* mX = nullptr;
+    const float* mY = nullptr;
+    const float* mZ = nullptr;
+    const float* mNX = nullptr; // normals are optional, all three or none
+    const float* mNY = nullptr;
+    const float* mNZ = nullptr;
+    const void* mIndices = nullptr;
+    uint32_t mIndexSize = 4; // bytes per index, 2 or 4
+    size_t mVertexCount = 0;
+    size_t mIndexCount = 0;
+    BoundingSphere mBounds;
+    Aabb mAabb;
+    // optional coarser levels, same index size as mIndices
+    const MeshLod* mLods = nullptr;
+    size_t mLodCount = 0;
+    const void* mLodIndices = nullptr;
+    // optional clusters of the full mesh
+    const Meshlet* mMeshlets = nullptr;
+    size_t mMeshletCount = 0;
+    const uint32_t* mMeshletVertices = nullptr;
+    const uint8_t* mMeshletTriangles = nullptr;
+
+    size_t VertexCount() const { return mVertexCount; }
+    size_t TriangleCount() const { return mIndexCount / 3; }
+    bool HasNormals() const { return mNX != nullptr; }
+    bool HasMeshlets() const { return mMeshletCount != 0; }
+    uint32_t Index(size_t i) const
+    {
+        return mIndexSize == 2 ? static_cast<const uint16_t*>(mIndices)[i] : static_cast<const uint32_t*>(mIndices)[i];
+    }
+
+    // level 0 is the full mesh, LevelCount() - 1 the coarsest
+    size_t LevelCount() const { return mLodCount + 1; }
+    float LevelError(size_t level) const { return level == 0 ? 0.0f : mLods[level - 1].mError; }
+    // a view of just that level, without LODs of its own; only level 0 keeps the meshlets
+    MeshView Level(size_t level) const;
+
+    // same data, counts and bounds, whether or not the views are the same object
+    bool operator==(const MeshView& other) const;
+    bool operator!=(const MeshView& other) const { return !(*this == other); }
+};
+
+// Indexed triangle mesh. Positions are kept as separate x/y/z streams so the
+// vertex stage can transform them in SIMD batches.
+struct Mesh
+{
+    std::vector<float> mX;
+    std::vector<float> mY;
+    std::vector<float> mZ;
+    std::vector<float> mNX; // empty, or one normal per vertex
+    std::vector<float> mNY;
+    std::vector<float> mNZ;
+    std::vector<uint32_t> mIndices;
+    std::vector<MeshLod> mLods; // see BuildLodChain
+    std::vector<uint32_t> mLodIndices;
+    std::vector<Meshlet> mMeshlets; // see BuildMeshlets
+    std::vector<uint32_t> mMeshletVertices;
+    std::vector<uint8_t> mMeshletTriangles;
+    BoundingSphere mBounds;
+    Aabb mAabb;
+
+    size_t VertexCount() const { return mX.size(); }
+    size_t TriangleCount() const { return mIndices.size() / 3; }
+    bool HasNormals() const { return !mNX.empty(); }
+    glm::vec3 Position(uint32_t index) const { return glm::vec3(mX[index], mY[index], mZ[index]); }
+
+    void ComputeBounds();
+
+    MeshView View() const;
+
+    // Welds identical positions, triangle and corner order are kept.
+    static Mesh FromTriangles(const Triangle* triangles, size_t count);
+};
+
+class Cube {
+public:
+    Triangle triangles[12] = {
+        Triangle(glm::vec3(-0.5, -0.5, 0.5), glm::vec3(0.5, -0.5, 0.5), glm::vec3(0.5, 0.5, 0.5)),
+        Triangle(glm::vec3(-0.5, -0.5, 0.5), glm::vec3(-0.5, 0.5, 0.5), glm::vec3(0.5, 0.5, 0.5)),
+
+        // Back face
+        Triangle(glm::vec3(-0.5, -0.5, -0.5), glm::vec3(-0.5, 0.5, -0.5), glm::vec3(0.5, 0.5, -0.5)),
+        Triangle(glm::vec3(-0.5, -0.5, -0.5), glm::vec3(0.5, -0.5, -0.5), glm::vec3(0.5, 0.5, -0.5)),
+
+        // Left face
+        Triangle(glm::vec3(-0.5, -0.5, -0.5), glm::vec3(-0.5, -0.5, 0.5), glm::vec3(-0.5, 0.5, 0.5)),
+        Triangle(glm::vec3(-0.5, -0.5, -0.5), glm::vec3(-0.5, 0.5, -0.5), glm::vec3(-0.5, 0.5, 0.5)),
+
+        // Right face
+        Triangle(glm::vec3(0.5, -0.5, -0.5), glm::vec3(0.5, 0.5, -0.5), glm::vec3(0.5, 0.5, 0.5)),
+        Triangle(glm::vec3(0.5, -0.5, -0.5), glm::vec3(0.5, 0.5, 0.5), glm::vec3(0.5, -0.5, 0.5)),
+
+        // Top face
+        Triangle(glm::vec3(-0.5, 0.5, -0.5), glm::vec3(-0.5, 0.5, 0.5), glm::vec3(0.5, 0.5, 0.5)),
+        Triangle(glm::vec3(-0.5, 0.5, -0.5), glm::vec3(0.5, 0.5, 0.5), glm::vec3(0.5, 0.5, -0.5)),
+
+        // Bottom face
+        Triangle(glm::vec3(-0.5, -0.5, -0.5), glm::vec3(0.5, -0.5, -0.5), glm::vec3(0.5, -0.5, 0.5)),
+        Triangle(glm::vec3(-0.5, -0.5, -0.5), glm::vec3(0.5, -0.5, 0.5), glm::vec3(-0.5, -0.5, 0.5))
+    };
+};
@@ -0,0 +1,324 @@
+#include "MeshCodec.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RASTER_USE_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    const uint32_t UNUSED = 0xffffffffu;
+
+    uint16_t Quantize(float value, float lo, float extent)
+    {
+        if (extent <= 0.0f)
+            return 0;
+        const float t = (value - lo) / extent * 65535.0f + 0.5f;
+        return static_cast<uint16_t>(std::max(0.0f, std::min(t, 65535.0f)));
+    }
+
+    int8_t ToSnorm8(float value)
+    {
+        return static_cast<int8_t>(std::lround(std::max(-1.0f, std::min(value, 1.0f)) * 127.0f));
+    }
+
+    glm::vec3 Scale(const Aabb& aabb)
+    {
+        return (aabb.mMax - aabb.mMin) / 65535.0f;
+    }
+
+    uint32_t ZigZag(int32_t value)
+    {
+        return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+    }
+
+    int32_t UnZigZag(uint32_t value)
+    {
+        return static_cast<int32_t>(value >> 1) ^ -static_cast<int32_t>(value & 1);
+    }
+
+    // bytes needed for value, minus one, as stored in the control bits
+    uint32_t LengthCode(uint32_t value)
+    {
+        return value < (1u << 8) ? 0 : value < (1u << 16) ? 1 : value < (1u << 24) ? 2 : 3;
+    }
+
+    const uint32_t LENGTH_MASKS[4] = { 0xffu, 0xffffu, 0xffffffu, 0xffffffffu };
+}
+
+glm::mat4 CompressedMeshView::Dequantize() const
+{
+    const glm::vec3 scale = Scale(mAabb);
+    glm::mat4 m(1.0f);
+    m[0][0] = scale.x;
+    m[1][1] = scale.y;
+    m[2][2] = scale.z;
+    m[3] = glm::vec4(mAabb.mMin, 1.0f);
+    return m;
+}
+
+CompressedMeshView CompressedMesh::View() const
+{
+    CompressedMeshView view;
+    view.mQX = mQX.data();
+    view.mQY = mQY.data();
+    view.mQZ = mQZ.data();
+    view.mNormals = mNormals.empty() ? nullptr : mNormals.data();
+    view.mIndexStream = mIndexStream.data();
+    view.mIndexBlocks = mIndexBlocks.data();
+    view.mIndexStreamSize = mIndexStream.size();
+    view.mVertexCount = mQX.size();
+    view.mIndexCount = mIndexCount;
+    view.mBounds = mBounds;
+    view.mAabb = mAabb;
+    return view;
+}
+
+uint16_t EncodeOctahedral(const glm::vec3& normal)
+{
+    const float sum = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+    if (sum == 0.0f)
+        return 0;
+
+    // project onto the octahedron, fold the lower half over the upper one
+    float x = normal.x / sum;
+    float y = normal.y / sum;
+    if (normal.z < 0.0f)
+    {
+        const float foldedX = (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        const float foldedY = (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = foldedX;
+        y = foldedY;
+    }
+    return static_cast<uint16_t>(static_cast<uint8_t>(ToSnorm8(x)) | (static_cast<uint8_t>(ToSnorm8(y)) << 8));
+}
+
+glm::vec3 DecodeOctahedral(uint16_t packed)
+{
+    float x = std::max(static_cast<int8_t>(packed & 0xff) / 127.0f, -1.0f);
+    float y = std::max(static_cast<int8_t>(packed >> 8) / 127.0f, -1.0f);
+    const float z = 1.0f - std::abs(x) - std::abs(y);
+    const float t = std::max(-z, 0.0f);
+    x += x >= 0.0f ? -t : t;
+    y += y >= 0.0f ? -t : t;
+    const float length = std::sqrt(x * x + y * y + z * z);
+    return glm::vec3(x / length, y / length, z / length);
+}
+
+CompressedMesh EncodeMesh(const Mesh& mesh)
+{
+    CompressedMesh compressed;
+    compressed.mBounds = mesh.mBounds;
+    compressed.mAabb = mesh.mAabb;
+    compressed.mIndexCount = mesh.mIndices.size();
+
+    // first use order, vertices no triangle references go last
+    const size_t vertexCount = mesh.VertexCount();
+    std::vector<uint32_t> remap(vertexCount, UNUSED);
+    std::vector<uint32_t> order;
+    order.reserve(vertexCount);
+    for (uint32_t index : mesh.mIndices)
+    {
+        if (remap[index] == UNUSED)
+        {
+            remap[index] = static_cast<uint32_t>(order.size());
+            order.push_back(index);
+        }
+    }
+    for (uint32_t v = 0; v < vertexCount; v++)
+    {
+        if (remap[v] == UNUSED)
+        {
+            remap[v] = static_cast<uint32_t>(order.size());
+            order.push_back(v);
+        }
+    }
+
+    const glm::vec3 extent = mesh.mAabb.mMax - mesh.mAabb.mMin;
+    compressed.mQX.resize(vertexCount);
+    compressed.mQY.resize(vertexCount);
+    compressed.mQZ.resize(vertexCount);
+    if (mesh.HasNormals())
+        compressed.mNormals.resize(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+    {
+        const uint32_t source = order[v];
+        compressed.mQX[v] = Quantize(mesh.mX[source], mesh.mAabb.mMin.x, extent.x);
+        compressed.mQY[v] = Quantize(mesh.mY[source], mesh.mAabb.mMin.y, extent.y);
+        compressed.mQZ[v] = Quantize(mesh.mZ[source], mesh.mAabb.mMin.z, extent.z);
+        if (mesh.HasNormals())
+            compressed.mNormals[v] = EncodeOctahedral(glm::vec3(mesh.mNX[source], mesh.mNY[source], mesh.mNZ[source]));
+    }
+
+    compressed.mIndexStream.reserve(mesh.mIndices.size() * 2);
+    for (size_t blockBegin = 0; blockBegin < mesh.mIndices.size(); blockBegin += MESH_INDEX_BLOCK_SIZE)
+    {
+        const size_t blockSize = std::min(MESH_INDEX_BLOCK_SIZE, mesh.mIndices.size() - blockBegin);
+        const size_t controlOffset = compressed.mIndexStream.size();
+        compressed.mIndexBlocks.push_back(static_cast<uint32_t>(controlOffset));
+        compressed.mIndexStream.resize(controlOffset + (blockSize + 3) / 4, 0);
+
+        int32_t previous = 0;
+        for (size_t i = 0; i < blockSize; i++)
+        {
+            const int32_t index = static_cast<int32_t>(remap[mesh.mIndices[blockBegin + i]]);
+            const uint32_t value = ZigZag(index - previous);
+            const uint32_t code = LengthCode(value);
+            compressed.mIndexStream[controlOffset + i / 4] |= static_cast<uint8_t>(code << (i % 4 * 2));
+            for (uint32_t byte = 0; byte <= code; byte++)
+                compressed.mIndexStream.push_back(static_cast<uint8_t>(value >> (byte * 8)));
+            previous = index;
+        }
+    }
+    // lets the decoder load four bytes for every value, including the last one
+    compressed.mIndexStream.insert(compressed.mIndexStream.end(), 3, 0);
+    return compressed;
+}
+
+Mesh DecodeMesh(const CompressedMeshView& compressed)
+{
+    Mesh mesh;
+    const size_t vertexCount = compressed.VertexCount();
+    mesh.mX.resize(vertexCount);
+    mesh.mY.resize(vertexCount);
+    mesh.mZ.resize(vertexCount);
+    DecodePositions(compressed, 0, vertexCount, mesh.mX.data(), mesh.mY.data(), mesh.mZ.data());
+    if (compressed.HasNormals())
+    {
+        mesh.mNX.resize(vertexCount);
+        mesh.mNY.resize(vertexCount);
+        mesh.mNZ.resize(vertexCount);
+        DecodeNormals(compressed, 0, vertexCount, mesh.mNX.data(), mesh.mNY.data(), mesh.mNZ.data());
+    }
+    mesh.mIndices.resize(compressed.mIndexCount);
+    if (DecodeIndices(compressed, 0, compressed.IndexBlockCount(), mesh.mIndices.data()) != compressed.mIndexCount)
+        mesh.mIndices.clear();
+    mesh.ComputeBounds();
+    return mesh;
+}
+
+void DecodePositions(const CompressedMeshView& mesh, size_t first, size_t count, float* x, float* y, float* z)
+{
+    const uint16_t* const qx = mesh.mQX + first;
+    const uint16_t* const qy = mesh.mQY + first;
+    const uint16_t* const qz = mesh.mQZ + first;
+    const glm::vec3 scale = Scale(mesh.mAabb);
+    const glm::vec3 lo = mesh.mAabb.mMin;
+
+    size_t i = 0;
+#ifdef RASTER_USE_SSE
+    const __m128i zero = _mm_setzero_si128();
+    const __m128 scaleX = _mm_set1_ps(scale.x), scaleY = _mm_set1_ps(scale.y), scaleZ = _mm_set1_ps(scale.z);
+    const __m128 loX = _mm_set1_ps(lo.x), loY = _mm_set1_ps(lo.y), loZ = _mm_set1_ps(lo.z);
+    auto decode8 = [&](const uint16_t* q, float* out, __m128 s, __m128 o) {
+        const __m128i packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(q));
+        const __m128 low = _mm_cvtepi32_ps(_mm_unpacklo_epi16(packed, zero));
+        const __m128 high = _mm_cvtepi32_ps(_mm_unpackhi_epi16(packed, zero));
+        _mm_storeu_ps(out, _mm_add_ps(_mm_mul_ps(low, s), o));
+        _mm_storeu_ps(out + 4, _mm_add_ps(_mm_mul_ps(high, s), o));
+    };
+    for (; i + 8 <= count; i += 8)
+    {
+        decode8(qx + i, x + i, scaleX, loX);
+        decode8(qy + i, y + i, scaleY, loY);
+        decode8(qz + i, z + i, scaleZ, loZ);
+    }
+#endif
+    for (; i < count; i++)
+    {
+        x[i] = static_cast<float>(qx[i]) * scale.x + lo.x;
+        y[i] = static_cast<float>(qy[i]) * scale.y + lo.y;
+        z[i] = static_cast<float>(qz[i]) * scale.z + lo.z;
+    }
+}
+
+void DecodeNormals(const CompressedMeshView& mesh, size_t first, size_t count, float* x, float* y, float* z)
+{
+    const uint16_t* const packed = mesh.mNormals + first;
+
+    size_t i = 0;
+#ifdef RASTER_USE_SSE
+    const __m128 inv127 = _mm_set1_ps(1.0f / 127.0f);
+    const __m128 minusOne = _mm_set1_ps(-1.0f);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    for (; i + 4 <= count; i += 4)
+    {
+        // x0 y0 x1 y1 .. as bytes, sign extended to 32 bit and split into x and y lanes
+        const __m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(packed + i));
+        const __m128i words = _mm_unpacklo_epi8(bytes, bytes);
+        const __m128 first2 = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(words, words), 24));
+        const __m128 last2 = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(words, words), 24));
+        __m128 nx = _mm_max_ps(_mm_mul_ps(_mm_shuffle_ps(first2, last2, _MM_SHUFFLE(2, 0, 2, 0)), inv127), minusOne);
+        __m128 ny = _mm_max_ps(_mm_mul_ps(_mm_shuffle_ps(first2, last2, _MM_SHUFFLE(3, 1, 3, 1)), inv127), minusOne);
+
+        const __m128 nz = _mm_sub_ps(_mm_sub_ps(one, _mm_andnot_ps(signMask, nx)), _mm_andnot_ps(signMask, ny));
+        const __m128 t = _mm_max_ps(_mm_sub_ps(zero, nz), zero);
+        nx = _mm_sub_ps(nx, _mm_or_ps(t, _mm_and_ps(nx, signMask)));
+        ny = _mm_sub_ps(ny, _mm_or_ps(t, _mm_and_ps(ny, signMask)));
+
+        const __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nx), _mm_mul_ps(ny, ny)), _mm_mul_ps(nz, nz)));
+        _mm_storeu_ps(x + i, _mm_div_ps(nx, length));
+        _mm_storeu_ps(y + i, _mm_div_ps(ny, length));
+        _mm_storeu_ps(z + i, _mm_div_ps(nz, length));
+    }
+#endif
+    for (; i < count; i++)
+    {
+        const glm::vec3 n = DecodeOctahedral(packed[i]);
+        x[i] = n.x;
+        y[i] = n.y;
+        z[i] = n.z;
+    }
+}
+
+size_t DecodeIndices(const CompressedMeshView& mesh, size_t firstBlock, size_t blockCount, uint32_t* out)
+{
+    const uint8_t* const end = mesh.mIndexStream + mesh.mIndexStreamSize;
+    size_t written = 0;
+    for (size_t block = firstBlock; block < firstBlock + blockCount; block++)
+    {
+        const size_t blockBegin = block * MESH_INDEX_BLOCK_SIZE;
+        const size_t blockSize = std::min(MESH_INDEX_BLOCK_SIZE, mesh.mIndexCount - blockBegin);
+        const uint8_t* control = mesh.mIndexStream + mesh.mIndexBlocks[block];
+        const uint8_t* data = control + (blockSize + 3) / 4;
+        if (data > end)
+            return 0;
+
+        // the lengths come from the control bytes, not from the data, so consecutive
+        // values don't wait on each other the way LEB128 bytes do. The deltas are summed
+        // unsigned, so the deltas of a malformed stream wrap instead of overflowing
+        uint32_t previous = 0;
+        for (size_t i = 0; i < blockSize; i++)
+        {
+            const uint32_t code = (control[i / 4] >> (i % 4 * 2)) & 3;
+            if (end - data < 4)
+                return 0;
+            uint32_t value;
+            std::memcpy(&value, data, sizeof(value));
+            data += code + 1;
+
+            previous += static_cast<uint32_t>(UnZigZag(value & LENGTH_MASKS[code]));
+            if (previous >= mesh.mVertexCount)
+                return 0;
+            out[written++] = previous;
+        }
+    }
+    return written;
+}
+
+bool ValidateIndices(const CompressedMeshView& mesh)
+{
+    std::vector<uint32_t> block(MESH_INDEX_BLOCK_SIZE);
+    for (size_t i = 0; i < mesh.IndexBlockCount(); i++)
+    {
+        const size_t expected = std::min(MESH_INDEX_BLOCK_SIZE, mesh.mIndexCount - i * MESH_INDEX_BLOCK_SIZE);
+        if (DecodeIndices(mesh, i, 1, block.data()) != expected)
+            return false;
+    }
+    return true;
+}
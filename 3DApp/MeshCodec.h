@@ -0,0 +1,74 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "Mesh.h"
+
+// Compressed mesh streams:
+//   positions: 16 bit per component, quantized over the mesh AABB
+//   normals:   octahedral, two signed 8 bit components per vertex
+//   indices:   zigzag delta to the previous index in a 1-4 byte varint whose length
+//              sits in 2 bit control fields ahead of the data (stream vbyte), restarting
+//              every MESH_INDEX_BLOCK_SIZE indices so blocks decode independently
+// Vertices are renumbered in first use order before encoding, which keeps the deltas
+// small; run a vertex cache optimizer on the mesh first for the best result.
+constexpr size_t MESH_INDEX_BLOCK_SIZE = 1024;
+
+// Non-owning view, either of a CompressedMesh or of a memory mapped mesh file.
+struct CompressedMeshView
+{
+    const uint16_t* mQX = nullptr;
+    const uint16_t* mQY = nullptr;
+    const uint16_t* mQZ = nullptr;
+    const uint16_t* mNormals = nullptr; // optional
+    const uint8_t* mIndexStream = nullptr;
+    const uint32_t* mIndexBlocks = nullptr; // byte offset of each index block in mIndexStream
+    size_t mIndexStreamSize = 0;
+    size_t mVertexCount = 0;
+    size_t mIndexCount = 0;
+    BoundingSphere mBounds;
+    Aabb mAabb;
+
+    size_t VertexCount() const { return mVertexCount; }
+    size_t TriangleCount() const { return mIndexCount / 3; }
+    size_t IndexBlockCount() const { return (mIndexCount + MESH_INDEX_BLOCK_SIZE - 1) / MESH_INDEX_BLOCK_SIZE; }
+    bool HasNormals() const { return mNormals != nullptr; }
+
+    // maps quantized positions to object space: p = Dequantize() * vec4(q, 1)
+    glm::mat4 Dequantize() const;
+};
+
+struct CompressedMesh
+{
+    std::vector<uint16_t> mQX;
+    std::vector<uint16_t> mQY;
+    std::vector<uint16_t> mQZ;
+    std::vector<uint16_t> mNormals;
+    std::vector<uint8_t> mIndexStream;
+    std::vector<uint32_t> mIndexBlocks;
+    size_t mIndexCount = 0;
+    BoundingSphere mBounds;
+    Aabb mAabb;
+
+    size_t VertexCount() const { return mQX.size(); }
+    CompressedMeshView View() const;
+};
+
+// Bounds must be up to date (Mesh::ComputeBounds).
+CompressedMesh EncodeMesh(const Mesh& mesh);
+
+// Decodes everything, for load time.
+Mesh DecodeMesh(const CompressedMeshView& mesh);
+
+// Range decoders for streaming straight into the vertex stage, SSE where available.
+void DecodePositions(const CompressedMeshView& mesh, size_t first, size_t count, float* x, float* y, float* z);
+void DecodeNormals(const CompressedMeshView& mesh, size_t first, size_t count, float* x, float* y, float* z);
+// Decodes index blocks [firstBlock, firstBlock + blockCount) into `out`, returns the
+// number of indices written. Returns 0 on a malformed stream.
+size_t DecodeIndices(const CompressedMeshView& mesh, size_t firstBlock, size_t blockCount, uint32_t* out);
+// True if every index block decodes, to check a stream once instead of on every draw.
+bool ValidateIndices(const CompressedMeshView& mesh);
+
+// Octahedral normal encoding, two snorm8 packed x | y << 8.
+uint16_t EncodeOctahedral(const glm::vec3& normal);
+glm::vec3 DecodeOctahedral(uint16_t packed);
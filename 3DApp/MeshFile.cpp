@@ -0,0 +1,441 @@
+#include "MeshFile.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+    uint64_t AlignUp(uint64_t value, uint64_t alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+
+    bool Fail(const std::string& path, const char* reason)
+    {
+        std::cerr << "MeshFile: " << path << ": " << reason << std::endl;
+        return false;
+    }
+
+    struct Payload
+    {
+        MeshSection mType;
+        const void* mData;
+        uint64_t mSize;
+    };
+
+    MeshFileHeader MakeHeader(uint32_t indexSize, uint64_t vertexCount, uint64_t indexCount, const Aabb& aabb, const BoundingSphere& bounds)
+    {
+        MeshFileHeader header = {};
+        std::memcpy(header.mMagic, MESH_FILE_MAGIC, sizeof(MESH_FILE_MAGIC));
+        header.mVersion = MESH_FILE_VERSION;
+        header.mIndexSize = indexSize;
+        header.mVertexCount = vertexCount;
+        header.mIndexCount = indexCount;
+        for (int i = 0; i < 3; i++)
+        {
+            header.mAabbMin[i] = aabb.mMin[i];
+            header.mAabbMax[i] = aabb.mMax[i];
+            header.mSphereCenter[i] = bounds.mCenter[i];
+        }
+        header.mSphereRadius = bounds.mRadius;
+        return header;
+    }
+
+    // fills in the section count and lays the payloads out after the section table,
+    // offsets are relative to the stream position on entry
+    bool WriteSections(std::ostream& out, MeshFileHeader header, const std::vector<Payload>& payloads)
+    {
+        const uint32_t sectionCount = static_cast<uint32_t>(payloads.size());
+        header.mSectionCount = sectionCount;
+
+        std::vector<MeshFileSection> sections(sectionCount);
+        const uint64_t tableSize = sectionCount * sizeof(MeshFileSection);
+        uint64_t offset = AlignUp(sizeof(MeshFileHeader) + tableSize, MESH_FILE_ALIGNMENT);
+        for (uint32_t i = 0; i < sectionCount; i++)
+        {
+            sections[i].mType = static_cast<uint32_t>(payloads[i].mType);
+            sections[i].mOffset = offset;
+            sections[i].mSize = payloads[i].mSize;
+            offset = AlignUp(offset + payloads[i].mSize, MESH_FILE_ALIGNMENT);
+        }
+
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(sections.data()), static_cast<std::streamsize>(tableSize));
+        uint64_t written = sizeof(header) + tableSize;
+        const char padding[MESH_FILE_ALIGNMENT] = {};
+        for (uint32_t i = 0; i < sectionCount; i++)
+        {
+            out.write(padding, static_cast<std::streamsize>(sections[i].mOffset - written));
+            out.write(static_cast<const char*>(payloads[i].mData), static_cast<std::streamsize>(payloads[i].mSize));
+            written = sections[i].mOffset + payloads[i].mSize;
+        }
+        return static_cast<bool>(out);
+    }
+
+    // every level's indices below the vertex count it uses
+    bool IndicesInRange(const MeshView& mesh)
+    {
+        for (size_t level = 0; level < mesh.LevelCount(); level++)
+        {
+            const MeshView view = mesh.Level(level);
+            for (size_t i = 0; i < view.mIndexCount; i++)
+            {
+                if (view.Index(i) >= view.mVertexCount)
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    template <typename MeshType>
+    bool WriteToPath(const std::string& path, const MeshType& mesh)
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if (!out)
+            return Fail(path, "can't open for writing");
+        if (!WriteMeshFile(out, mesh))
+            return Fail(path, "write failed");
+        return true;
+    }
+}
+
+bool MeshFile::Open(const std::string& path)
+{
+    Close();
+
+    if (!mFile.Open(path))
+        return Fail(path, "can't map the file");
+    return Parse(mFile.Data(), mFile.Size(), path);
+}
+
+bool MeshFile::OpenMemory(const void* data, size_t size, const std::string& name)
+{
+    Close();
+    return Parse(static_cast<const unsigned char*>(data), size, name);
+}
+
+bool MeshFile::Parse(const unsigned char* data, uint64_t fileSize, const std::string& path)
+{
+    if (fileSize < sizeof(MeshFileHeader))
+        return Fail(path, "truncated header");
+
+    const MeshFileHeader* header = reinterpret_cast<const MeshFileHeader*>(data);
+    if (std::memcmp(header->mMagic, MESH_FILE_MAGIC, sizeof(MESH_FILE_MAGIC)) != 0)
+        return Fail(path, "not a mesh file");
+    if (header->mVersion != MESH_FILE_VERSION)
+        return Fail(path, "unsupported version");
+    if (header->mIndexSize != 2 && header->mIndexSize != 4)
+        return Fail(path, "bad index size");
+    if (header->mIndexCount % 3 != 0)
+        return Fail(path, "index count isn't a multiple of 3");
+    if (sizeof(MeshFileHeader) + static_cast<uint64_t>(header->mSectionCount) * sizeof(MeshFileSection) > fileSize)
+        return Fail(path, "truncated section table");
+
+    const MeshFileSection* sections = reinterpret_cast<const MeshFileSection*>(data + sizeof(MeshFileHeader));
+    for (uint32_t i = 0; i < header->mSectionCount; i++)
+    {
+        const MeshFileSection& section = sections[i];
+        if (section.mOffset % MESH_FILE_ALIGNMENT != 0)
+            return Fail(path, "misaligned section");
+        if (section.mOffset > fileSize || section.mSize > fileSize - section.mOffset)
+            return Fail(path, "section out of bounds");
+    }
+
+    mData = data;
+    mHeader = header;
+    mSections = sections;
+
+    const bool loaded = FindSection(MeshSection::PositionX) ? LoadRaw(fileSize) : LoadCompressed(fileSize);
+    if (!loaded)
+    {
+        Close();
+        return Fail(path, "missing or mis-sized vertex/index section");
+    }
+
+    const Aabb aabb = { glm::vec3(header->mAabbMin[0], header->mAabbMin[1], header->mAabbMin[2]),
+        glm::vec3(header->mAabbMax[0], header->mAabbMax[1], header->mAabbMax[2]) };
+    BoundingSphere bounds;
+    bounds.mCenter = glm::vec3(header->mSphereCenter[0], header->mSphereCenter[1], header->mSphereCenter[2]);
+    bounds.mRadius = header->mSphereRadius;
+    if (IsCompressed())
+    {
+        mCompressedView.mVertexCount = static_cast<size_t>(header->mVertexCount);
+        mCompressedView.mIndexCount = static_cast<size_t>(header->mIndexCount);
+        mCompressedView.mAabb = aabb;
+        mCompressedView.mBounds = bounds;
+        // draws decode the indices every frame, a bad stream is refused once here
+        if (!ValidateIndices(mCompressedView))
+        {
+            Close();
+            return Fail(path, "malformed index stream");
+        }
+    }
+    else
+    {
+        mView.mIndexSize = header->mIndexSize;
+        mView.mVertexCount = static_cast<size_t>(header->mVertexCount);
+        mView.mIndexCount = static_cast<size_t>(header->mIndexCount);
+        mView.mAabb = aabb;
+        mView.mBounds = bounds;
+        // the rasterizer indexes the vertex streams with these directly
+        if (!IndicesInRange(mView))
+        {
+            Close();
+            return Fail(path, "index out of range");
+        }
+    }
+    return true;
+}
+
+bool MeshFile::LoadRaw(uint64_t fileSize)
+{
+    // counts no section could hold would wrap the sizes below
+    if (mHeader->mVertexCount > fileSize / sizeof(float) || mHeader->mIndexCount > fileSize / mHeader->mIndexSize)
+        return false;
+
+    const uint64_t positionSize = mHeader->mVertexCount * sizeof(float);
+    const MeshFileSection* x = FindSection(MeshSection::PositionX);
+    const MeshFileSection* y = FindSection(MeshSection::PositionY);
+    const MeshFileSection* z = FindSection(MeshSection::PositionZ);
+    const MeshFileSection* indices = FindSection(MeshSection::Indices);
+    if (!x || !y || !z || !indices
+        || x->mSize != positionSize || y->mSize != positionSize || z->mSize != positionSize
+        || indices->mSize != mHeader->mIndexCount * mHeader->mIndexSize)
+        return false;
+
+    mView.mX = static_cast<const float*>(SectionData(*x));
+    mView.mY = static_cast<const float*>(SectionData(*y));
+    mView.mZ = static_cast<const float*>(SectionData(*z));
+    mView.mIndices = SectionData(*indices);
+
+    const MeshFileSection* nx = FindSection(MeshSection::NormalX);
+    const MeshFileSection* ny = FindSection(MeshSection::NormalY);
+    const MeshFileSection* nz = FindSection(MeshSection::NormalZ);
+    if (nx && ny && nz && nx->mSize == positionSize && ny->mSize == positionSize && nz->mSize == positionSize)
+    {
+        mView.mNX = static_cast<const float*>(SectionData(*nx));
+        mView.mNY = static_cast<const float*>(SectionData(*ny));
+        mView.mNZ = static_cast<const float*>(SectionData(*nz));
+    }
+
+    const MeshFileSection* lodTable = FindSection(MeshSection::LodTable);
+    const MeshFileSection* lodIndices = FindSection(MeshSection::LodIndices);
+    if (lodTable && lodIndices && lodTable->mSize % sizeof(MeshLod) == 0 && lodIndices->mSize % mHeader->mIndexSize == 0)
+    {
+        const MeshLod* lods = static_cast<const MeshLod*>(SectionData(*lodTable));
+        const size_t lodCount = static_cast<size_t>(lodTable->mSize / sizeof(MeshLod));
+        const uint64_t lodIndexCount = lodIndices->mSize / mHeader->mIndexSize;
+        bool valid = true;
+        for (size_t i = 0; i < lodCount; i++)
+        {
+            valid = valid && lods[i].mIndexCount % 3 == 0
+                && static_cast<uint64_t>(lods[i].mFirstIndex) + lods[i].mIndexCount <= lodIndexCount
+                && lods[i].mVertexCount <= mHeader->mVertexCount;
+        }
+        // a broken table only costs the levels, the full mesh is still usable
+        if (valid)
+        {
+            mView.mLods = lods;
+            mView.mLodCount = lodCount;
+            mView.mLodIndices = SectionData(*lodIndices);
+        }
+    }
+
+    LoadMeshlets();
+    return true;
+}
+
+void MeshFile::LoadMeshlets()
+{
+    const MeshFileSection* table = FindSection(MeshSection::MeshletTable);
+    const MeshFileSection* vertices = FindSection(MeshSection::MeshletVertices);
+    const MeshFileSection* triangles = FindSection(MeshSection::MeshletTriangles);
+    if (!table || !vertices || !triangles || table->mSize % sizeof(Meshlet) != 0 || vertices->mSize % sizeof(uint32_t) != 0)
+        return;
+
+    // the rasterizer indexes with these directly, so everything is checked once here;
+    // like the levels, broken meshlets only cost the culling
+    const Meshlet* meshlets = static_cast<const Meshlet*>(SectionData(*table));
+    const size_t meshletCount = static_cast<size_t>(table->mSize / sizeof(Meshlet));
+    const uint32_t* vertexData = static_cast<const uint32_t*>(SectionData(*vertices));
+    const uint8_t* triangleData = static_cast<const uint8_t*>(SectionData(*triangles));
+    const uint64_t vertexCount = vertices->mSize / sizeof(uint32_t);
+    for (size_t i = 0; i < meshletCount; i++)
+    {
+        const Meshlet& meshlet = meshlets[i];
+        if (meshlet.mVertexCount > MESHLET_VERTEX_LIMIT
+            || static_cast<uint64_t>(meshlet.mVertexOffset) + meshlet.mVertexCount > vertexCount
+            || static_cast<uint64_t>(meshlet.mTriangleOffset) + meshlet.mTriangleCount * 3ull > triangles->mSize)
+            return;
+        for (uint32_t v = 0; v < meshlet.mVertexCount; v++)
+        {
+            if (vertexData[meshlet.mVertexOffset + v] >= mHeader->mVertexCount)
+                return;
+        }
+        for (uint32_t t = 0; t < meshlet.mTriangleCount * 3; t++)
+        {
+            if (triangleData[meshlet.mTriangleOffset + t] >= meshlet.mVertexCount)
+                return;
+        }
+    }
+
+    mView.mMeshlets = meshlets;
+    mView.mMeshletCount = meshletCount;
+    mView.mMeshletVertices = vertexData;
+    mView.mMeshletTriangles = triangleData;
+}
+
+bool MeshFile::LoadCompressed(uint64_t fileSize)
+{
+    // every index takes at least a byte of the stream
+    if (mHeader->mVertexCount > fileSize / sizeof(uint16_t) || mHeader->mIndexCount > fileSize)
+        return false;
+
+    const uint64_t quantizedSize = mHeader->mVertexCount * sizeof(uint16_t);
+    const uint64_t blockCount = (mHeader->mIndexCount + MESH_INDEX_BLOCK_SIZE - 1) / MESH_INDEX_BLOCK_SIZE;
+    const MeshFileSection* x = FindSection(MeshSection::QuantizedX);
+    const MeshFileSection* y = FindSection(MeshSection::QuantizedY);
+    const MeshFileSection* z = FindSection(MeshSection::QuantizedZ);
+    const MeshFileSection* stream = FindSection(MeshSection::IndexStream);
+    const MeshFileSection* blocks = FindSection(MeshSection::IndexBlocks);
+    if (!x || !y || !z || !stream || !blocks
+        || x->mSize != quantizedSize || y->mSize != quantizedSize || z->mSize != quantizedSize
+        || blocks->mSize != blockCount * sizeof(uint32_t))
+        return false;
+
+    // the decoder trusts the block offsets, everything past them is bounds checked
+    const uint32_t* blockOffsets = static_cast<const uint32_t*>(SectionData(*blocks));
+    for (uint64_t i = 0; i < blockCount; i++)
+    {
+        if (blockOffsets[i] > stream->mSize)
+            return false;
+    }
+
+    mCompressedView.mQX = static_cast<const uint16_t*>(SectionData(*x));
+    mCompressedView.mQY = static_cast<const uint16_t*>(SectionData(*y));
+    mCompressedView.mQZ = static_cast<const uint16_t*>(SectionData(*z));
+    mCompressedView.mIndexStream = static_cast<const uint8_t*>(SectionData(*stream));
+    mCompressedView.mIndexStreamSize = static_cast<size_t>(stream->mSize);
+    mCompressedView.mIndexBlocks = blockOffsets;
+
+    const MeshFileSection* normals = FindSection(MeshSection::OctahedralNormals);
+    if (normals && normals->mSize == quantizedSize)
+        mCompressedView.mNormals = static_cast<const uint16_t*>(SectionData(*normals));
+    return true;
+}
+
+void MeshFile::Close()
+{
+    mFile.Close();
+    mData = nullptr;
+    mHeader = nullptr;
+    mSections = nullptr;
+    mView = MeshView();
+    mCompressedView = CompressedMeshView();
+}
+
+const MeshFileSection* MeshFile::FindSection(MeshSection type) const
+{
+    if (mHeader == nullptr)
+        return nullptr;
+    for (uint32_t i = 0; i < mHeader->mSectionCount; i++)
+    {
+        if (mSections[i].mType == static_cast<uint32_t>(type))
+            return &mSections[i];
+    }
+    return nullptr;
+}
+
+bool WriteMeshFile(const std::string& path, const Mesh& mesh)
+{
+    return WriteToPath(path, mesh);
+}
+
+bool WriteMeshFile(const std::string& path, const CompressedMesh& mesh)
+{
+    return WriteToPath(path, mesh);
+}
+
+bool WriteMeshFile(std::ostream& out, const Mesh& mesh)
+{
+    return WriteMeshFile(out, mesh.View());
+}
+
+bool WriteMeshFile(std::ostream& out, const MeshView& mesh)
+{
+    // the view doesn't know its buffer sizes, they end where the last range ends
+    size_t lodIndexCount = 0;
+    for (size_t i = 0; i < mesh.mLodCount; i++)
+        lodIndexCount = std::max<size_t>(lodIndexCount, static_cast<size_t>(mesh.mLods[i].mFirstIndex) + mesh.mLods[i].mIndexCount);
+    size_t meshletVertexCount = 0;
+    size_t meshletTriangleBytes = 0;
+    for (size_t i = 0; i < mesh.mMeshletCount; i++)
+    {
+        const Meshlet& meshlet = mesh.mMeshlets[i];
+        meshletVertexCount = std::max<size_t>(meshletVertexCount, static_cast<size_t>(meshlet.mVertexOffset) + meshlet.mVertexCount);
+        meshletTriangleBytes = std::max<size_t>(meshletTriangleBytes, static_cast<size_t>(meshlet.mTriangleOffset) + meshlet.mTriangleCount * 3);
+    }
+
+    const bool shortIndices = mesh.VertexCount() <= 0x10000;
+    std::vector<uint16_t> indices16;
+    std::vector<uint16_t> lodIndices16;
+    if (shortIndices && mesh.mIndexSize == 4)
+    {
+        const uint32_t* indices = static_cast<const uint32_t*>(mesh.mIndices);
+        const uint32_t* lodIndices = static_cast<const uint32_t*>(mesh.mLodIndices);
+        indices16.assign(indices, indices + mesh.mIndexCount);
+        if (lodIndexCount != 0)
+            lodIndices16.assign(lodIndices, lodIndices + lodIndexCount);
+    }
+    const bool converted = shortIndices && mesh.mIndexSize == 4;
+    const uint64_t indexSize = shortIndices ? sizeof(uint16_t) : sizeof(uint32_t);
+
+    const uint64_t positionSize = mesh.VertexCount() * sizeof(float);
+    std::vector<Payload> payloads = {
+        { MeshSection::PositionX, mesh.mX, positionSize },
+        { MeshSection::PositionY, mesh.mY, positionSize },
+        { MeshSection::PositionZ, mesh.mZ, positionSize },
+        { MeshSection::Indices, converted ? static_cast<const void*>(indices16.data()) : mesh.mIndices, mesh.mIndexCount * indexSize },
+    };
+    if (mesh.HasNormals())
+    {
+        payloads.push_back({ MeshSection::NormalX, mesh.mNX, positionSize });
+        payloads.push_back({ MeshSection::NormalY, mesh.mNY, positionSize });
+        payloads.push_back({ MeshSection::NormalZ, mesh.mNZ, positionSize });
+    }
+    if (mesh.mLodCount != 0)
+    {
+        payloads.push_back({ MeshSection::LodTable, mesh.mLods, mesh.mLodCount * sizeof(MeshLod) });
+        payloads.push_back({ MeshSection::LodIndices,
+            converted ? static_cast<const void*>(lodIndices16.data()) : mesh.mLodIndices, lodIndexCount * indexSize });
+    }
+    if (mesh.mMeshletCount != 0)
+    {
+        payloads.push_back({ MeshSection::MeshletTable, mesh.mMeshlets, mesh.mMeshletCount * sizeof(Meshlet) });
+        payloads.push_back({ MeshSection::MeshletVertices, mesh.mMeshletVertices, meshletVertexCount * sizeof(uint32_t) });
+        payloads.push_back({ MeshSection::MeshletTriangles, mesh.mMeshletTriangles, meshletTriangleBytes });
+    }
+
+    const MeshFileHeader header = MakeHeader(static_cast<uint32_t>(indexSize), mesh.VertexCount(), mesh.mIndexCount, mesh.mAabb, mesh.mBounds);
+    return WriteSections(out, header, payloads);
+}
+
+bool WriteMeshFile(std::ostream& out, const CompressedMesh& mesh)
+{
+    const uint64_t quantizedSize = mesh.VertexCount() * sizeof(uint16_t);
+    std::vector<Payload> payloads = {
+        { MeshSection::QuantizedX, mesh.mQX.data(), quantizedSize },
+        { MeshSection::QuantizedY, mesh.mQY.data(), quantizedSize },
+        { MeshSection::QuantizedZ, mesh.mQZ.data(), quantizedSize },
+        { MeshSection::IndexStream, mesh.mIndexStream.data(), mesh.mIndexStream.size() },
+        { MeshSection::IndexBlocks, mesh.mIndexBlocks.data(), mesh.mIndexBlocks.size() * sizeof(uint32_t) },
+    };
+    if (!mesh.mNormals.empty())
+        payloads.push_back({ MeshSection::OctahedralNormals, mesh.mNormals.data(), quantizedSize });
+
+    // the index size doesn't apply to the compressed stream, 4 keeps the header valid
+    const MeshFileHeader header = MakeHeader(4, mesh.VertexCount(), mesh.mIndexCount, mesh.mAabb, mesh.mBounds);
+    return WriteSections(out, header, payloads);
+}
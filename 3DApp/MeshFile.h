@@ -0,0 +1,120 @@
+#pragma once
+#include <string>
+#include <ostream>
+#include <cstdint>
+#include "Mesh.h"
+#include "MeshCodec.h"
+#include "MappedFile.h"
+
+// Binary mesh format (.r3dm), meant to be memory mapped and used in place.
+// Layout, little endian:
+//   MeshFileHeader
+//   MeshFileSection[mSectionCount]
+//   section payloads, each starting on a MESH_FILE_ALIGNMENT boundary
+// Positions are stored as separate x/y/z float streams, indices as 16 bit when the
+// vertex count allows it. Compressed files carry the MeshCodec streams instead.
+// Readers skip section types they don't know, so sections can be added without
+// breaking older files; mVersion only changes when existing sections change meaning.
+constexpr char MESH_FILE_MAGIC[4] = { 'R', '3', 'D', 'M' };
+constexpr uint32_t MESH_FILE_VERSION = 1;
+constexpr uint64_t MESH_FILE_ALIGNMENT = 64;
+
+enum class MeshSection : uint32_t
+{
+    PositionX = 1,
+    PositionY = 2,
+    PositionZ = 3,
+    Indices = 4,
+    NormalX = 5, // optional, sized like the positions
+    NormalY = 6,
+    NormalZ = 7,
+    // compressed streams (MeshCodec.h), stored instead of the sections above
+    QuantizedX = 8,
+    QuantizedY = 9,
+    QuantizedZ = 10,
+    OctahedralNormals = 11, // optional
+    IndexStream = 12,
+    IndexBlocks = 13,
+    // optional levels of detail of uncompressed meshes
+    LodTable = 14,   // MeshLod[]
+    LodIndices = 15, // same index size as Indices
+    // optional clusters of uncompressed meshes
+    MeshletTable = 16,     // Meshlet[]
+    MeshletVertices = 17,  // uint32_t
+    MeshletTriangles = 18, // uint8_t
+};
+
+struct MeshFileHeader
+{
+    char mMagic[4];
+    uint32_t mVersion;
+    uint32_t mSectionCount;
+    uint32_t mIndexSize; // 2 or 4
+    uint64_t mVertexCount;
+    uint64_t mIndexCount;
+    float mAabbMin[3];
+    float mAabbMax[3];
+    float mSphereCenter[3];
+    float mSphereRadius;
+};
+
+struct MeshFileSection
+{
+    uint32_t mType; // MeshSection
+    uint32_t mReserved;
+    uint64_t mOffset; // from the start of the file
+    uint64_t mSize;   // in bytes
+};
+
+static_assert(sizeof(MeshFileHeader) == 72, "MeshFileHeader layout is part of the file format");
+static_assert(sizeof(MeshFileSection) == 24, "MeshFileSection layout is part of the file format");
+static_assert(sizeof(MeshLod) == 16, "MeshLod layout is part of the file format");
+static_assert(sizeof(Meshlet) == 48, "Meshlet layout is part of the file format");
+
+// A mapped .r3dm file. Open() only validates the header and section table, the
+// vertex and index data is used straight from the mapping.
+class MeshFile
+{
+private:
+    MappedFile mFile;
+    const unsigned char* mData = nullptr;
+    const MeshFileHeader* mHeader = nullptr;
+    const MeshFileSection* mSections = nullptr;
+    MeshView mView;
+    CompressedMeshView mCompressedView;
+
+    bool Parse(const unsigned char* data, uint64_t size, const std::string& name);
+    bool LoadRaw(uint64_t fileSize);
+    void LoadMeshlets();
+    bool LoadCompressed(uint64_t fileSize);
+
+public:
+    // Prints the reason to std::cerr and returns false when the file can't be used.
+    bool Open(const std::string& path);
+    // Uses a file image already in memory, which has to outlive the MeshFile and be
+    // aligned to at least 8 bytes, the header and section table are read in place.
+    // Sections are MESH_FILE_ALIGNMENT aligned relative to the start of the image.
+    // `name` is only for messages.
+    bool OpenMemory(const void* data, size_t size, const std::string& name);
+    void Close();
+
+    bool IsOpen() const { return mHeader != nullptr; }
+    const MeshFileHeader& Header() const { return *mHeader; }
+    // Exactly one of the two is filled, depending on how the file was written.
+    bool IsCompressed() const { return mCompressedView.mQX != nullptr; }
+    const MeshView& View() const { return mView; }
+    const CompressedMeshView& CompressedView() const { return mCompressedView; }
+
+    // nullptr if the file has no such section
+    const MeshFileSection* FindSection(MeshSection type) const;
+    const void* SectionData(const MeshFileSection& section) const { return mData + section.mOffset; }
+};
+
+bool WriteMeshFile(const std::string& path, const Mesh& mesh);
+bool WriteMeshFile(const std::string& path, const CompressedMesh& mesh);
+// Writes the file image at the stream's current position, section offsets stay
+// relative to where it starts.
+bool WriteMeshFile(std::ostream& out, const Mesh& mesh);
+bool WriteMeshFile(std::ostream& out, const CompressedMesh& mesh);
+// Views with 2 byte indices are written as they are, so are meshes mapped from a file.
+bool WriteMeshFile(std::ostream& out, const MeshView& mesh);
@@ -0,0 +1,307 @@
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+    const uint32_t UNUSED = 0xffffffffu;
+
+    // Forsyth's parameters, tuned for caches of 16-32 entries
+    const int FORSYTH_CACHE_SIZE = 32;
+    const float CACHE_DECAY_POWER = 1.5f;
+    const float LAST_TRIANGLE_SCORE = 0.75f;
+    const float VALENCE_BOOST_SCALE = 2.0f;
+    const float VALENCE_BOOST_POWER = 0.5f;
+    const uint32_t VALENCE_TABLE_SIZE = 64;
+
+    struct ScoreTables
+    {
+        float mCache[FORSYTH_CACHE_SIZE];
+        float mValence[VALENCE_TABLE_SIZE];
+
+        ScoreTables()
+        {
+            for (int i = 0; i < FORSYTH_CACHE_SIZE; i++)
+            {
+                // the last triangle's vertices get a fixed score so it isn't simply repeated
+                mCache[i] = i < 3 ? LAST_TRIANGLE_SCORE
+                    : std::pow(1.0f - (i - 3) / static_cast<float>(FORSYTH_CACHE_SIZE - 3), CACHE_DECAY_POWER);
+            }
+            mValence[0] = 0.0f;
+            for (uint32_t i = 1; i < VALENCE_TABLE_SIZE; i++)
+                mValence[i] = VALENCE_BOOST_SCALE * std::pow(static_cast<float>(i), -VALENCE_BOOST_POWER);
+        }
+    };
+
+    float VertexScore(const ScoreTables& tables, int cachePosition, uint32_t valence)
+    {
+        if (valence == 0)
+            return -1.0f;
+        const float cacheScore = cachePosition >= 0 ? tables.mCache[cachePosition] : 0.0f;
+        const float valenceScore = valence < VALENCE_TABLE_SIZE ? tables.mValence[valence]
+            : VALENCE_BOOST_SCALE * std::pow(static_cast<float>(valence), -VALENCE_BOOST_POWER);
+        return cacheScore + valenceScore;
+    }
+
+    // FIFO cache simulation through timestamps: a vertex hits if it was loaded less than
+    // cacheSize misses ago, and after `epoch` so clusters can start with a cold cache
+    struct FifoCache
+    {
+        std::vector<uint32_t> mLoadedAt;
+        uint32_t mMisses = 0;
+        unsigned mSize;
+
+        FifoCache(size_t vertexCount, unsigned size) : mLoadedAt(vertexCount, 0), mSize(size) {}
+
+        bool Access(uint32_t vertex, uint32_t epoch)
+        {
+            // timestamps start at 1, 0 means never loaded
+            const uint32_t loadedAt = mLoadedAt[vertex];
+            if (loadedAt != 0 && loadedAt > epoch && mMisses + 1 - loadedAt <= mSize)
+                return true;
+            mLoadedAt[vertex] = ++mMisses;
+            return false;
+        }
+    };
+}
+
+float ComputeAcmr(const uint32_t* indices, size_t indexCount, size_t vertexCount, unsigned cacheSize)
+{
+    if (indexCount < 3)
+        return 0.0f;
+    FifoCache cache(vertexCount, cacheSize);
+    for (size_t i = 0; i < indexCount; i++)
+        cache.Access(indices[i], 0);
+    return cache.mMisses / static_cast<float>(indexCount / 3);
+}
+
+void OptimizeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t* out)
+{
+    static const ScoreTables tables;
+    const size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0)
+        return;
+
+    // triangles of each vertex, the live ones first: mLive[v] entries from mOffsets[v]
+    std::vector<uint32_t> offsets(vertexCount + 1, 0);
+    for (size_t i = 0; i < indexCount; i++)
+        offsets[indices[i] + 1]++;
+    for (size_t v = 0; v < vertexCount; v++)
+        offsets[v + 1] += offsets[v];
+    std::vector<uint32_t> live(vertexCount, 0);
+    std::vector<uint32_t> adjacency(indexCount);
+    for (size_t i = 0; i < indexCount; i++)
+    {
+        const uint32_t v = indices[i];
+        adjacency[offsets[v] + live[v]++] = static_cast<uint32_t>(i / 3);
+    }
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScore(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+        vertexScore[v] = VertexScore(tables, -1, live[v]);
+
+    std::vector<bool> emitted(triangleCount, false);
+    uint32_t cache[FORSYTH_CACHE_SIZE + 3];
+    uint32_t newCache[FORSYTH_CACHE_SIZE + 3];
+    int cacheSize = 0;
+    size_t best = UNUSED;
+    size_t cursor = 0;
+
+    for (size_t n = 0; n < triangleCount; n++)
+    {
+        if (best == UNUSED)
+        {
+            // nothing adjacent to the cache is left, continue in input order
+            while (emitted[cursor])
+                cursor++;
+            best = cursor;
+        }
+
+        const uint32_t* triangle = indices + best * 3;
+        out[n * 3] = triangle[0];
+        out[n * 3 + 1] = triangle[1];
+        out[n * 3 + 2] = triangle[2];
+        emitted[best] = true;
+
+        int newSize = 0;
+        for (int k = 0; k < 3; k++)
+        {
+            const uint32_t v = triangle[k];
+            uint32_t* begin = &adjacency[offsets[v]];
+            uint32_t* end = begin + live[v];
+            std::iter_swap(std::find(begin, end, static_cast<uint32_t>(best)), end - 1);
+            live[v]--;
+            newCache[newSize++] = v;
+        }
+        for (int i = 0; i < cacheSize; i++)
+        {
+            const uint32_t v = cache[i];
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+                newCache[newSize++] = v;
+        }
+
+        // rescore everything that moved in the cache, including what fell out of it
+        for (int i = 0; i < newSize; i++)
+        {
+            const uint32_t v = newCache[i];
+            cachePosition[v] = i < FORSYTH_CACHE_SIZE ? i : -1;
+            vertexScore[v] = VertexScore(tables, cachePosition[v], live[v]);
+        }
+
+        best = UNUSED;
+        float bestScore = -1.0f;
+        for (int i = 0; i < newSize; i++)
+        {
+            const uint32_t v = newCache[i];
+            for (uint32_t a = 0; a < live[v]; a++)
+            {
+                const uint32_t t = adjacency[offsets[v] + a];
+                const float score = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+                if (score > bestScore)
+                {
+                    bestScore = score;
+                    best = t;
+                }
+            }
+        }
+
+        cacheSize = std::min(newSize, FORSYTH_CACHE_SIZE);
+        std::copy(newCache, newCache + cacheSize, cache);
+    }
+}
+
+void OptimizeOverdraw(const uint32_t* indices, size_t indexCount, const MeshView& mesh, uint32_t* out, float threshold)
+{
+    const size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0)
+        return;
+
+    const unsigned cacheSize = 16;
+    const float targetAcmr = ComputeAcmr(indices, indexCount, mesh.VertexCount(), cacheSize) * threshold;
+
+    // a cluster ends once its cold cache ACMR is close enough to the whole buffer's,
+    // so moving it around costs little vertex reuse
+    std::vector<size_t> clusterStarts;
+    FifoCache cache(mesh.VertexCount(), cacheSize);
+    uint32_t epoch = 0;
+    size_t clusterTriangles = 0;
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        if (clusterTriangles == 0)
+        {
+            clusterStarts.push_back(t);
+            epoch = cache.mMisses;
+        }
+        for (int k = 0; k < 3; k++)
+            cache.Access(indices[t * 3 + k], epoch);
+        clusterTriangles++;
+        if ((cache.mMisses - epoch) <= targetAcmr * clusterTriangles)
+            clusterTriangles = 0;
+    }
+
+    auto position = [&](uint32_t v) { return glm::vec3(mesh.mX[v], mesh.mY[v], mesh.mZ[v]); };
+
+    // area weighted centroid and normal per cluster
+    const size_t clusterCount = clusterStarts.size();
+    std::vector<glm::vec3> centroids(clusterCount, glm::vec3(0.0f));
+    std::vector<glm::vec3> normals(clusterCount, glm::vec3(0.0f));
+    std::vector<float> areas(clusterCount, 0.0f);
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+    for (size_t c = 0; c < clusterCount; c++)
+    {
+        const size_t end = c + 1 < clusterCount ? clusterStarts[c + 1] : triangleCount;
+        for (size_t t = clusterStarts[c]; t < end; t++)
+        {
+            const glm::vec3 a = position(indices[t * 3]);
+            const glm::vec3 b = position(indices[t * 3 + 1]);
+            const glm::vec3 d = position(indices[t * 3 + 2]);
+            const glm::vec3 normal = glm::cross(b - a, d - a);
+            const float area = glm::length(normal);
+            centroids[c] += (a + b + d) * (area / 3.0f);
+            normals[c] += normal;
+            areas[c] += area;
+        }
+        meshCentroid += centroids[c];
+        meshArea += areas[c];
+    }
+    if (meshArea > 0.0f)
+        meshCentroid /= meshArea;
+
+    std::vector<float> keys(clusterCount, 0.0f);
+    for (size_t c = 0; c < clusterCount; c++)
+    {
+        const float normalLength = glm::length(normals[c]);
+        if (areas[c] > 0.0f && normalLength > 0.0f)
+            keys[c] = glm::dot(centroids[c] / areas[c] - meshCentroid, normals[c] / normalLength);
+    }
+
+    std::vector<uint32_t> order(clusterCount);
+    for (size_t c = 0; c < clusterCount; c++)
+        order[c] = static_cast<uint32_t>(c);
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return keys[a] > keys[b]; });
+
+    size_t written = 0;
+    for (uint32_t c : order)
+    {
+        const size_t begin = clusterStarts[c] * 3;
+        const size_t end = c + 1 < clusterCount ? clusterStarts[c + 1] * 3 : triangleCount * 3;
+        std::copy(indices + begin, indices + end, out + written);
+        written += end - begin;
+    }
+}
+
+size_t OptimizeVertexFetch(uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t* remap)
+{
+    std::fill(remap, remap + vertexCount, UNUSED);
+    uint32_t next = 0;
+    for (size_t i = 0; i < indexCount; i++)
+    {
+        uint32_t& mapped = remap[indices[i]];
+        if (mapped == UNUSED)
+            mapped = next++;
+        indices[i] = mapped;
+    }
+    return next;
+}
+
+void OptimizeMesh(Mesh& mesh)
+{
+    const size_t indexCount = mesh.mIndices.size();
+    const size_t vertexCount = mesh.VertexCount();
+    std::vector<uint32_t> cacheOrder(indexCount);
+    std::vector<uint32_t> overdrawOrder(indexCount);
+    OptimizeVertexCache(mesh.mIndices.data(), indexCount, vertexCount, cacheOrder.data());
+    OptimizeOverdraw(cacheOrder.data(), indexCount, mesh.View(), overdrawOrder.data());
+
+    std::vector<uint32_t> remap(vertexCount);
+    const size_t usedCount = OptimizeVertexFetch(overdrawOrder.data(), indexCount, vertexCount, remap.data());
+    auto permute = [&](std::vector<float>& stream) {
+        if (stream.empty())
+            return;
+        std::vector<float> reordered(usedCount);
+        for (size_t v = 0; v < vertexCount; v++)
+        {
+            if (remap[v] != UNUSED)
+                reordered[remap[v]] = stream[v];
+        }
+        stream.swap(reordered);
+    };
+    permute(mesh.mX);
+    permute(mesh.mY);
+    permute(mesh.mZ);
+    permute(mesh.mNX);
+    permute(mesh.mNY);
+    permute(mesh.mNZ);
+
+    mesh.mIndices.swap(overdrawOrder);
+    // meshlets keep their triangles, only the vertex numbering changes
+    for (uint32_t& v : mesh.mMeshletVertices)
+        v = remap[v];
+    // levels index the old vertex order, BuildLodChain has to run again
+    mesh.mLods.clear();
+    mesh.mLodIndices.clear();
+    mesh.ComputeBounds();
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "Mesh.h"
+
+// Offline index and vertex buffer reordering. None of it changes what is drawn, only
+// the order, so it's meant for the converter rather than for load time.
+
+// Average transformed vertices per triangle for a FIFO post-transform cache of
+// `cacheSize` entries: 3 with no reuse, about 0.5 at best for regular meshes.
+float ComputeAcmr(const uint32_t* indices, size_t indexCount, size_t vertexCount, unsigned cacheSize = 16);
+
+// Forsyth's linear-speed vertex cache optimization: greedily emits the triangle whose
+// vertices score best, favouring recently used vertices and ones with few triangles
+// left. `out` must not alias `indices`.
+void OptimizeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t* out);
+
+// Splits a cache optimized index buffer into clusters wherever the cache efficiency
+// allows (cluster ACMR within `threshold` of the whole buffer's) and orders the clusters
+// outward-facing first, which draws occluders earlier from most view directions
+// (Sander et al., "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw").
+// `out` must not alias `indices`.
+void OptimizeOverdraw(const uint32_t* indices, size_t indexCount, const MeshView& mesh, uint32_t* out, float threshold = 1.05f);
+
+// Renumbers vertices in the order the indices first use them, so the vertex stage
+// reads them sequentially. Writes the new index of every old vertex to `remap` and
+// returns the number of referenced vertices; unreferenced ones get UINT32_MAX.
+size_t OptimizeVertexFetch(uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t* remap);
+
+// All three passes on a mesh, dropping unreferenced vertices and any levels of detail.
+// Bounds are recomputed.
+void OptimizeMesh(Mesh& mesh);
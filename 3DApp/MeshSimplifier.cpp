@@ -0,0 +1,364 @@
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+#include "RadixSort.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+namespace
+{
+    const uint32_t UNUSED = 0xffffffffu;
+
+    // Squared normal difference is weighed against squared distance in units of the
+    // mesh size: bending the normal by 90 degrees costs as much as moving 1% of it.
+    const double NORMAL_COST = 0.01 * 0.01 / 2.0;
+
+    struct Quadric
+    {
+        double mA00 = 0.0, mA01 = 0.0, mA02 = 0.0, mA11 = 0.0, mA12 = 0.0, mA22 = 0.0;
+        double mB0 = 0.0, mB1 = 0.0, mB2 = 0.0;
+        double mC = 0.0;
+        double mWeight = 0.0;
+
+        // squared distance to the plane n.p + d = 0, n unit length
+        void AddPlane(const glm::dvec3& n, double d, double weight)
+        {
+            mA00 += weight * n.x * n.x;
+            mA01 += weight * n.x * n.y;
+            mA02 += weight * n.x * n.z;
+            mA11 += weight * n.y * n.y;
+            mA12 += weight * n.y * n.z;
+            mA22 += weight * n.z * n.z;
+            mB0 += weight * n.x * d;
+            mB1 += weight * n.y * d;
+            mB2 += weight * n.z * d;
+            mC += weight * d * d;
+            mWeight += weight;
+        }
+
+        void Add(const Quadric& q)
+        {
+            mA00 += q.mA00; mA01 += q.mA01; mA02 += q.mA02;
+            mA11 += q.mA11; mA12 += q.mA12; mA22 += q.mA22;
+            mB0 += q.mB0; mB1 += q.mB1; mB2 += q.mB2;
+            mC += q.mC;
+            mWeight += q.mWeight;
+        }
+
+        // weighted sum of squared distances, p^T A p + 2 b.p + c
+        double Evaluate(const glm::dvec3& p) const
+        {
+            const double r = p.x * (mA00 * p.x + 2.0 * (mA01 * p.y + mA02 * p.z + mB0))
+                + p.y * (mA11 * p.y + 2.0 * (mA12 * p.z + mB1))
+                + p.z * (mA22 * p.z + 2.0 * mB2)
+                + mC;
+            return std::max(r, 0.0);
+        }
+    };
+
+    struct PositionHash
+    {
+        size_t operator()(const glm::vec3& p) const
+        {
+            uint32_t bits[3];
+            std::memcpy(bits, &p, sizeof(bits));
+            return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+        }
+    };
+
+    // vertices that must not move: on an open border or on an attribute seam
+    std::vector<bool> FindLockedVertices(const MeshView& mesh, const uint32_t* indices, size_t indexCount)
+    {
+        const size_t vertexCount = mesh.VertexCount();
+        std::unordered_map<glm::vec3, uint32_t, PositionHash> firstAt;
+        std::vector<uint32_t> group(vertexCount);
+        std::vector<bool> locked(vertexCount, false);
+        for (uint32_t v = 0; v < vertexCount; v++)
+        {
+            const auto inserted = firstAt.emplace(glm::vec3(mesh.mX[v], mesh.mY[v], mesh.mZ[v]), v);
+            group[v] = inserted.first->second;
+            if (!inserted.second)
+            {
+                locked[v] = true;
+                locked[group[v]] = true;
+            }
+        }
+
+        // an edge is on a border when no triangle uses it the other way around
+        std::unordered_map<uint64_t, uint32_t> edges;
+        auto edgeKey = [&](uint32_t a, uint32_t b) { return (static_cast<uint64_t>(group[a]) << 32) | group[b]; };
+        for (size_t i = 0; i < indexCount; i += 3)
+        {
+            for (int k = 0; k < 3; k++)
+                edges[edgeKey(indices[i + k], indices[i + (k + 1) % 3])]++;
+        }
+        for (size_t i = 0; i < indexCount; i += 3)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                const uint32_t a = indices[i + k], b = indices[i + (k + 1) % 3];
+                if (edges.find(edgeKey(b, a)) == edges.end())
+                {
+                    locked[a] = true;
+                    locked[b] = true;
+                }
+            }
+        }
+        return locked;
+    }
+}
+
+float SimplifyMesh(const MeshView& mesh, const uint32_t* indices, size_t indexCount,
+    size_t targetIndexCount, float maxError, std::vector<uint32_t>& out)
+{
+    out.assign(indices, indices + indexCount);
+    const size_t vertexCount = mesh.VertexCount();
+    if (indexCount <= targetIndexCount || vertexCount == 0)
+        return 0.0f;
+
+    // errors are computed on the mesh scaled to a unit box so the normal cost is size independent
+    const glm::vec3 extent = mesh.mAabb.mMax - mesh.mAabb.mMin;
+    const double scale = std::max(std::max(extent.x, extent.y), std::max(extent.z, FLT_MIN));
+    std::vector<glm::dvec3> positions(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+        positions[v] = (glm::dvec3(mesh.mX[v], mesh.mY[v], mesh.mZ[v]) - glm::dvec3(mesh.mAabb.mMin)) / scale;
+
+    std::vector<Quadric> quadrics(vertexCount);
+    for (size_t i = 0; i < indexCount; i += 3)
+    {
+        const glm::dvec3& a = positions[indices[i]];
+        const glm::dvec3 normal = glm::cross(positions[indices[i + 1]] - a, positions[indices[i + 2]] - a);
+        const double length = glm::length(normal);
+        if (length == 0.0)
+            continue;
+        const glm::dvec3 n = normal / length;
+        for (int k = 0; k < 3; k++)
+            quadrics[indices[i + k]].AddPlane(n, -glm::dot(n, a), length * 0.5);
+    }
+
+    const std::vector<bool> locked = FindLockedVertices(mesh, indices, indexCount);
+    auto collapseCost = [&](uint32_t from, uint32_t to) {
+        Quadric q = quadrics[from];
+        q.Add(quadrics[to]);
+        double cost = q.mWeight > 0.0 ? q.Evaluate(positions[to]) / q.mWeight : 0.0;
+        if (mesh.HasNormals())
+        {
+            const glm::dvec3 d(mesh.mNX[from] - mesh.mNX[to], mesh.mNY[from] - mesh.mNY[to], mesh.mNZ[from] - mesh.mNZ[to]);
+            cost += NORMAL_COST * glm::dot(d, d);
+        }
+        return cost;
+    };
+
+    const double costLimit = maxError >= FLT_MAX ? DBL_MAX : (maxError / scale) * (maxError / scale);
+    double resultCost = 0.0;
+    std::vector<uint32_t> offsets(vertexCount + 1);
+    std::vector<uint32_t> adjacency;
+    std::vector<uint32_t> bestTarget(vertexCount);
+    std::vector<double> bestCost(vertexCount);
+    std::vector<uint32_t> remap(vertexCount);
+    std::vector<bool> blocked(vertexCount);
+    std::vector<uint32_t> keys, values, keysTemp, valuesTemp;
+
+    // Each pass ranks every vertex's cheapest collapse and applies them in order. A
+    // collapse blocks the one-ring it changed for the rest of the pass, so the costs
+    // and flip checks of later collapses stay valid.
+    while (out.size() > targetIndexCount)
+    {
+        std::fill(offsets.begin(), offsets.end(), 0);
+        for (uint32_t index : out)
+            offsets[index + 1]++;
+        for (size_t v = 0; v < vertexCount; v++)
+            offsets[v + 1] += offsets[v];
+        adjacency.resize(out.size());
+        std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < out.size(); i++)
+            adjacency[fill[out[i]]++] = static_cast<uint32_t>(i / 3);
+
+        std::fill(bestTarget.begin(), bestTarget.end(), UNUSED);
+        std::fill(bestCost.begin(), bestCost.end(), DBL_MAX);
+        for (size_t i = 0; i < out.size(); i += 3)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                const uint32_t a = out[i + k], b = out[i + (k + 1) % 3];
+                const uint32_t pair[2][2] = { { a, b }, { b, a } };
+                for (const auto& edge : pair)
+                {
+                    if (locked[edge[0]])
+                        continue;
+                    const double cost = collapseCost(edge[0], edge[1]);
+                    if (cost < bestCost[edge[0]])
+                    {
+                        bestCost[edge[0]] = cost;
+                        bestTarget[edge[0]] = edge[1];
+                    }
+                }
+            }
+        }
+
+        keys.clear();
+        values.clear();
+        for (uint32_t v = 0; v < vertexCount; v++)
+        {
+            if (bestTarget[v] != UNUSED && bestCost[v] <= costLimit)
+            {
+                keys.push_back(SortableFloat(static_cast<float>(bestCost[v])));
+                values.push_back(v);
+            }
+        }
+        keysTemp.resize(keys.size());
+        valuesTemp.resize(values.size());
+        RadixSortByKey(keys.data(), values.data(), keys.size(), keysTemp.data(), valuesTemp.data());
+
+        for (uint32_t v = 0; v < vertexCount; v++)
+            remap[v] = v;
+        std::fill(blocked.begin(), blocked.end(), false);
+        const size_t goal = (out.size() - targetIndexCount) / 3;
+        size_t removed = 0;
+        size_t collapses = 0;
+        for (uint32_t from : values)
+        {
+            if (removed >= goal)
+                break;
+            const uint32_t to = bestTarget[from];
+            if (blocked[from] || remap[to] != to)
+                continue;
+
+            // reject collapses that flip a remaining triangle
+            bool flips = false;
+            size_t shared = 0;
+            for (uint32_t a = offsets[from]; a < offsets[from + 1] && !flips; a++)
+            {
+                const uint32_t* t = &out[adjacency[a] * 3];
+                if (t[0] == to || t[1] == to || t[2] == to)
+                {
+                    shared++;
+                    continue;
+                }
+                const int k = t[0] == from ? 0 : t[1] == from ? 1 : 2;
+                const glm::dvec3& p = positions[from];
+                const glm::dvec3& q = positions[t[(k + 1) % 3]];
+                const glm::dvec3& r = positions[t[(k + 2) % 3]];
+                const glm::dvec3& moved = positions[to];
+                flips = glm::dot(glm::cross(q - p, r - p), glm::cross(q - moved, r - moved)) <= 0.0;
+            }
+            if (flips)
+                continue;
+
+            remap[from] = to;
+            quadrics[to].Add(quadrics[from]);
+            resultCost = std::max(resultCost, bestCost[from]);
+            removed += shared;
+            collapses++;
+            for (uint32_t a = offsets[from]; a < offsets[from + 1]; a++)
+            {
+                const uint32_t* t = &out[adjacency[a] * 3];
+                blocked[t[0]] = blocked[t[1]] = blocked[t[2]] = true;
+            }
+        }
+        if (collapses == 0)
+            break;
+
+        size_t written = 0;
+        for (size_t i = 0; i < out.size(); i += 3)
+        {
+            const uint32_t a = remap[out[i]], b = remap[out[i + 1]], c = remap[out[i + 2]];
+            if (a == b || b == c || a == c)
+                continue;
+            out[written++] = a;
+            out[written++] = b;
+            out[written++] = c;
+        }
+        out.resize(written);
+    }
+
+    return static_cast<float>(std::sqrt(resultCost) * scale);
+}
+
+void BuildLodChain(Mesh& mesh, size_t minTriangles, size_t maxLevels)
+{
+    mesh.mLods.clear();
+    mesh.mLodIndices.clear();
+    const MeshView view = mesh.View();
+    const size_t vertexCount = mesh.VertexCount();
+
+    // each level simplifies the one before, so the errors add up
+    std::vector<std::vector<uint32_t>> levels(1, mesh.mIndices);
+    std::vector<float> errors(1, 0.0f);
+    while (levels.size() <= maxLevels)
+    {
+        const std::vector<uint32_t>& previous = levels.back();
+        if (previous.size() / 3 <= minTriangles)
+            break;
+
+        const size_t target = std::max(previous.size() / 6, minTriangles) * 3;
+        std::vector<uint32_t> simplified;
+        const float error = SimplifyMesh(view, previous.data(), previous.size(), target, FLT_MAX, simplified);
+        // mostly locked borders and seams left, another level wouldn't be much cheaper
+        if (simplified.size() > previous.size() * 3 / 4)
+            break;
+
+        std::vector<uint32_t> optimized(simplified.size());
+        OptimizeVertexCache(simplified.data(), simplified.size(), vertexCount, optimized.data());
+        levels.push_back(std::move(optimized));
+        errors.push_back(errors.back() + error);
+    }
+    if (levels.size() == 1)
+        return;
+
+    // Coarser levels use a subset of the finer ones' vertices. Numbering them coarsest
+    // first makes each level's vertices a prefix of the buffer.
+    std::vector<uint32_t> remap(vertexCount, UNUSED);
+    std::vector<uint32_t> levelVertexCount(levels.size());
+    uint32_t next = 0;
+    for (size_t level = levels.size(); level-- > 0;)
+    {
+        for (uint32_t index : levels[level])
+        {
+            if (remap[index] == UNUSED)
+                remap[index] = next++;
+        }
+        levelVertexCount[level] = next;
+    }
+    for (uint32_t v = 0; v < vertexCount; v++)
+    {
+        if (remap[v] == UNUSED)
+            remap[v] = next++;
+    }
+
+    auto permute = [&](std::vector<float>& stream) {
+        if (stream.empty())
+            return;
+        std::vector<float> reordered(vertexCount);
+        for (size_t v = 0; v < vertexCount; v++)
+            reordered[remap[v]] = stream[v];
+        stream.swap(reordered);
+    };
+    permute(mesh.mX);
+    permute(mesh.mY);
+    permute(mesh.mZ);
+    permute(mesh.mNX);
+    permute(mesh.mNY);
+    permute(mesh.mNZ);
+
+    for (std::vector<uint32_t>& level : levels)
+    {
+        for (uint32_t& index : level)
+            index = remap[index];
+    }
+    mesh.mIndices = levels[0];
+    for (uint32_t& v : mesh.mMeshletVertices)
+        v = remap[v];
+    for (size_t level = 1; level < levels.size(); level++)
+    {
+        MeshLod lod;
+        lod.mFirstIndex = static_cast<uint32_t>(mesh.mLodIndices.size());
+        lod.mIndexCount = static_cast<uint32_t>(levels[level].size());
+        lod.mVertexCount = levelVertexCount[level];
+        lod.mError = errors[level];
+        mesh.mLods.push_back(lod);
+        mesh.mLodIndices.insert(mesh.mLodIndices.end(), levels[level].begin(), levels[level].end());
+    }
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include "Mesh.h"
+
+// Quadric error metric simplification (Garland & Heckbert) by half-edge collapses:
+// a vertex only ever moves onto a neighbour, so the result indexes a subset of the
+// input vertices and needs no new vertex data. Normals, when present, add a cost for
+// collapsing across a change in shading. Open borders and attribute seams (vertices
+// sharing a position) are kept in place so the silhouette and UV/normal splits don't
+// crack.
+// Simplifies `indices` (triangles of `mesh`) down to `targetIndexCount` indices or until
+// the next collapse would exceed `maxError`, in object space units. Returns the error
+// of the result, also in object space.
+float SimplifyMesh(const MeshView& mesh, const uint32_t* indices, size_t indexCount,
+    size_t targetIndexCount, float maxError, std::vector<uint32_t>& out);
+
+// Builds mesh.mLods by repeatedly halving the triangle count until `minTriangles`
+// or `maxLevels` is reached or simplification stops paying off, then reorders the
+// vertices coarsest level first. Replaces any existing chain; run vertex reordering
+// passes such as OptimizeMesh before this, not after.
+void BuildLodChain(Mesh& mesh, size_t minTriangles = 64, size_t maxLevels = 8);
@@ -0,0 +1,224 @@
+#include "Meshlets.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+    const uint32_t UNUSED = 0xffffffffu;
+
+    // Vertices split by attribute seams or flat shading are still one surface for
+    // clustering, so adjacency goes through the first vertex at each position.
+    std::vector<uint32_t> CanonicalVertices(const Mesh& mesh)
+    {
+        const size_t vertexCount = mesh.VertexCount();
+        std::vector<uint32_t> order(vertexCount);
+        for (size_t v = 0; v < vertexCount; v++)
+            order[v] = static_cast<uint32_t>(v);
+        auto less = [&](uint32_t a, uint32_t b) {
+            if (mesh.mX[a] != mesh.mX[b])
+                return mesh.mX[a] < mesh.mX[b];
+            if (mesh.mY[a] != mesh.mY[b])
+                return mesh.mY[a] < mesh.mY[b];
+            if (mesh.mZ[a] != mesh.mZ[b])
+                return mesh.mZ[a] < mesh.mZ[b];
+            return a < b;
+        };
+        std::sort(order.begin(), order.end(), less);
+
+        std::vector<uint32_t> canonical(vertexCount);
+        for (size_t i = 0; i < vertexCount; i++)
+        {
+            const uint32_t v = order[i];
+            const uint32_t first = i > 0 ? canonical[order[i - 1]] : v;
+            canonical[v] = i > 0 && mesh.Position(v) == mesh.Position(first) ? first : v;
+        }
+        return canonical;
+    }
+
+    // bounding sphere and normal cone once the meshlet's triangles are final
+    void ComputeMeshletBounds(const Mesh& mesh, Meshlet& meshlet)
+    {
+        const uint32_t* vertices = &mesh.mMeshletVertices[meshlet.mVertexOffset];
+        const uint8_t* triangles = &mesh.mMeshletTriangles[meshlet.mTriangleOffset];
+
+        glm::vec3 lo = mesh.Position(vertices[0]);
+        glm::vec3 hi = lo;
+        for (uint32_t v = 1; v < meshlet.mVertexCount; v++)
+        {
+            lo = glm::min(lo, mesh.Position(vertices[v]));
+            hi = glm::max(hi, mesh.Position(vertices[v]));
+        }
+        meshlet.mBounds.mCenter = (lo + hi) * 0.5f;
+        float radiusSq = 0.0f;
+        for (uint32_t v = 0; v < meshlet.mVertexCount; v++)
+        {
+            const glm::vec3 d = mesh.Position(vertices[v]) - meshlet.mBounds.mCenter;
+            radiusSq = std::max(radiusSq, glm::dot(d, d));
+        }
+        meshlet.mBounds.mRadius = std::sqrt(radiusSq);
+
+        auto normal = [&](uint32_t t) {
+            const glm::vec3 a = mesh.Position(vertices[triangles[t * 3]]);
+            const glm::vec3 b = mesh.Position(vertices[triangles[t * 3 + 1]]);
+            const glm::vec3 c = mesh.Position(vertices[triangles[t * 3 + 2]]);
+            return glm::cross(b - a, c - a);
+        };
+
+        // degenerate triangles can't be seen from either side and don't widen the cone
+        glm::vec3 axis(0.0f);
+        for (uint32_t t = 0; t < meshlet.mTriangleCount; t++)
+        {
+            const glm::vec3 n = normal(t);
+            const float length = glm::length(n);
+            if (length > 0.0f)
+                axis += n / length;
+        }
+        const float axisLength = glm::length(axis);
+        meshlet.mConeAxis = axisLength > 0.0f ? axis / axisLength : glm::vec3(0.0f);
+        meshlet.mConeCutoff = 1.0f;
+        if (axisLength == 0.0f)
+            return;
+
+        float minDot = 1.0f;
+        for (uint32_t t = 0; t < meshlet.mTriangleCount; t++)
+        {
+            const glm::vec3 n = normal(t);
+            const float length = glm::length(n);
+            if (length > 0.0f)
+                minDot = std::min(minDot, glm::dot(n / length, meshlet.mConeAxis));
+        }
+        // a cone wider than a hemisphere always has a triangle facing the viewer
+        if (minDot > 0.0f)
+            meshlet.mConeCutoff = std::sqrt(1.0f - minDot * minDot);
+    }
+}
+
+void BuildMeshlets(Mesh& mesh, size_t maxVertices, size_t maxTriangles)
+{
+    mesh.mMeshlets.clear();
+    mesh.mMeshletVertices.clear();
+    mesh.mMeshletTriangles.clear();
+    maxVertices = std::min<size_t>(std::max<size_t>(maxVertices, 3), MESHLET_VERTEX_LIMIT);
+    maxTriangles = std::max<size_t>(maxTriangles, 1);
+
+    const uint32_t* indices = mesh.mIndices.data();
+    const size_t triangleCount = mesh.TriangleCount();
+    const size_t vertexCount = mesh.VertexCount();
+    if (triangleCount == 0)
+        return;
+
+    // triangles around each position
+    const std::vector<uint32_t> canonical = CanonicalVertices(mesh);
+    std::vector<uint32_t> offsets(vertexCount + 1, 0);
+    for (size_t i = 0; i < triangleCount * 3; i++)
+        offsets[canonical[indices[i]] + 1]++;
+    for (size_t v = 0; v < vertexCount; v++)
+        offsets[v + 1] += offsets[v];
+    std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+    std::vector<uint32_t> adjacency(triangleCount * 3);
+    for (size_t i = 0; i < triangleCount * 3; i++)
+        adjacency[fill[canonical[indices[i]]]++] = static_cast<uint32_t>(i / 3);
+
+    std::vector<glm::vec3> centroids(triangleCount);
+    for (size_t t = 0; t < triangleCount; t++)
+        centroids[t] = (mesh.Position(indices[t * 3]) + mesh.Position(indices[t * 3 + 1]) + mesh.Position(indices[t * 3 + 2])) / 3.0f;
+
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<uint32_t> local(vertexCount, UNUSED); // index within the open meshlet
+    std::vector<uint32_t> queuedFor(triangleCount, UNUSED); // meshlet that has it as a candidate
+    std::vector<uint32_t> candidates;
+    Meshlet meshlet = {};
+    glm::vec3 centroidSum(0.0f);
+    size_t cursor = 0;
+
+    auto newVertices = [&](uint32_t t) {
+        return (local[indices[t * 3]] == UNUSED) + (local[indices[t * 3 + 1]] == UNUSED) + (local[indices[t * 3 + 2]] == UNUSED);
+    };
+
+    auto close = [&]() {
+        ComputeMeshletBounds(mesh, meshlet);
+        mesh.mMeshlets.push_back(meshlet);
+        for (uint32_t v = 0; v < meshlet.mVertexCount; v++)
+            local[mesh.mMeshletVertices[meshlet.mVertexOffset + v]] = UNUSED;
+        meshlet = Meshlet();
+        meshlet.mVertexOffset = static_cast<uint32_t>(mesh.mMeshletVertices.size());
+        meshlet.mTriangleOffset = static_cast<uint32_t>(mesh.mMeshletTriangles.size());
+        centroidSum = glm::vec3(0.0f);
+    };
+
+    for (size_t n = 0; n < triangleCount; n++)
+    {
+        // the connected triangle adding the fewest vertices, then the closest one
+        uint32_t best = UNUSED;
+        int bestAdded = 4;
+        float bestDistance = FLT_MAX;
+        const glm::vec3 center = meshlet.mTriangleCount > 0 ? centroidSum / static_cast<float>(meshlet.mTriangleCount) : glm::vec3(0.0f);
+        size_t kept = 0;
+        for (uint32_t t : candidates)
+        {
+            if (emitted[t])
+                continue;
+            candidates[kept++] = t;
+            const int added = newVertices(t);
+            if (meshlet.mVertexCount + added > maxVertices)
+                continue;
+            const glm::vec3 d = centroids[t] - center;
+            const float distance = glm::dot(d, d);
+            if (added < bestAdded || (added == bestAdded && distance < bestDistance))
+            {
+                best = t;
+                bestAdded = added;
+                bestDistance = distance;
+            }
+        }
+        candidates.resize(kept);
+
+        if (best == UNUSED || meshlet.mTriangleCount == maxTriangles)
+        {
+            // full or nothing connected left: continue from where the old meshlet ended
+            // so the next one stays nearby, or from the next unused triangle
+            if (meshlet.mTriangleCount > 0)
+                close();
+            if (!candidates.empty())
+            {
+                best = candidates.front();
+            }
+            else
+            {
+                while (emitted[cursor])
+                    cursor++;
+                best = static_cast<uint32_t>(cursor);
+            }
+            candidates.clear();
+        }
+
+        emitted[best] = true;
+        const uint32_t meshletIndex = static_cast<uint32_t>(mesh.mMeshlets.size());
+        for (int k = 0; k < 3; k++)
+        {
+            const uint32_t v = indices[best * 3 + k];
+            if (local[v] == UNUSED)
+            {
+                local[v] = meshlet.mVertexCount++;
+                mesh.mMeshletVertices.push_back(v);
+            }
+            mesh.mMeshletTriangles.push_back(static_cast<uint8_t>(local[v]));
+
+            const uint32_t p = canonical[v];
+            for (uint32_t a = offsets[p]; a < offsets[p + 1]; a++)
+            {
+                const uint32_t t = adjacency[a];
+                if (!emitted[t] && queuedFor[t] != meshletIndex)
+                {
+                    queuedFor[t] = meshletIndex;
+                    candidates.push_back(t);
+                }
+            }
+        }
+        meshlet.mTriangleCount++;
+        centroidSum += centroids[best];
+    }
+    close();
+}
@@ -0,0 +1,14 @@
+#pragma once
+#include <cstddef>
+#include "Mesh.h"
+
+constexpr size_t MESHLET_MAX_VERTICES = 64;
+constexpr size_t MESHLET_MAX_TRIANGLES = 124;
+
+// Splits the full mesh into mesh.mMeshlets. Clusters are grown greedily from connected
+// triangles, preferring ones that add the fewest new vertices and stay close to the
+// cluster, so each cluster is compact enough for its bounding sphere and normal cone
+// to cull well. `maxVertices` is clamped to MESHLET_VERTEX_LIMIT.
+// The index buffer itself is left alone; later vertex reordering passes (OptimizeMesh,
+// BuildLodChain) remap the meshlet vertices along with it.
+void BuildMeshlets(Mesh& mesh, size_t maxVertices = MESHLET_MAX_VERTICES, size_t maxTriangles = MESHLET_MAX_TRIANGLES);
@@ -0,0 +1,451 @@
+#include "ObjImporter.h"
+#include "MappedFile.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+namespace
+{
+    const double POWERS_OF_TEN[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+        1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+    };
+
+    double PowerOfTen(int exponent)
+    {
+        double result = 1.0;
+        const double base = exponent < 0 ? 0.1 : 10.0;
+        int remaining = exponent < 0 ? -exponent : exponent;
+        if (remaining <= 22)
+            return exponent < 0 ? 1.0 / POWERS_OF_TEN[remaining] : POWERS_OF_TEN[remaining];
+        while (remaining-- > 0)
+            result *= base;
+        return result;
+    }
+
+    bool IsSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+    bool IsDigit(char c) { return c >= '0' && c <= '9'; }
+
+    const char* SkipSpaces(const char* p, const char* end)
+    {
+        while (p < end && IsSpace(*p))
+            p++;
+        return p;
+    }
+
+    const char* ParseInt(const char* p, const char* end, long long& value)
+    {
+        const char* start = p;
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+'))
+            negative = *p++ == '-';
+        if (p == end || !IsDigit(*p))
+            return start;
+        long long result = 0;
+        while (p < end && IsDigit(*p))
+            result = result * 10 + (*p++ - '0');
+        value = negative ? -result : result;
+        return p;
+    }
+
+    // index into the OBJ's global lists, negative ones are relative to the chunk
+    // until the chunk's base is known
+    struct Corner
+    {
+        int64_t mPosition;
+        int64_t mNormal; // -1: none
+        bool mPositionRelative;
+        bool mNormalRelative;
+    };
+
+    struct Chunk
+    {
+        const char* mBegin;
+        const char* mEnd;
+        std::vector<float> mPositions; // xyz
+        std::vector<float> mNormals;   // xyz
+        std::vector<Corner> mCorners;  // three per triangle
+        std::string mError;
+        size_t mPositionBase = 0;
+        size_t mNormalBase = 0;
+        size_t mCornerBase = 0;
+    };
+
+    // one item per job, chunks and partitions are large
+    template <typename Fn>
+    void ParallelFor(JobSystem& jobs, size_t count, Fn fn)
+    {
+        jobs.ParallelFor(count, 1, [&](size_t begin, size_t end, unsigned) {
+            for (size_t i = begin; i < end; i++)
+                fn(i);
+        });
+    }
+
+    const char* ParseVector(const char* p, const char* end, std::vector<float>& out)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            float value = 0.0f;
+            p = SkipSpaces(p, end);
+            p = ParseFloat(p, end, value);
+            out.push_back(value);
+        }
+        return p;
+    }
+
+    void ParseChunk(Chunk& chunk)
+    {
+        std::vector<Corner> face;
+        const char* p = chunk.mBegin;
+        const char* const end = chunk.mEnd;
+        while (p < end)
+        {
+            const char* lineEnd = static_cast<const char*>(std::memchr(p, '\n', end - p));
+            if (lineEnd == nullptr)
+                lineEnd = end;
+            const char* const nextLine = lineEnd + 1;
+            // a comment runs to the end of the line, after any statement
+            const char* const comment = static_cast<const char*>(std::memchr(p, '#', lineEnd - p));
+            if (comment != nullptr)
+                lineEnd = comment;
+
+            const char* q = SkipSpaces(p, lineEnd);
+            if (q + 1 < lineEnd && q[0] == 'v' && IsSpace(q[1]))
+            {
+                ParseVector(q + 2, lineEnd, chunk.mPositions);
+            }
+            else if (q + 2 < lineEnd && q[0] == 'v' && q[1] == 'n' && IsSpace(q[2]))
+            {
+                ParseVector(q + 3, lineEnd, chunk.mNormals);
+            }
+            else if (q + 1 < lineEnd && q[0] == 'f' && IsSpace(q[1]))
+            {
+                face.clear();
+                q = SkipSpaces(q + 2, lineEnd);
+                while (q < lineEnd)
+                {
+                    // v, v/vt, v//vn or v/vt/vn
+                    long long v = 0, vt = 0, vn = 0;
+                    const char* next = ParseInt(q, lineEnd, v);
+                    if (next == q || v == 0)
+                    {
+                        chunk.mError = std::string(p, lineEnd);
+                        return;
+                    }
+                    q = next;
+                    if (q < lineEnd && *q == '/')
+                    {
+                        q = ParseInt(q + 1, lineEnd, vt);
+                        if (q < lineEnd && *q == '/')
+                            q = ParseInt(q + 1, lineEnd, vn);
+                    }
+
+                    Corner corner;
+                    corner.mPositionRelative = v < 0;
+                    corner.mPosition = v < 0 ? static_cast<int64_t>(chunk.mPositions.size() / 3) + v : v - 1;
+                    corner.mNormalRelative = vn < 0;
+                    corner.mNormal = vn < 0 ? static_cast<int64_t>(chunk.mNormals.size() / 3) + vn : vn - 1;
+                    face.push_back(corner);
+                    q = SkipSpaces(q, lineEnd);
+                }
+                for (size_t i = 2; i < face.size(); i++)
+                {
+                    chunk.mCorners.push_back(face[0]);
+                    chunk.mCorners.push_back(face[i - 1]);
+                    chunk.mCorners.push_back(face[i]);
+                }
+            }
+            p = nextLine;
+        }
+    }
+
+    bool Fail(const std::string& path, const std::string& reason)
+    {
+        std::cerr << "ImportObj: " << path << ": " << reason << std::endl;
+        return false;
+    }
+}
+
+const char* ParseFloat(const char* begin, const char* end, float& value)
+{
+    const char* p = begin;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+        negative = *p++ == '-';
+
+    // up to 19 significant digits fit in the mantissa, the rest only shift the exponent
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    bool any = false;
+    while (p < end && IsDigit(*p))
+    {
+        if (digits < 19)
+        {
+            mantissa = mantissa * 10 + (*p - '0');
+            if (mantissa != 0)
+                digits++;
+        }
+        else
+        {
+            exponent++;
+        }
+        p++;
+        any = true;
+    }
+    if (p < end && *p == '.')
+    {
+        p++;
+        while (p < end && IsDigit(*p))
+        {
+            if (digits < 19)
+            {
+                mantissa = mantissa * 10 + (*p - '0');
+                if (mantissa != 0)
+                    digits++;
+                exponent--;
+            }
+            p++;
+            any = true;
+        }
+    }
+    if (!any)
+        return begin;
+
+    if (p < end && (*p == 'e' || *p == 'E'))
+    {
+        long long e = 0;
+        const char* next = ParseInt(p + 1, end, e);
+        if (next != p + 1)
+        {
+            exponent += static_cast<int>(std::max(-400LL, std::min(e, 400LL)));
+            p = next;
+        }
+    }
+
+    double result = static_cast<double>(mantissa);
+    if (exponent != 0)
+        result = exponent < 0 ? result / PowerOfTen(-exponent) : result * PowerOfTen(exponent);
+    value = static_cast<float>(negative ? -result : result);
+    return p;
+}
+
+bool ImportObj(const std::string& path, Mesh& mesh, unsigned threadCount)
+{
+    // the shared workers unless a thread count is asked for
+    std::unique_ptr<JobSystem> ownJobs;
+    if (threadCount != 0)
+        ownJobs.reset(new JobSystem(threadCount - 1));
+    JobSystem& jobs = ownJobs ? *ownJobs : JobSystem::Shared();
+    threadCount = jobs.WorkerCount() + 1;
+
+    MappedFile file;
+    if (!file.Open(path))
+        return Fail(path, "can't map the file");
+
+    // a few chunks per thread so uneven content still balances
+    const char* const data = reinterpret_cast<const char*>(file.Data());
+    const size_t size = file.Size();
+    const size_t chunkCount = std::max<size_t>(1, std::min<size_t>(threadCount * 4, size / (256 * 1024)));
+    std::vector<Chunk> chunks(chunkCount);
+    const char* chunkBegin = data;
+    for (size_t i = 0; i < chunkCount; i++)
+    {
+        const char* chunkEnd = data + size * (i + 1) / chunkCount;
+        if (i + 1 < chunkCount)
+        {
+            const char* newline = static_cast<const char*>(std::memchr(chunkEnd, '\n', data + size - chunkEnd));
+            chunkEnd = newline ? newline + 1 : data + size;
+        }
+        chunkEnd = std::max(chunkEnd, chunkBegin);
+        chunks[i].mBegin = chunkBegin;
+        chunks[i].mEnd = chunkEnd;
+        chunkBegin = chunkEnd;
+    }
+
+    ParallelFor(jobs, chunkCount, [&](size_t i) { ParseChunk(chunks[i]); });
+
+    size_t positionCount = 0, normalCount = 0, cornerCount = 0;
+    for (Chunk& chunk : chunks)
+    {
+        if (!chunk.mError.empty())
+            return Fail(path, "bad face: " + chunk.mError);
+        chunk.mPositionBase = positionCount;
+        chunk.mNormalBase = normalCount;
+        chunk.mCornerBase = cornerCount;
+        positionCount += chunk.mPositions.size() / 3;
+        normalCount += chunk.mNormals.size() / 3;
+        cornerCount += chunk.mCorners.size();
+    }
+    if (positionCount == 0)
+        return Fail(path, "no positions");
+    if (cornerCount > UINT32_MAX || positionCount > UINT32_MAX)
+        return Fail(path, "too large for 32 bit indices");
+
+    // resolve indices to the global lists
+    std::atomic<bool> outOfRange(false);
+    ParallelFor(jobs, chunkCount, [&](size_t i) {
+        Chunk& chunk = chunks[i];
+        for (Corner& corner : chunk.mCorners)
+        {
+            if (corner.mPositionRelative)
+                corner.mPosition += chunk.mPositionBase;
+            if (corner.mNormalRelative)
+                corner.mNormal += chunk.mNormalBase;
+            if (corner.mPosition < 0 || corner.mPosition >= static_cast<int64_t>(positionCount)
+                || corner.mNormal < -1 || corner.mNormal >= static_cast<int64_t>(normalCount))
+                outOfRange = true;
+        }
+    });
+    if (outOfRange)
+        return Fail(path, "face index out of range");
+
+    auto positionOf = [&](size_t index) -> const float* {
+        auto it = std::upper_bound(chunks.begin(), chunks.end(), index, [](size_t value, const Chunk& chunk) {
+            return value < chunk.mPositionBase;
+        }) - 1;
+        return &it->mPositions[(index - it->mPositionBase) * 3];
+    };
+    auto normalOf = [&](size_t index) -> const float* {
+        auto it = std::upper_bound(chunks.begin(), chunks.end(), index, [](size_t value, const Chunk& chunk) {
+            return value < chunk.mNormalBase;
+        }) - 1;
+        return &it->mNormals[(index - it->mNormalBase) * 3];
+    };
+
+    mesh = Mesh();
+    mesh.mIndices.resize(cornerCount);
+
+    if (normalCount == 0)
+    {
+        // nothing to weld, positions are the vertices
+        mesh.mX.resize(positionCount);
+        mesh.mY.resize(positionCount);
+        mesh.mZ.resize(positionCount);
+        ParallelFor(jobs, chunkCount, [&](size_t i) {
+            const Chunk& chunk = chunks[i];
+            for (size_t v = 0; v < chunk.mPositions.size() / 3; v++)
+            {
+                mesh.mX[chunk.mPositionBase + v] = chunk.mPositions[v * 3];
+                mesh.mY[chunk.mPositionBase + v] = chunk.mPositions[v * 3 + 1];
+                mesh.mZ[chunk.mPositionBase + v] = chunk.mPositions[v * 3 + 2];
+            }
+            for (size_t c = 0; c < chunk.mCorners.size(); c++)
+                mesh.mIndices[chunk.mCornerBase + c] = static_cast<uint32_t>(chunk.mCorners[c].mPosition);
+        });
+        mesh.ComputeBounds();
+        return true;
+    }
+
+    // Weld (position, normal) pairs. Corners are partitioned by position range, each
+    // partition is welded independently and the partitions are concatenated, so the
+    // vertex order only depends on the file.
+    const size_t partitionCount = std::min<size_t>(std::max<size_t>(threadCount, 1), positionCount);
+    const size_t partitionRange = (positionCount + partitionCount - 1) / partitionCount;
+
+    struct Entry
+    {
+        uint32_t mPosition;
+        int32_t mNormal;
+        uint32_t mCorner;
+    };
+
+    // counts[chunk][partition], then exclusive offsets into the partition's entries
+    std::vector<std::vector<size_t>> counts(chunkCount, std::vector<size_t>(partitionCount, 0));
+    ParallelFor(jobs, chunkCount, [&](size_t i) {
+        for (const Corner& corner : chunks[i].mCorners)
+            counts[i][static_cast<size_t>(corner.mPosition) / partitionRange]++;
+    });
+
+    std::vector<std::vector<Entry>> partitions(partitionCount);
+    for (size_t p = 0; p < partitionCount; p++)
+    {
+        size_t offset = 0;
+        for (size_t i = 0; i < chunkCount; i++)
+        {
+            const size_t count = counts[i][p];
+            counts[i][p] = offset;
+            offset += count;
+        }
+        partitions[p].resize(offset);
+    }
+
+    ParallelFor(jobs, chunkCount, [&](size_t i) {
+        const Chunk& chunk = chunks[i];
+        std::vector<size_t>& cursor = counts[i];
+        for (size_t c = 0; c < chunk.mCorners.size(); c++)
+        {
+            const Corner& corner = chunk.mCorners[c];
+            const size_t p = static_cast<size_t>(corner.mPosition) / partitionRange;
+            partitions[p][cursor[p]++] = {
+                static_cast<uint32_t>(corner.mPosition),
+                static_cast<int32_t>(corner.mNormal),
+                static_cast<uint32_t>(chunk.mCornerBase + c)
+            };
+        }
+    });
+
+    // per partition: unique vertices in first use order, corners get partition local ids
+    std::vector<std::vector<Entry>> uniques(partitionCount);
+    ParallelFor(jobs, partitionCount, [&](size_t p) {
+        const size_t rangeBegin = p * partitionRange;
+        const size_t rangeSize = std::min(partitionRange, positionCount - rangeBegin);
+        std::vector<int32_t> first(rangeSize, -1); // per position, head of its vertex list
+        std::vector<int32_t> next;
+        std::vector<Entry>& unique = uniques[p];
+        for (Entry& entry : partitions[p])
+        {
+            int32_t id = first[entry.mPosition - rangeBegin];
+            while (id >= 0 && unique[id].mNormal != entry.mNormal)
+                id = next[id];
+            if (id < 0)
+            {
+                id = static_cast<int32_t>(unique.size());
+                next.push_back(first[entry.mPosition - rangeBegin]);
+                first[entry.mPosition - rangeBegin] = id;
+                unique.push_back(entry);
+            }
+            mesh.mIndices[entry.mCorner] = static_cast<uint32_t>(id);
+        }
+    });
+
+    std::vector<size_t> vertexBase(partitionCount, 0);
+    size_t vertexCount = 0;
+    for (size_t p = 0; p < partitionCount; p++)
+    {
+        vertexBase[p] = vertexCount;
+        vertexCount += uniques[p].size();
+    }
+    mesh.mX.resize(vertexCount);
+    mesh.mY.resize(vertexCount);
+    mesh.mZ.resize(vertexCount);
+    mesh.mNX.resize(vertexCount);
+    mesh.mNY.resize(vertexCount);
+    mesh.mNZ.resize(vertexCount);
+
+    ParallelFor(jobs, partitionCount, [&](size_t p) {
+        const size_t base = vertexBase[p];
+        for (size_t k = 0; k < uniques[p].size(); k++)
+        {
+            const Entry& vertex = uniques[p][k];
+            const float* position = positionOf(vertex.mPosition);
+            mesh.mX[base + k] = position[0];
+            mesh.mY[base + k] = position[1];
+            mesh.mZ[base + k] = position[2];
+            const float* normal = vertex.mNormal >= 0 ? normalOf(static_cast<size_t>(vertex.mNormal)) : nullptr;
+            mesh.mNX[base + k] = normal ? normal[0] : 0.0f;
+            mesh.mNY[base + k] = normal ? normal[1] : 0.0f;
+            mesh.mNZ[base + k] = normal ? normal[2] : 0.0f;
+        }
+        for (const Entry& entry : partitions[p])
+            mesh.mIndices[entry.mCorner] += static_cast<uint32_t>(base);
+    });
+
+    mesh.ComputeBounds();
+    return true;
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include <string>
+#include "Mesh.h"
+
+// Wavefront OBJ importer. The file is memory mapped, split at line boundaries into
+// chunks that are parsed on all cores, and the face corners are then welded into an
+// indexed mesh in parallel: corners with the same position and normal share a vertex.
+// Supports v, vn and f (polygons are fanned, negative indices are resolved); other
+// statements, texture coordinates included, are ignored.
+// threadCount 0 runs on JobSystem::Shared(). Prints the reason to std::cerr and returns
+// false when the file can't be imported.
+bool ImportObj(const std::string& path, Mesh& mesh, unsigned threadCount = 0);
+
+// Parses a decimal float like strtof but without locale handling or errno, which is
+// what makes it fast. Accepts an optional sign, digits, fraction and exponent; returns
+// the position after the number, or `begin` if there is none.
+const char* ParseFloat(const char* begin, const char* end, float& value);
@@ -0,0 +1,44 @@
+#include "PipelineStats.h"
+
+void PipelineStats::Add(const PipelineStats& other)
+{
+    mTrianglesSubmitted += other.mTrianglesSubmitted;
+    mTrianglesInstanceCulled += other.mTrianglesInstanceCulled;
+    mTrianglesFrustumCulled += other.mTrianglesFrustumCulled;
+    mTrianglesBackfaceCulled += other.mTrianglesBackfaceCulled;
+    mTrianglesOcclusionCulled += other.mTrianglesOcclusionCulled;
+    mTrianglesOffscreen += other.mTrianglesOffscreen;
+    mTrianglesDegenerate += other.mTrianglesDegenerate;
+    mTrianglesMalformed += other.mTrianglesMalformed;
+    mTrianglesClipped += other.mTrianglesClipped;
+    mTrianglesBinned += other.mTrianglesBinned;
+    mTileTriangles += other.mTileTriangles;
+    mPixelsTested += other.mPixelsTested;
+    mPixelsPassed += other.mPixelsPassed;
+    mPixelsShaded += other.mPixelsShaded;
+    mPixelsWritten += other.mPixelsWritten;
+    mPixelsBlended += other.mPixelsBlended;
+    mClearMs += other.mClearMs;
+    mDrawMs += other.mDrawMs;
+    mRasterMs += other.mRasterMs;
+    mPyramidMs += other.mPyramidMs;
+    mPresentMs += other.mPresentMs;
+}
+
+const char* PipelineStats::CsvHeader()
+{
+    return "triangles_submitted,triangles_instance_culled,triangles_frustum_culled,triangles_backface_culled,"
+        "triangles_occlusion_culled,triangles_offscreen,triangles_degenerate,triangles_malformed,triangles_clipped,"
+        "triangles_binned,tile_triangles,pixels_tested,pixels_passed,pixels_shaded,pixels_written,pixels_blended,"
+        "clear_ms,draw_ms,raster_ms,pyramid_ms,present_ms";
+}
+
+void PipelineStats::WriteCsv(std::ostream& out) const
+{
+    out << mTrianglesSubmitted << ',' << mTrianglesInstanceCulled << ',' << mTrianglesFrustumCulled << ','
+        << mTrianglesBackfaceCulled << ',' << mTrianglesOcclusionCulled << ',' << mTrianglesOffscreen << ','
+        << mTrianglesDegenerate << ',' << mTrianglesMalformed << ',' << mTrianglesClipped << ','
+        << mTrianglesBinned << ',' << mTileTriangles << ',' << mPixelsTested << ',' << mPixelsPassed << ',' << mPixelsShaded << ','
+        << mPixelsWritten << ',' << mPixelsBlended << ','
+        << mClearMs << ',' << mDrawMs << ',' << mRasterMs << ',' << mPyramidMs << ',' << mPresentMs;
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <cstdint>
+#include <ostream>
+
+// What one frame went through, from Rasterizer::Clear() to Flush(), like the pipeline
+// statistics queries of a GPU. Workers count into their own copy, the copies are added
+// up when the frame is flushed.
+struct PipelineStats
+{
+    // triangles of the drawn instances, at the level of detail they were drawn at;
+    // instances culled whole count with their full mesh
+    uint64_t mTrianglesSubmitted = 0;
+    // culled, by reason
+    uint64_t mTrianglesInstanceCulled = 0; // the instance's bounds were outside the view
+    uint64_t mTrianglesFrustumCulled = 0; // in meshlets outside the view
+    uint64_t mTrianglesBackfaceCulled = 0; // in meshlets facing away
+    uint64_t mTrianglesOcclusionCulled = 0; // in meshlets behind the depth pyramid
+    uint64_t mTrianglesOffscreen = 0; // outside the canvas after setup
+    uint64_t mTrianglesDegenerate = 0; // covering no pixel row
+    uint64_t mTrianglesMalformed = 0; // of compressed meshes whose indices don't decode
+    // binned triangles that reach past the canvas and are cut to it while rasterized
+    uint64_t mTrianglesClipped = 0;
+    uint64_t mTrianglesBinned = 0;
+    // triangle and tile pairs rasterized, a triangle counts once per tile it touches
+    uint64_t mTileTriangles = 0;
+
+    uint64_t mPixelsTested = 0;
+    uint64_t mPixelsPassed = 0; // the depth test
+    uint64_t mPixelsShaded = 0; // the shader runs for every pixel that passes
+    uint64_t mPixelsWritten = 0; // opaque, color and depth
+    uint64_t mPixelsBlended = 0; // transparent, accumulated for the OIT resolve
+
+    // wall time per stage in milliseconds
+    double mClearMs = 0.0;
+    double mDrawMs = 0.0; // DrawInstanced(): culling, vertex transform, setup and binning
+    double mRasterMs = 0.0; // tiles, including the second occlusion pass
+    double mPyramidMs = 0.0; // the depth pyramid for next frame's occlusion culling
+    double mPresentMs = 0.0;
+
+    void Add(const PipelineStats& other);
+
+    // comma separated column names and values, in the same order
+    static const char* CsvHeader();
+    void WriteCsv(std::ostream& out) const;
+};
@@ -0,0 +1,64 @@
+#include "RadixSort.h"
+#include <utility>
+
+namespace
+{
+    constexpr int DIGIT_BITS = 11;
+    constexpr uint32_t DIGIT_COUNT = 1u << DIGIT_BITS;
+    constexpr uint32_t DIGIT_MASK = DIGIT_COUNT - 1;
+    constexpr int PASSES = 3; // 11 + 11 + 10 bits
+}
+
+void RadixSortByKey(uint32_t* keys, uint32_t* values, size_t count, uint32_t* keysTemp, uint32_t* valuesTemp)
+{
+    // all three histograms in one read of the keys
+    static thread_local uint32_t histograms[PASSES][DIGIT_COUNT];
+    std::memset(histograms, 0, sizeof(histograms));
+    for (size_t i = 0; i < count; i++)
+    {
+        const uint32_t key = keys[i];
+        histograms[0][key & DIGIT_MASK]++;
+        histograms[1][(key >> DIGIT_BITS) & DIGIT_MASK]++;
+        histograms[2][key >> (2 * DIGIT_BITS)]++;
+    }
+
+    uint32_t* srcKeys = keys;
+    uint32_t* srcValues = values;
+    uint32_t* dstKeys = keysTemp;
+    uint32_t* dstValues = valuesTemp;
+
+    for (int pass = 0; pass < PASSES; pass++)
+    {
+        uint32_t* histogram = histograms[pass];
+        const int shift = pass * DIGIT_BITS;
+
+        // every key has the same digit, this pass wouldn't move anything
+        if (count == 0 || histogram[(srcKeys[0] >> shift) & DIGIT_MASK] == count)
+            continue;
+
+        uint32_t offset = 0;
+        for (uint32_t d = 0; d < DIGIT_COUNT; d++)
+        {
+            const uint32_t digitCount = histogram[d];
+            histogram[d] = offset;
+            offset += digitCount;
+        }
+
+        for (size_t i = 0; i < count; i++)
+        {
+            const uint32_t key = srcKeys[i];
+            const uint32_t slot = histogram[(key >> shift) & DIGIT_MASK]++;
+            dstKeys[slot] = key;
+            dstValues[slot] = srcValues[i];
+        }
+
+        std::swap(srcKeys, dstKeys);
+        std::swap(srcValues, dstValues);
+    }
+
+    if (srcKeys != keys)
+    {
+        std::memcpy(keys, srcKeys, count * sizeof(uint32_t));
+        std::memcpy(values, srcValues, count * sizeof(uint32_t));
+    }
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Maps a float to an unsigned key with the same ordering, negative values included.
+inline uint32_t SortableFloat(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+}
+
+// LSD radix sort of `values` by ascending 32 bit `keys`, three passes over 11 bit digits.
+// Stable. keysTemp/valuesTemp must hold `count` entries; the result ends up in keys/values.
+void RadixSortByKey(uint32_t* keys, uint32_t* values, size_t count, uint32_t* keysTemp, uint32_t* valuesTemp);
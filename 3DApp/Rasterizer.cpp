@@ -0,0 +1,875 @@
+#include "Rasterizer.h"
+#include "Frustum.h"
+#include "VertexTransform.h"
+#include "RadixSort.h"
+#include "Trace.h"
+#include "StatsOverlay.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <thread>
+
+namespace
+{
+    // vertices per transform job, small meshes aren't worth waking workers for
+    constexpr size_t TRANSFORM_GRAIN = 16 * 1024;
+    // index blocks per decode job
+    constexpr size_t DECODE_GRAIN = 16;
+
+    // adds the time until it goes out of scope to `ms`
+    class StageTimer
+    {
+    public:
+        explicit StageTimer(double& ms) : mMs(ms), mStart(std::chrono::steady_clock::now()) {}
+        ~StageTimer() { mMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - mStart).count(); }
+
+    private:
+        double& mMs;
+        std::chrono::steady_clock::time_point mStart;
+    };
+
+    // what's needed to test the meshlets of one instance
+    struct ClusterCuller
+    {
+        Frustum mFrustum;
+        glm::vec4 mRowX, mRowY, mRowZ;
+        glm::vec3 mScale; // largest clip space length of an object space unit, per axis
+        glm::vec3 mViewDirection; // object space, pointing away from the viewer
+        bool mHasViewDirection;
+        int mWidth, mHeight; // of the canvas
+
+        ClusterCuller(const glm::mat4& mvp, int width, int height) :
+            mFrustum(Frustum::FromMatrix(mvp)),
+            mRowX(mvp[0][0], mvp[1][0], mvp[2][0], mvp[3][0]),
+            mRowY(mvp[0][1], mvp[1][1], mvp[2][1], mvp[3][1]),
+            mRowZ(mvp[0][2], mvp[1][2], mvp[2][2], mvp[3][2]),
+            mScale(glm::length(glm::vec3(mRowX)), glm::length(glm::vec3(mRowY)), glm::length(glm::vec3(mRowZ))),
+            mWidth(width),
+            mHeight(height)
+        {
+            // without a perspective divide every pixel looks down clip space +z, which is
+            // this one direction in object space
+            const glm::mat3 linear(mvp);
+            mHasViewDirection = std::abs(glm::determinant(linear)) > 1e-12f;
+            mViewDirection = mHasViewDirection ? glm::normalize(glm::inverse(linear) * glm::vec3(0.0f, 0.0f, 1.0f)) : glm::vec3(0.0f);
+        }
+
+        glm::vec3 Clip(const glm::vec3& p) const
+        {
+            const glm::vec4 p4(p, 1.0f);
+            return glm::vec3(glm::dot(mRowX, p4), glm::dot(mRowY, p4), glm::dot(mRowZ, p4));
+        }
+
+        float NearestDepth(const BoundingSphere& bounds) const
+        {
+            return glm::dot(mRowZ, glm::vec4(bounds.mCenter, 1.0f)) - bounds.mRadius * mScale.z;
+        }
+
+        // the first of `tests` that rejects the meshlet, 0 if it may be visible
+        uint32_t Test(const Meshlet& meshlet, uint32_t tests, const DepthPyramid& pyramid) const
+        {
+            if ((tests & Rasterizer::CULL_FRUSTUM) && !mFrustum.Intersects(meshlet.mBounds))
+                return Rasterizer::CULL_FRUSTUM;
+
+            if ((tests & Rasterizer::CULL_BACKFACE) && mHasViewDirection && meshlet.mConeCutoff < 1.0f
+                && glm::dot(mViewDirection, meshlet.mConeAxis) > meshlet.mConeCutoff)
+                return Rasterizer::CULL_BACKFACE;
+
+            if (tests & Rasterizer::CULL_OCCLUSION)
+            {
+                // pixel rectangle of the sphere, a pixel wider than the rasterizer could reach
+                const glm::vec3 center = Clip(meshlet.mBounds.mCenter);
+                const float rx = meshlet.mBounds.mRadius * mScale.x;
+                const float ry = meshlet.mBounds.mRadius * mScale.y;
+                auto pixel = [](float clip, int size) {
+                    return static_cast<int>(std::floor(glm::clamp((clip + 1.0f) * 0.5f * size, -1.0f, static_cast<float>(size))));
+                };
+                if (pyramid.IsOccluded(
+                    pixel(center.x - rx, mWidth) - 1, pixel(center.y - ry, mHeight) - 1,
+                    pixel(center.x + rx, mWidth) + 1, pixel(center.y + ry, mHeight) + 1,
+                    NearestDepth(meshlet.mBounds)))
+                    return Rasterizer::CULL_OCCLUSION;
+            }
+            return 0;
+        }
+    };
+}
+
+Color ShaderFunction(int x, int y, float depth, const glm::mat4& invProj, int width, int height)
+{
+    float ndcX = (2.0f * x) / width + 0.5f;
+    float ndcY = (2.0f * y) / height + 0.5f;
+
+    glm::vec4 clipSpacePos(ndcX, ndcY, depth, 1.0f);
+    glm::vec4 worldPos = invProj * clipSpacePos;
+
+    uint8_t red = static_cast<uint8_t>(glm::clamp(((worldPos.x) * 255.0f), 0.0f, 255.0f));
+    uint8_t green = static_cast<uint8_t>(glm::clamp(((worldPos.y) * 255.0f), 0.0f, 255.0f));
+    uint8_t blue = static_cast<uint8_t>(glm::clamp(((worldPos.z) * 255.0f), 0.0f, 255.0f));
+
+    return Color(red, green, blue);
+}
+
+bool Rasterizer::SetPixel(int x, int y, float zDepth, Color color, ShaderFn shader)
+{
+    if (zDepthBuffer[x + y * mWidth] > zDepth)
+    {
+        zDepthBuffer[x + y * mWidth] = zDepth;
+        Color computedColor = shader(x, y, zDepth, invProj, mWidth, mHeight) * color;
+        uint8_t* pixel = &mColorBuffer[(x + y * mWidth) * 4];
+        pixel[0] = computedColor.r;
+        pixel[1] = computedColor.g;
+        pixel[2] = computedColor.b;
+        pixel[3] = 255;
+        return true;
+    }
+    return false;
+}
+
+bool Rasterizer::BlendPixel(int x, int y, float zDepth, Color color, ShaderFn shader)
+{
+    if (zDepthBuffer[x + y * mWidth] > zDepth)
+    {
+        Color computedColor = shader(x, y, zDepth, invProj, mWidth, mHeight) * color;
+        mOit.Accumulate(x, y, zDepth,
+            computedColor.r / 255.0f,
+            computedColor.g / 255.0f,
+            computedColor.b / 255.0f,
+            computedColor.a / 255.0f);
+        return true;
+    }
+    return false;
+}
+
+void Rasterizer::DrawSpan(int sx, int sy, int ex, float sz, float ez, Color color, ShaderFn shader, int clipX0, int clipX1, bool transparent, PipelineStats& stats)
+{
+    if (sy < 0 || sy >= mHeight) return;
+
+    if (sx > ex) {
+        std::swap(sx, ex);
+        std::swap(sz, ez);
+    }
+
+    // interpolate over the whole span so clipping to a tile doesn't shift the depth
+    const int cx0 = std::max(sx, std::max(clipX0, 0));
+    const int cx1 = std::min(ex, std::min(clipX1, mWidth) - 1);
+    if (cx0 > cx1) return;
+    uint32_t passed = 0;
+    if (!mDepthTests.empty())
+    {
+        // a pixel debug view is on, count per pixel
+        uint16_t* tests = &mDepthTests[static_cast<size_t>(sy) * mWidth];
+        uint16_t* shaded = &mShadedPixels[static_cast<size_t>(sy) * mWidth];
+        for (int cx = cx0; cx <= cx1; ++cx) {
+            float z = LerpZ(sx, ex, cx, sz, ez);
+            const bool pass = transparent ? BlendPixel(cx, sy, z, color, shader) : SetPixel(cx, sy, z, color, shader);
+            passed += pass;
+            tests[cx]++;
+            shaded[cx] += pass;
+        }
+    }
+    else
+    {
+        for (int cx = cx0; cx <= cx1; ++cx) {
+            float z = LerpZ(sx, ex, cx, sz, ez);
+            if (transparent)
+                passed += BlendPixel(cx, sy, z, color, shader);
+            else
+                passed += SetPixel(cx, sy, z, color, shader);
+        }
+    }
+    stats.mPixelsTested += cx1 - cx0 + 1;
+    stats.mPixelsPassed += passed;
+    stats.mPixelsShaded += passed;
+    (transparent ? stats.mPixelsBlended : stats.mPixelsWritten) += passed;
+}
+
+Triangle Rasterizer::NDCTriangle(const Triangle& tWS) const
+{
+    Vector3 ndcA = Vector3(
+        static_cast<int>((tWS.mP1.x + 1.0f) * 0.5f * mWidth),
+        static_cast<int>((tWS.mP1.y + 1.0f) * 0.5f * mHeight),
+        tWS.mP1.z
+    );
+    Vector3 ndcB = Vector3(
+        static_cast<int>((tWS.mP2.x + 1.0f) * 0.5f * mWidth),
+        static_cast<int>((tWS.mP2.y + 1.0f) * 0.5f * mHeight),
+        tWS.mP2.z
+    );
+    Vector3 ndcC = Vector3(
+        static_cast<int>((tWS.mP3.x + 1.0f) * 0.5f * mWidth),
+        static_cast<int>((tWS.mP3.y + 1.0f) * 0.5f * mHeight),
+        tWS.mP3.z
+    );
+    Triangle tNDC = { ndcA, ndcB, ndcC };
+    return tNDC;
+}
+
+void Rasterizer::DrawTriangle(const Triangle& tWS, Color color)
+{
+    Triangle tNDC = NDCTriangle(tWS);
+    //sort so we got the points on the top, as p1..p2,
+    if (tNDC.mP2.y > tNDC.mP3.y) std::swap(tNDC.mP2, tNDC.mP3);
+    if (tNDC.mP1.y > tNDC.mP2.y) std::swap(tNDC.mP1, tNDC.mP2);
+    if (tNDC.mP2.y > tNDC.mP3.y) std::swap(tNDC.mP2, tNDC.mP3);
+
+    const int minX = static_cast<int>(std::min(tNDC.mP1.x, std::min(tNDC.mP2.x, tNDC.mP3.x)));
+    const int maxX = static_cast<int>(std::max(tNDC.mP1.x, std::max(tNDC.mP2.x, tNDC.mP3.x)));
+    const int minY = static_cast<int>(tNDC.mP1.y);
+    const int maxY = static_cast<int>(tNDC.mP3.y);
+    mFrameStats.mTrianglesSubmitted++;
+    if (maxX < 0 || minX >= mWidth || maxY < 0 || minY >= mHeight)
+    {
+        mFrameStats.mTrianglesOffscreen++;
+        return;
+    }
+    if (minY == maxY)
+    {
+        mFrameStats.mTrianglesDegenerate++;
+        return;
+    }
+    mFrameStats.mTrianglesBinned++;
+    if (minX < 0 || maxX >= mWidth || minY < 0 || maxY >= mHeight)
+        mFrameStats.mTrianglesClipped++;
+    if (mDebugView == DebugView::TriangleSizes)
+    {
+        const float area = 0.5f * std::abs(
+            (tNDC.mP2.x - tNDC.mP1.x) * (tNDC.mP3.y - tNDC.mP1.y) - (tNDC.mP3.x - tNDC.mP1.x) * (tNDC.mP2.y - tNDC.mP1.y));
+        int bucket = 0;
+        for (float size = 1.0f; area >= size && bucket < TRIANGLE_SIZE_BUCKETS - 1; size *= 2.0f)
+            bucket++;
+        mTriangleSizes[bucket]++;
+    }
+
+    const bool transparent = mBlendMode == BlendMode::WeightedBlended;
+    const uint32_t index = static_cast<uint32_t>(mTriangles.size());
+    mTriangles.push_back({ tNDC, color, mShader, std::min(tNDC.mP1.z, std::min(tNDC.mP2.z, tNDC.mP3.z)) });
+
+    const int tx0 = std::max(minX, 0) / mTileSize;
+    const int tx1 = std::min(maxX, mWidth - 1) / mTileSize;
+    const int ty0 = std::max(minY, 0) / mTileSize;
+    const int ty1 = std::min(maxY, mHeight - 1) / mTileSize;
+    for (int ty = ty0; ty <= ty1; ty++)
+    {
+        for (int tx = tx0; tx <= tx1; tx++)
+        {
+            TileBin& bin = mBins[tx + ty * mTilesX];
+            (transparent ? bin.mTransparent : bin.mOpaque).push_back(index);
+        }
+    }
+}
+
+void Rasterizer::ReserveTransformed(size_t vertexCount)
+{
+    if (mTransformedX.size() < vertexCount)
+    {
+        mTransformedX.resize(vertexCount);
+        mTransformedY.resize(vertexCount);
+        mTransformedZ.resize(vertexCount);
+    }
+}
+
+void Rasterizer::DrawTransformed(const MeshView& mesh, Color color)
+{
+    const size_t triangleCount = mesh.TriangleCount();
+    const uint32_t* order = nullptr;
+    if (mDepthSortThreshold != 0 && triangleCount >= mDepthSortThreshold && mBlendMode == BlendMode::Opaque)
+    {
+        mDrawSortScratch.Resize(triangleCount);
+        for (uint32_t t = 0; t < triangleCount; t++)
+        {
+            const float minZ = std::min(mTransformedZ[mesh.Index(t * 3)],
+                std::min(mTransformedZ[mesh.Index(t * 3 + 1)], mTransformedZ[mesh.Index(t * 3 + 2)]));
+            mDrawSortScratch.mKeys[t] = SortableFloat(minZ);
+            mDrawSortScratch.mValues[t] = t;
+        }
+        mDrawSortScratch.Sort();
+        order = mDrawSortScratch.mValues.data();
+    }
+
+    for (size_t n = 0; n < triangleCount; n++)
+    {
+        const size_t t = (order ? order[n] : n) * 3;
+        const uint32_t a = mesh.Index(t), b = mesh.Index(t + 1), c = mesh.Index(t + 2);
+        DrawTriangle(Triangle(
+            Vector3(mTransformedX[a], mTransformedY[a], mTransformedZ[a]),
+            Vector3(mTransformedX[b], mTransformedY[b], mTransformedZ[b]),
+            Vector3(mTransformedX[c], mTransformedY[c], mTransformedZ[c])),
+            color);
+    }
+}
+
+void Rasterizer::DrawCluster(const MeshView& mesh, const Meshlet& meshlet, const glm::mat4& mvp, Color color)
+{
+    const uint32_t* vertices = mesh.mMeshletVertices + meshlet.mVertexOffset;
+    for (uint32_t v = 0; v < meshlet.mVertexCount; v++)
+    {
+        mClusterX[v] = mesh.mX[vertices[v]];
+        mClusterY[v] = mesh.mY[vertices[v]];
+        mClusterZ[v] = mesh.mZ[vertices[v]];
+    }
+    TransformPositions(mvp, mClusterX.data(), mClusterY.data(), mClusterZ.data(), meshlet.mVertexCount,
+        mTransformedX.data(), mTransformedY.data(), mTransformedZ.data());
+
+    const uint8_t* triangles = mesh.mMeshletTriangles + meshlet.mTriangleOffset;
+    for (uint32_t t = 0; t < meshlet.mTriangleCount; t++)
+    {
+        const uint8_t a = triangles[t * 3], b = triangles[t * 3 + 1], c = triangles[t * 3 + 2];
+        DrawTriangle(Triangle(
+            Vector3(mTransformedX[a], mTransformedY[a], mTransformedZ[a]),
+            Vector3(mTransformedX[b], mTransformedY[b], mTransformedZ[b]),
+            Vector3(mTransformedX[c], mTransformedY[c], mTransformedZ[c])),
+            color);
+    }
+}
+
+void Rasterizer::DrawClusters(const MeshView& mesh, const glm::mat4& mvp, Color color)
+{
+    ReserveTransformed(MESHLET_VERTEX_LIMIT);
+    mClusterX.resize(MESHLET_VERTEX_LIMIT);
+    mClusterY.resize(MESHLET_VERTEX_LIMIT);
+    mClusterZ.resize(MESHLET_VERTEX_LIMIT);
+
+    // see through transparent surfaces, their back faces and what's behind them show
+    const bool opaque = mBlendMode == BlendMode::Opaque;
+    uint32_t tests = mClusterCulling & (opaque ? static_cast<uint32_t>(CULL_ALL) : static_cast<uint32_t>(CULL_FRUSTUM));
+    mPyramidWanted = mPyramidWanted || (tests & CULL_OCCLUSION) != 0;
+    if (mPyramidCanvas != mCanvas || !mDepthPyramid.IsValid())
+        tests &= ~static_cast<uint32_t>(CULL_OCCLUSION);
+
+    const ClusterCuller culler(mvp, mWidth, mHeight);
+    const size_t firstOccluded = mOccludedClusters.size();
+    mVisibleClusters.clear();
+    for (uint32_t c = 0; c < mesh.mMeshletCount; c++)
+    {
+        switch (culler.Test(mesh.mMeshlets[c], tests, mDepthPyramid))
+        {
+        case 0:
+            mVisibleClusters.push_back(c);
+            break;
+        case CULL_FRUSTUM:
+            mClusterStats.mFrustumCulled++;
+            mFrameStats.mTrianglesSubmitted += mesh.mMeshlets[c].mTriangleCount;
+            mFrameStats.mTrianglesFrustumCulled += mesh.mMeshlets[c].mTriangleCount;
+            break;
+        case CULL_BACKFACE:
+            mClusterStats.mBackfaceCulled++;
+            mFrameStats.mTrianglesSubmitted += mesh.mMeshlets[c].mTriangleCount;
+            mFrameStats.mTrianglesBackfaceCulled += mesh.mMeshlets[c].mTriangleCount;
+            break;
+        case CULL_OCCLUSION:
+            mOccludedClusters.push_back(c);
+            break;
+        }
+    }
+    if (mOccludedClusters.size() > firstOccluded)
+    {
+        mOccludedDraws.push_back({ mesh, mvp, color, mShader,
+            static_cast<uint32_t>(firstOccluded), static_cast<uint32_t>(mOccludedClusters.size() - firstOccluded) });
+    }
+
+    if (opaque && mDepthSortThreshold != 0 && mVisibleClusters.size() > 1)
+    {
+        mDrawSortScratch.Resize(mVisibleClusters.size());
+        for (size_t i = 0; i < mVisibleClusters.size(); i++)
+        {
+            mDrawSortScratch.mKeys[i] = SortableFloat(culler.NearestDepth(mesh.mMeshlets[mVisibleClusters[i]].mBounds));
+            mDrawSortScratch.mValues[i] = mVisibleClusters[i];
+        }
+        mDrawSortScratch.Sort();
+        mVisibleClusters.swap(mDrawSortScratch.mValues);
+    }
+
+    for (uint32_t c : mVisibleClusters)
+        DrawCluster(mesh, mesh.mMeshlets[c], mvp, color);
+    mClusterStats.mDrawn += mVisibleClusters.size();
+}
+
+void Rasterizer::DrawOccludedClusters()
+{
+    const BlendMode blendMode = mBlendMode;
+    const ShaderFn shader = mShader;
+    mBlendMode = BlendMode::Opaque;
+    for (const OccludedDraw& draw : mOccludedDraws)
+    {
+        const ClusterCuller culler(draw.mMvp, mWidth, mHeight);
+        mShader = draw.mShader;
+        for (uint32_t i = 0; i < draw.mClusterCount; i++)
+        {
+            const Meshlet& meshlet = draw.mMesh.mMeshlets[mOccludedClusters[draw.mFirstCluster + i]];
+            if (culler.Test(meshlet, CULL_OCCLUSION, mDepthPyramid) != 0)
+            {
+                mClusterStats.mOcclusionCulled++;
+                mFrameStats.mTrianglesSubmitted += meshlet.mTriangleCount;
+                mFrameStats.mTrianglesOcclusionCulled += meshlet.mTriangleCount;
+                continue;
+            }
+            DrawCluster(draw.mMesh, meshlet, draw.mMvp, draw.mColor);
+            mClusterStats.mDrawn++;
+        }
+    }
+    mBlendMode = blendMode;
+    mShader = shader;
+    mOccludedDraws.clear();
+    mOccludedClusters.clear();
+}
+
+size_t Rasterizer::SelectLevel(const MeshView& mesh, const glm::mat4& mvp) const
+{
+    if (mLodErrorThreshold <= 0.0f)
+        return 0;
+    size_t level = 0;
+    while (level + 1 < mesh.LevelCount()
+        && ProjectedLength(mvp, mesh.LevelError(level + 1), mWidth, mHeight) <= mLodErrorThreshold)
+        level++;
+    return level;
+}
+
+void Rasterizer::DrawInstanced(const MeshView& mesh, const InstanceData* instances, size_t count)
+{
+    StageTimer timer(mFrameStats.mDrawMs);
+    TRACE_ZONE("draw");
+    ReserveTransformed(mesh.VertexCount());
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const glm::mat4 mvp = proj * instances[i].mModel;
+        if (!Frustum::FromMatrix(mvp).Intersects(mesh.mBounds))
+        {
+            mFrameStats.mTrianglesSubmitted += mesh.TriangleCount();
+            mFrameStats.mTrianglesInstanceCulled += mesh.TriangleCount();
+            continue;
+        }
+
+        // levels only use a prefix of the vertices, the rest isn't transformed
+        const MeshView level = mesh.LevelCount() > 1 ? mesh.Level(SelectLevel(mesh, mvp)) : mesh;
+        if (level.HasMeshlets())
+        {
+            // transformed and binned cluster by cluster
+            TRACE_ZONE("clusters");
+            DrawClusters(level, mvp, instances[i].mColor);
+            continue;
+        }
+        TransformVertices(mvp, level.mX, level.mY, level.mZ, level.VertexCount());
+        TRACE_ZONE("bin");
+        DrawTransformed(level, instances[i].mColor);
+    }
+}
+
+void Rasterizer::DrawInstanced(const CompressedMeshView& mesh, const InstanceData* instances, size_t count)
+{
+    StageTimer timer(mFrameStats.mDrawMs);
+    TRACE_ZONE("draw");
+    const size_t vertexCount = mesh.VertexCount();
+    ReserveTransformed(vertexCount);
+
+    // the triangles see the decoded indices as a plain mesh
+    MeshView indices;
+    bool decoded = false;
+    const glm::mat4 dequantize = mesh.Dequantize();
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const glm::mat4 mvp = proj * instances[i].mModel;
+        if (!Frustum::FromMatrix(mvp).Intersects(mesh.mBounds))
+        {
+            mFrameStats.mTrianglesSubmitted += mesh.mIndexCount / 3;
+            mFrameStats.mTrianglesInstanceCulled += mesh.mIndexCount / 3;
+            continue;
+        }
+
+        if (!decoded)
+        {
+            TRACE_ZONE("decode");
+            // blocks decode independently
+            mDecodedIndices.resize(mesh.mIndexCount);
+            std::atomic<bool> malformed(false);
+            mJobs->ParallelFor(mesh.IndexBlockCount(), DECODE_GRAIN, [&](size_t begin, size_t end, unsigned) {
+                const size_t first = begin * MESH_INDEX_BLOCK_SIZE;
+                const size_t expected = std::min(end * MESH_INDEX_BLOCK_SIZE, mesh.mIndexCount) - first;
+                if (DecodeIndices(mesh, begin, end - begin, mDecodedIndices.data() + first) != expected)
+                    malformed = true;
+            });
+            if (malformed)
+            {
+                // MeshFile refuses such streams, so this is a view put together by hand
+                if (!mReportedMalformed)
+                    std::cerr << "Rasterizer: a compressed mesh's index stream doesn't decode, its draws are skipped" << std::endl;
+                mReportedMalformed = true;
+                mFrameStats.mTrianglesSubmitted += (count - i) * (mesh.mIndexCount / 3);
+                mFrameStats.mTrianglesMalformed += (count - i) * (mesh.mIndexCount / 3);
+                return;
+            }
+            indices.mIndices = mDecodedIndices.data();
+            indices.mIndexCount = mesh.mIndexCount;
+            indices.mVertexCount = vertexCount;
+            decoded = true;
+        }
+
+        TransformVertices(mvp * dequantize, mesh.mQX, mesh.mQY, mesh.mQZ, vertexCount);
+        TRACE_ZONE("bin");
+        DrawTransformed(indices, instances[i].mColor);
+    }
+}
+
+void Rasterizer::RasterizeTriangle(const BinnedTriangle& t, bool transparent, const TileRect& tile, PipelineStats& stats)
+{
+    stats.mTileTriangles++;
+    const Triangle& tNDC = t.mNDC;
+
+    //longerSide = tNDC.mP1 -> tNDC.mP3;
+    //shorterSide = tNDC.mP1 -> tNDC.mP2;
+    //bottomSide = tNDC.mP2 -> tNDC.mP3;
+    const int upperStart = std::max(static_cast<int>(tNDC.mP1.y), tile.y0);
+    const int upperEnd = std::min(static_cast<int>(tNDC.mP2.y), tile.y1);
+    for (int i = upperStart; i < upperEnd; i++)
+    {
+        int sx = Lerp(tNDC.mP1, tNDC.mP1 - tNDC.mP3, i);
+        int ex = Lerp(tNDC.mP2, tNDC.mP1 - tNDC.mP2, i);
+        float sz = LerpZ(tNDC.mP1.y, tNDC.mP3.y, i, tNDC.mP1.z, tNDC.mP3.z);
+        float ez = LerpZ(tNDC.mP1.y, tNDC.mP2.y, i, tNDC.mP1.z, tNDC.mP2.z);
+        DrawSpan(sx, i, ex, sz, ez, t.mColor, t.mShader, tile.x0, tile.x1, transparent, stats);
+    }
+    const int lowerStart = std::max(static_cast<int>(tNDC.mP2.y), tile.y0);
+    const int lowerEnd = std::min(static_cast<int>(tNDC.mP3.y), tile.y1);
+    for (int i = lowerStart; i < lowerEnd; i++)
+    {
+        int sx = Lerp(tNDC.mP1, tNDC.mP1 - tNDC.mP3, i);
+        int ex = Lerp(tNDC.mP2, tNDC.mP2 - tNDC.mP3, i);
+        float sz = LerpZ(tNDC.mP1.y, tNDC.mP3.y, i, tNDC.mP1.z, tNDC.mP3.z);
+        float ez = LerpZ(tNDC.mP2.y, tNDC.mP3.y, i, tNDC.mP2.z, tNDC.mP3.z);
+        DrawSpan(sx, i, ex, sz, ez, t.mColor, t.mShader, tile.x0, tile.x1, transparent, stats);
+    }
+}
+
+void Rasterizer::DepthSortScratch::Resize(size_t count)
+{
+    mKeys.resize(count);
+    mValues.resize(count);
+    mKeysTemp.resize(count);
+    mValuesTemp.resize(count);
+}
+
+void Rasterizer::DepthSortScratch::Sort()
+{
+    RadixSortByKey(mKeys.data(), mValues.data(), mKeys.size(), mKeysTemp.data(), mValuesTemp.data());
+}
+
+void Rasterizer::RasterizeTile(int tileIndex, unsigned worker, bool opaqueOnly)
+{
+    TRACE_ZONE_VALUE("tile", tileIndex);
+    LinearAllocator& arena = mFrameArena.Worker(worker);
+    // counted locally, the workers' stats share cache lines
+    PipelineStats stats;
+    const int tx = tileIndex % mTilesX;
+    const int ty = tileIndex / mTilesX;
+    const TileRect rect = {
+        tx * mTileSize,
+        ty * mTileSize,
+        std::min((tx + 1) * mTileSize, mWidth),
+        std::min((ty + 1) * mTileSize, mHeight)
+    };
+
+    TileBin& bin = mBins[tileIndex];
+    const size_t count = bin.mOpaque.size();
+    if (mDepthSortThreshold != 0 && count >= mDepthSortThreshold)
+    {
+        uint32_t* keys = static_cast<uint32_t*>(arena.Allocate(count * 4 * sizeof(uint32_t), alignof(uint32_t)));
+        uint32_t* keysTemp = keys + count;
+        uint32_t* valuesTemp = keys + count * 2;
+        uint32_t* values = keys + count * 3;
+        for (size_t i = 0; i < count; i++)
+        {
+            keys[i] = SortableFloat(mTriangles[bin.mOpaque[i]].mMinZ);
+            values[i] = bin.mOpaque[i];
+        }
+        RadixSortByKey(keys, values, count, keysTemp, valuesTemp);
+        std::copy(values, values + count, bin.mOpaque.begin());
+    }
+
+    for (uint32_t index : bin.mOpaque)
+        RasterizeTriangle(mTriangles[index], false, rect, stats);
+    if (opaqueOnly)
+    {
+        bin.mOpaque.clear();
+        mWorkerStats[worker].Add(stats);
+        return;
+    }
+
+    if (!bin.mTransparent.empty())
+    {
+        // the opaque depth of this tile is final, accumulate and resolve its transparency
+        TRACE_ZONE("transparency");
+        mOit.ClearRect(rect.x0, rect.y0, rect.x1, rect.y1);
+        for (uint32_t index : bin.mTransparent)
+            RasterizeTriangle(mTriangles[index], true, rect, stats);
+        for (int y = rect.y0; y < rect.y1; y++)
+            mOit.CompositeRow(y, rect.x0, rect.x1, &mColorBuffer[(rect.x0 + y * mWidth) * 4]);
+    }
+    mWorkerStats[worker].Add(stats);
+}
+
+void Rasterizer::RasterizeTiles(bool opaqueOnly)
+{
+    // a tile per job, their cost varies too much to batch them
+    mJobs->ParallelFor(mTilesX * mTilesY, 1, [&](size_t begin, size_t end, unsigned worker) {
+        for (size_t tile = begin; tile < end; tile++)
+        {
+            if (mTileMs.empty())
+            {
+                RasterizeTile(static_cast<int>(tile), worker, opaqueOnly);
+                continue;
+            }
+            StageTimer timer(mTileMs[tile]);
+            RasterizeTile(static_cast<int>(tile), worker, opaqueOnly);
+        }
+    });
+}
+
+void Rasterizer::TransformVertices(const glm::mat4& mvp, const float* x, const float* y, const float* z, size_t count)
+{
+    TRACE_ZONE("transform");
+    mJobs->ParallelFor(count, TRANSFORM_GRAIN, [&](size_t begin, size_t end, unsigned) {
+        TransformPositions(mvp, x + begin, y + begin, z + begin, end - begin,
+            mTransformedX.data() + begin, mTransformedY.data() + begin, mTransformedZ.data() + begin);
+    });
+}
+
+void Rasterizer::TransformVertices(const glm::mat4& mvp, const uint16_t* x, const uint16_t* y, const uint16_t* z, size_t count)
+{
+    TRACE_ZONE("transform");
+    mJobs->ParallelFor(count, TRANSFORM_GRAIN, [&](size_t begin, size_t end, unsigned) {
+        TransformQuantizedPositions(mvp, x + begin, y + begin, z + begin, end - begin,
+            mTransformedX.data() + begin, mTransformedY.data() + begin, mTransformedZ.data() + begin);
+    });
+}
+
+void Rasterizer::Flush()
+{
+    {
+        StageTimer timer(mFrameStats.mRasterMs);
+        TRACE_ZONE("raster");
+        if (!mOccludedDraws.empty())
+        {
+            // the old depth only guessed what's hidden, check against this frame's so far
+            RasterizeTiles(true);
+            TRACE_ZONE("occluded");
+            mDepthPyramid.Build(zDepthBuffer, mWidth, mHeight, *mJobs);
+            DrawOccludedClusters();
+        }
+        RasterizeTiles(false);
+    }
+
+    // only frames with meshlets to cull pay for the pyramid; without it the canvas's
+    // next meshlet draw skips the occlusion test once
+    if (mPyramidWanted)
+    {
+        StageTimer timer(mFrameStats.mPyramidMs);
+        TRACE_ZONE("pyramid");
+        mDepthPyramid.Build(zDepthBuffer, mWidth, mHeight, *mJobs);
+        mPyramidCanvas = mCanvas;
+    }
+    else if (mPyramidCanvas == mCanvas)
+    {
+        mDepthPyramid.Invalidate();
+    }
+    if (mDebugView != DebugView::None)
+        DrawDebugView();
+    {
+        StageTimer timer(mFrameStats.mPresentMs);
+        TRACE_ZONE("present");
+        mCanvas->Present(mColorBuffer.data(), mWidth, mHeight);
+    }
+
+    mLastStats = mFrameStats;
+    for (PipelineStats& stats : mWorkerStats)
+    {
+        mLastStats.Add(stats);
+        stats = PipelineStats();
+    }
+}
+
+void Rasterizer::Resize(int width, int height)
+{
+    mWidth = std::max(width, 1);
+    mHeight = std::max(height, 1);
+    const size_t pixelCount = static_cast<size_t>(mWidth) * mHeight;
+    delete[] zDepthBuffer;
+    zDepthBuffer = new float[pixelCount];
+    mColorBuffer.assign(pixelCount * 4, 0);
+    mOit = WeightedBlendedOit(mWidth, mHeight);
+    ResizeTiles();
+    mDepthPyramid.Invalidate();
+    Clear();
+}
+
+void Rasterizer::SetTileSize(int size)
+{
+    mTileSize = std::max(size, MIN_TILE_SIZE);
+    ResizeTiles();
+    Clear();
+}
+
+void Rasterizer::ResizeTiles()
+{
+    mTilesX = (mWidth + mTileSize - 1) / mTileSize;
+    mTilesY = (mHeight + mTileSize - 1) / mTileSize;
+    // the bins were recorded against the old tile grid
+    mBins.assign(mTilesX * mTilesY, TileBin());
+}
+
+void Rasterizer::SetThreadCount(unsigned count)
+{
+    count = std::max(count, 1u);
+    if (count == mThreadCount)
+        return;
+    mThreadCount = count;
+    StartWorkers();
+}
+
+void Rasterizer::SetPinWorkers(bool pinned)
+{
+    if (pinned == mPinWorkers)
+        return;
+    mPinWorkers = pinned;
+    // unpinning means new threads, their affinity isn't restricted
+    StartWorkers();
+}
+
+void Rasterizer::StartWorkers()
+{
+    mJobs.reset();
+    mJobs.reset(new JobSystem(mThreadCount - 1));
+    if (mPinWorkers)
+        mJobs->PinWorkers();
+    mFrameArena.Grow(mJobs->SlotCount());
+    mWorkerStats.resize(mJobs->SlotCount());
+}
+
+void Rasterizer::Clear()
+{
+    mFrameStats = PipelineStats();
+    for (PipelineStats& stats : mWorkerStats)
+        stats = PipelineStats();
+    StageTimer timer(mFrameStats.mClearMs);
+    TRACE_ZONE("clear");
+    for (size_t i = 0; i < static_cast<size_t>(mWidth) * mHeight; i++)
+        zDepthBuffer[i] = 999.0f;
+    for (size_t i = 0; i < mColorBuffer.size(); i += 4)
+    {
+        mColorBuffer[i + 0] = 0;
+        mColorBuffer[i + 1] = 0;
+        mColorBuffer[i + 2] = 0;
+        mColorBuffer[i + 3] = 255;
+    }
+    mClusterStats = ClusterStats();
+    mPyramidWanted = false;
+    ResetDebugCounters();
+    BeginFrame();
+}
+
+void Rasterizer::SetDebugView(DebugView view)
+{
+    mDebugView = view;
+    ResetDebugCounters();
+}
+
+const char* Rasterizer::DebugViewName(DebugView view)
+{
+    switch (view)
+    {
+    case DebugView::None: return "none";
+    case DebugView::Overdraw: return "overdraw";
+    case DebugView::ShadedPixels: return "shaded pixels";
+    case DebugView::TileTime: return "tile time";
+    case DebugView::TriangleSizes: return "triangle sizes";
+    }
+    return "";
+}
+
+void Rasterizer::ResetDebugCounters()
+{
+    const bool pixels = mDebugView == DebugView::Overdraw || mDebugView == DebugView::ShadedPixels;
+    const size_t pixelCount = pixels ? static_cast<size_t>(mWidth) * mHeight : 0;
+    mDepthTests.assign(pixelCount, 0);
+    mShadedPixels.assign(pixelCount, 0);
+    mTileMs.assign(mDebugView == DebugView::TileTime ? mTilesX * mTilesY : 0, 0.0);
+    std::fill(mTriangleSizes, mTriangleSizes + TRIANGLE_SIZE_BUCKETS, 0);
+}
+
+void Rasterizer::DrawDebugView()
+{
+    TRACE_ZONE("debug view");
+    switch (mDebugView)
+    {
+    case DebugView::None:
+        break;
+    case DebugView::Overdraw:
+        DrawCountHeatmap(mColorBuffer.data(), mWidth, mHeight, mDepthTests.data(), "depth tests");
+        break;
+    case DebugView::ShadedPixels:
+        DrawCountHeatmap(mColorBuffer.data(), mWidth, mHeight, mShadedPixels.data(), "shaded");
+        break;
+    case DebugView::TileTime:
+        DrawTileHeatmap(mColorBuffer.data(), mWidth, mHeight, mTileSize, mTileMs.data());
+        break;
+    case DebugView::TriangleSizes:
+        DrawTriangleSizeHistogram(mColorBuffer.data(), mWidth, mHeight, mTriangleSizes, TRIANGLE_SIZE_BUCKETS);
+        break;
+    }
+}
+
+void Rasterizer::BeginFrame()
+{
+    // fresh containers, the old ones' memory goes with the arena; sized like the largest
+    // frame so far so they don't regrow through the arena every frame
+    mLastTriangleCount = std::max(mLastTriangleCount, mTriangles.size());
+    for (TileBin& bin : mBins)
+    {
+        bin.mLastOpaque = std::max(bin.mLastOpaque, bin.mOpaque.size());
+        bin.mLastTransparent = std::max(bin.mLastTransparent, bin.mTransparent.size());
+    }
+    mFrameArena.Reset();
+
+    mTriangles = ArenaVector<BinnedTriangle>(mFrameArena.Allocator<BinnedTriangle>(0));
+    mTriangles.reserve(mLastTriangleCount);
+    for (TileBin& bin : mBins)
+    {
+        bin.mOpaque = ArenaVector<uint32_t>(mFrameArena.Allocator<uint32_t>(0));
+        bin.mOpaque.reserve(bin.mLastOpaque);
+        bin.mTransparent = ArenaVector<uint32_t>(mFrameArena.Allocator<uint32_t>(0));
+        bin.mTransparent.reserve(bin.mLastTransparent);
+    }
+    mOccludedDraws = ArenaVector<OccludedDraw>(mFrameArena.Allocator<OccludedDraw>(0));
+    mOccludedClusters = ArenaVector<uint32_t>(mFrameArena.Allocator<uint32_t>(0));
+}
+
+Rasterizer::Rasterizer(
+    RenderTarget* canvas,
+    std::function<Color(const Triangle*, const glm::vec3)> colorCb,
+    bool useDebugColors
+   ) :
+    mCanvas(canvas),
+    mWidth(CANVAS_WIDTH),
+    mHeight(CANVAS_HEIGHT),
+    mTilesX((CANVAS_WIDTH + DEFAULT_TILE_SIZE - 1) / DEFAULT_TILE_SIZE),
+    mTilesY((CANVAS_HEIGHT + DEFAULT_TILE_SIZE - 1) / DEFAULT_TILE_SIZE),
+    mColorBuffer(CANVAS_WIDTH * CANVAS_HEIGHT * 4),
+    mColorCb(colorCb),
+    mOit(CANVAS_WIDTH, CANVAS_HEIGHT),
+    mThreadCount(std::max(1u, std::thread::hardware_concurrency())),
+    mJobs(new JobSystem(mThreadCount - 1)),
+    mFrameArena(mThreadCount),
+    mBins(mTilesX * mTilesY),
+    mWorkerStats(mThreadCount)
+{
+    zDepthBuffer = new float[CANVAS_WIDTH * CANVAS_HEIGHT];
+    BeginFrame();
+}
+
+Rasterizer::~Rasterizer()
+{
+    delete[] zDepthBuffer;
+}
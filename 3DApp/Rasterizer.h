@@ -0,0 +1,334 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include "glm/glm.hpp"
+#include "Mesh.h"
+#include "MeshCodec.h"
+#include "DepthPyramid.h"
+#include "Transparency.h"
+#include "FrameArena.h"
+#include "RenderTarget.h"
+#include "PipelineStats.h"
+#include "JobSystem.h"
+
+constexpr int CANVAS_WIDTH = 400;
+constexpr int CANVAS_HEIGHT = 300;
+
+Color ShaderFunction(int x, int y, float depth, const glm::mat4& invProj, int width, int height);
+
+// x and y are the pixel on a width x height canvas, the rasterizer's current size
+using ShaderFn = Color (*)(int x, int y, float depth, const glm::mat4& invProj, int width, int height);
+
+struct InstanceData
+{
+    glm::mat4 mModel;
+    Color mColor;
+};
+
+enum class BlendMode
+{
+    Opaque,
+    // weighted blended OIT, triangles may be drawn in any order
+    WeightedBlended,
+};
+
+// what Flush() presents instead of the image, see Rasterizer::SetDebugView()
+enum class DebugView
+{
+    None,
+    Overdraw,
+    ShadedPixels,
+    TileTime,
+    TriangleSizes,
+};
+
+// Triangles are set up and binned into screen tiles as they are drawn, Flush()
+// then rasterizes the tiles on all cores. Every pixel belongs to exactly one tile
+// and each bin keeps submission order, so the result matches drawing immediately.
+class Rasterizer
+{
+public:
+    static constexpr int DEFAULT_TILE_SIZE = 64;
+    static constexpr int MIN_TILE_SIZE = 8;
+    static constexpr size_t DEFAULT_DEPTH_SORT_THRESHOLD = 256;
+    static constexpr float DEFAULT_LOD_ERROR_THRESHOLD = 1.0f;
+    static constexpr int TRIANGLE_SIZE_BUCKETS = 16;
+
+    // tests DrawInstanced() runs on the meshlets of a mesh, see SetClusterCulling()
+    enum ClusterCulling : uint32_t
+    {
+        CULL_FRUSTUM = 1 << 0,
+        CULL_BACKFACE = 1 << 1,
+        CULL_OCCLUSION = 1 << 2,
+        CULL_ALL = CULL_FRUSTUM | CULL_BACKFACE | CULL_OCCLUSION,
+    };
+
+    // meshlets since Clear(), each counted once under the test that rejected it
+    struct ClusterStats
+    {
+        size_t mDrawn = 0;
+        size_t mFrustumCulled = 0;
+        size_t mBackfaceCulled = 0;
+        size_t mOcclusionCulled = 0;
+    };
+
+private:
+    struct BinnedTriangle
+    {
+        Triangle mNDC; // screen space, sorted by y
+        Color mColor;
+        ShaderFn mShader;
+        float mMinZ;
+    };
+
+    struct TileBin
+    {
+        ArenaVector<uint32_t> mOpaque;
+        ArenaVector<uint32_t> mTransparent;
+        // sizes the frame before ended with, reserved up front in the next one
+        size_t mLastOpaque = 0;
+        size_t mLastTransparent = 0;
+    };
+
+    // radix sort buffers of the draw path
+    struct DepthSortScratch
+    {
+        std::vector<uint32_t> mKeys;
+        std::vector<uint32_t> mValues;
+        std::vector<uint32_t> mKeysTemp;
+        std::vector<uint32_t> mValuesTemp;
+
+        void Resize(size_t count);
+        // sorts mValues by mKeys
+        void Sort();
+    };
+
+    struct TileRect
+    {
+        int x0, y0, x1, y1; // [x0, x1) x [y0, y1)
+    };
+
+    // meshlets the previous frame's depth rejected, Flush() tests them again
+    struct OccludedDraw
+    {
+        MeshView mMesh;
+        glm::mat4 mMvp;
+        Color mColor;
+        ShaderFn mShader;
+        uint32_t mFirstCluster; // into mOccludedClusters
+        uint32_t mClusterCount;
+    };
+
+    RenderTarget* mCanvas;
+    int mWidth;
+    int mHeight;
+    int mTileSize = DEFAULT_TILE_SIZE;
+    int mTilesX;
+    int mTilesY;
+    Triangle* currentTriangle = nullptr;
+    float* zDepthBuffer;
+    std::vector<uint8_t> mColorBuffer;
+    std::function<Color(const Triangle*, const glm::vec3)> mColorCb;
+
+    BlendMode mBlendMode = BlendMode::Opaque;
+    ShaderFn mShader = ShaderFunction;
+    WeightedBlendedOit mOit;
+    unsigned mThreadCount;
+    // mThreadCount - 1 workers, started once; the drawing thread is slot 0
+    std::unique_ptr<JobSystem> mJobs;
+    bool mPinWorkers = false;
+    // everything drawn since Clear() lives here, one per job system slot
+    FrameArena mFrameArena;
+    ArenaVector<BinnedTriangle> mTriangles;
+    size_t mLastTriangleCount = 0;
+    std::vector<TileBin> mBins;
+    size_t mDepthSortThreshold = DEFAULT_DEPTH_SORT_THRESHOLD;
+    float mLodErrorThreshold = DEFAULT_LOD_ERROR_THRESHOLD;
+    DepthSortScratch mDrawSortScratch;
+
+    // clip space positions of the mesh being instanced, reused between draws
+    std::vector<float> mTransformedX;
+    std::vector<float> mTransformedY;
+    std::vector<float> mTransformedZ;
+    std::vector<uint32_t> mDecodedIndices;
+    bool mReportedMalformed = false; // printed once, then only counted
+
+    uint32_t mClusterCulling = CULL_ALL;
+    ClusterStats mClusterStats;
+    DepthPyramid mDepthPyramid;
+    const RenderTarget* mPyramidCanvas = nullptr; // the canvas mDepthPyramid was built for
+    bool mPyramidWanted = false; // meshlets were drawn with the occlusion test since Clear()
+    ArenaVector<OccludedDraw> mOccludedDraws;
+    ArenaVector<uint32_t> mOccludedClusters;
+
+    PipelineStats mFrameStats; // of the drawing thread since Clear()
+    std::vector<PipelineStats> mWorkerStats; // of each raster worker since Clear()
+    PipelineStats mLastStats;
+    std::vector<uint32_t> mVisibleClusters;
+
+    // counters of the debug view, only sized while it needs them
+    DebugView mDebugView = DebugView::None;
+    std::vector<uint16_t> mDepthTests; // per pixel
+    std::vector<uint16_t> mShadedPixels; // per pixel
+    std::vector<double> mTileMs;
+    uint64_t mTriangleSizes[TRIANGLE_SIZE_BUCKETS] = {};
+    // object space positions of one meshlet, gathered for the transform
+    std::vector<float> mClusterX;
+    std::vector<float> mClusterY;
+    std::vector<float> mClusterZ;
+
+    void DrawSpan(int sx, int sy, int ex, float sz, float ez, Color color, ShaderFn shader, int clipX0, int clipX1, bool transparent, PipelineStats& stats);
+    void RasterizeTriangle(const BinnedTriangle& t, bool transparent, const TileRect& tile, PipelineStats& stats);
+    // with `opaqueOnly` the opaque triangles are rasterized and dropped from the bins,
+    // transparency waits for the final pass
+    void RasterizeTile(int tileIndex, unsigned worker, bool opaqueOnly);
+    void RasterizeTiles(bool opaqueOnly);
+    void StartWorkers();
+    // lays out the tiles for the current size, with empty bins
+    void ResizeTiles();
+    // transforms `count` positions into mTransformed* on all threads
+    void TransformVertices(const glm::mat4& mvp, const float* x, const float* y, const float* z, size_t count);
+    void TransformVertices(const glm::mat4& mvp, const uint16_t* x, const uint16_t* y, const uint16_t* z, size_t count);
+    // drops the previous frame's draws and resets the frame arena
+    void BeginFrame();
+    void ReserveTransformed(size_t vertexCount);
+    // draws the triangles of `mesh` using the already transformed positions
+    void DrawTransformed(const MeshView& mesh, Color color);
+    // culls and draws the meshlets of the full mesh
+    void DrawClusters(const MeshView& mesh, const glm::mat4& mvp, Color color);
+    void DrawCluster(const MeshView& mesh, const Meshlet& meshlet, const glm::mat4& mvp, Color color);
+    void DrawOccludedClusters();
+    void ResetDebugCounters();
+    // replaces the color buffer with the debug view
+    void DrawDebugView();
+
+public:
+    glm::mat4 proj;
+    glm::mat4 invProj;
+
+    float LerpZ(int startY, int endY, int currentY, float startZ, float endZ) {
+        float t = (currentY - startY) / static_cast<float>(endY - startY);
+        return startZ + (endZ - startZ) * t;
+    }
+
+    // true if the pixel passed the depth test
+    bool SetPixel(int x, int y, float zDepth, Color color, ShaderFn shader);
+    bool SetPixel(int x, int y, float zDepth, Color color) { return SetPixel(x, y, zDepth, color, mShader); }
+
+    // depth tested against the opaque surface but not written
+    bool BlendPixel(int x, int y, float zDepth, Color color, ShaderFn shader);
+    bool BlendPixel(int x, int y, float zDepth, Color color) { return BlendPixel(x, y, zDepth, color, mShader); }
+
+    void DrawLine(int sx, int sy, int ex, float sz, float ez, Color color)
+    {
+        DrawSpan(sx, sy, ex, sz, ez, color, mShader, 0, mWidth, false, mFrameStats);
+    }
+
+    void DrawLine(int sx, int sy, int ex, float sz, float ez)
+    {
+        DrawLine(sx, sy, ex, sz, ez, Color::White);
+    }
+
+    inline static int Lerp(const Vector3 A, const Vector3 distance, int y)
+    {
+        int dis = y - A.y;
+        return A.x + (distance.x) * dis / distance.y;
+    }
+
+    Triangle NDCTriangle(const Triangle& tWS) const;
+
+    void SetBlendMode(BlendMode mode) { mBlendMode = mode; }
+    BlendMode GetBlendMode() const { return mBlendMode; }
+
+    // applies to triangles drawn after the call
+    void SetShader(ShaderFn shader) { mShader = shader; }
+    ShaderFn GetShader() const { return mShader; }
+
+    // Size of the frames Flush() presents, CANVAS_WIDTH x CANVAS_HEIGHT until changed.
+    // Resizing drops everything drawn since Clear() and clears the buffers.
+    void Resize(int width, int height);
+    int Width() const { return mWidth; }
+    int Height() const { return mHeight; }
+
+    // Side of the square screen tiles triangles are binned into and rasterized by, at least
+    // MIN_TILE_SIZE. Smaller tiles balance better between threads, larger ones bin each
+    // triangle fewer times. Changing it drops everything drawn since Clear().
+    void SetTileSize(int size);
+    int GetTileSize() const { return mTileSize; }
+
+    // threads the frame is transformed, decoded and rasterized on, the drawing thread
+    // included; defaults to one per core. The workers live until the count changes.
+    void SetThreadCount(unsigned count);
+    unsigned GetThreadCount() const { return mThreadCount; }
+    // binds each worker to a core of its own, see JobSystem::PinWorkers()
+    void SetPinWorkers(bool pinned);
+    bool GetPinWorkers() const { return mPinWorkers; }
+
+    // Flush() presents the frame to this target
+    void SetCanvas(RenderTarget* canvas) { mCanvas = canvas; }
+    RenderTarget* GetCanvas() const { return mCanvas; }
+
+    // color tints the shader output, its alpha is the opacity in BlendMode::WeightedBlended
+    void DrawTriangle(const Triangle& tWS, Color color = Color::White);
+
+    // Draws and tile bins with at least this many opaque triangles are sorted front-to-back
+    // by their nearest vertex, so the depth test rejects hidden pixels before shading them.
+    // 0 disables sorting.
+    void SetDepthSortThreshold(size_t threshold) { mDepthSortThreshold = threshold; }
+    size_t GetDepthSortThreshold() const { return mDepthSortThreshold; }
+
+    // Meshes with levels of detail are drawn at the coarsest level whose error projects to
+    // at most this many pixels. 0 always draws the full mesh.
+    void SetLodErrorThreshold(float pixels) { mLodErrorThreshold = pixels; }
+    float GetLodErrorThreshold() const { return mLodErrorThreshold; }
+    size_t SelectLevel(const MeshView& mesh, const glm::mat4& mvp) const;
+
+    // Meshes with meshlets are culled per meshlet before their vertices are transformed,
+    // by these CULL_ flags:
+    //  - frustum: the meshlet's bounding sphere is outside the view
+    //  - backface: its normal cone faces away from the viewer. Assumes closed meshes with
+    //    counter-clockwise front faces, like OBJ files have
+    //  - occlusion: its bounding sphere is behind the previous frame's depth. Flush() tests
+    //    those meshlets again once everything else is rasterized, so what the old depth
+    //    wrongly hides still shows up in the same frame
+    // Transparent draws are only frustum culled.
+    void SetClusterCulling(uint32_t flags) { mClusterCulling = flags; }
+    uint32_t GetClusterCulling() const { return mClusterCulling; }
+    const ClusterStats& GetClusterStats() const { return mClusterStats; }
+
+    // counters and stage times of the frame last flushed, all workers added up
+    const PipelineStats& GetPipelineStats() const { return mLastStats; }
+
+    // Flush() presents a visualization instead of the image:
+    //  - Overdraw: depth tests per pixel, passed or not
+    //  - ShadedPixels: shader runs per pixel, transparent layers included
+    //  - TileTime: how long each tile took to rasterize, relative to the slowest
+    //  - TriangleSizes: histogram of the screen area of the binned triangles
+    // The counters behind a view are only kept while it is on.
+    void SetDebugView(DebugView view);
+    DebugView GetDebugView() const { return mDebugView; }
+    static const char* DebugViewName(DebugView view);
+
+    // Draws `count` copies of `mesh`, each transformed by proj * mModel and tinted by mColor.
+    // Instances whose bounding sphere is outside the view are skipped before any vertex work,
+    // the others are drawn at the level SelectLevel() picks. The data `mesh` points to has
+    // to stay alive until Flush().
+    void DrawInstanced(const MeshView& mesh, const InstanceData* instances, size_t count);
+    void DrawInstanced(const Mesh& mesh, const InstanceData* instances, size_t count) { DrawInstanced(mesh.View(), instances, count); }
+    // Indices are decoded once per call, positions are dequantized inside the vertex transform.
+    void DrawInstanced(const CompressedMeshView& mesh, const InstanceData* instances, size_t count);
+
+    // Rasterizes everything drawn since Clear() and presents the result to the canvas.
+    void Flush();
+
+    void Clear();
+
+    Rasterizer(
+        RenderTarget* canvas,
+        std::function<Color(const Triangle*, const glm::vec3)> colorCb = [](const Triangle*, const glm::vec3){ return Color::Green; },
+        bool useDebugColors = false
+       );
+    ~Rasterizer();
+};
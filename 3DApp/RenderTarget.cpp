@@ -0,0 +1,85 @@
+#include "RenderTarget.h"
+#include <fstream>
+#include <iostream>
+
+void ImageTarget::Present(const uint8_t* rgba, int width, int height)
+{
+    mPixels.assign(rgba, rgba + static_cast<size_t>(width) * height * 4);
+    mWidth = width;
+    mHeight = height;
+}
+
+Color ImageTarget::GetPixel(int x, int y) const
+{
+    const uint8_t* pixel = &mPixels[(static_cast<size_t>(y) * mWidth + x) * 4];
+    return Color(pixel[0], pixel[1], pixel[2], pixel[3]);
+}
+
+bool ImageTarget::SavePpm(const std::string& path) const
+{
+    std::ofstream file(path, std::ios::binary);
+    if (!file)
+    {
+        std::cerr << "ImageTarget: " << path << ": cannot open for writing" << std::endl;
+        return false;
+    }
+    file << "P6\n" << mWidth << " " << mHeight << "\n255\n";
+    std::vector<uint8_t> row(static_cast<size_t>(mWidth) * 3);
+    for (int y = 0; y < mHeight; y++)
+    {
+        for (int x = 0; x < mWidth; x++)
+        {
+            const uint8_t* pixel = &mPixels[(static_cast<size_t>(y) * mWidth + x) * 4];
+            row[x * 3 + 0] = pixel[0];
+            row[x * 3 + 1] = pixel[1];
+            row[x * 3 + 2] = pixel[2];
+        }
+        file.write(reinterpret_cast<const char*>(row.data()), row.size());
+    }
+    if (!file)
+    {
+        std::cerr << "ImageTarget: " << path << ": write failed" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool ImageTarget::LoadPpm(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+    {
+        std::cerr << "ImageTarget: " << path << ": cannot open" << std::endl;
+        return false;
+    }
+    std::string magic;
+    int width = 0;
+    int height = 0;
+    int maxValue = 0;
+    file >> magic >> width >> height >> maxValue;
+    if (magic != "P6" || width <= 0 || height <= 0 || maxValue != 255)
+    {
+        std::cerr << "ImageTarget: " << path << ": not an 8 bit binary PPM" << std::endl;
+        return false;
+    }
+    file.get(); // the single whitespace before the pixels
+
+    std::vector<uint8_t> rgb(static_cast<size_t>(width) * height * 3);
+    file.read(reinterpret_cast<char*>(rgb.data()), rgb.size());
+    if (!file)
+    {
+        std::cerr << "ImageTarget: " << path << ": truncated" << std::endl;
+        return false;
+    }
+    mPixels.resize(static_cast<size_t>(width) * height * 4);
+    for (size_t i = 0; i < static_cast<size_t>(width) * height; i++)
+    {
+        mPixels[i * 4 + 0] = rgb[i * 3 + 0];
+        mPixels[i * 4 + 1] = rgb[i * 3 + 1];
+        mPixels[i * 4 + 2] = rgb[i * 3 + 2];
+        mPixels[i * 4 + 3] = 255;
+    }
+    mWidth = width;
+    mHeight = height;
+    return true;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <cstdint>
+#include "Color.h"
+
+// Where Rasterizer::Flush() puts a finished frame. Front-ends implement it to show the
+// pixels in a window; ImageTarget just keeps them, for rendering without a display.
+class RenderTarget
+{
+public:
+    virtual ~RenderTarget() = default;
+
+    // `rgba` is width * height RGBA pixels, rows top to bottom, only valid during the call
+    virtual void Present(const uint8_t* rgba, int width, int height) = 0;
+};
+
+// Headless target: copies every presented frame into memory.
+class ImageTarget : public RenderTarget
+{
+private:
+    std::vector<uint8_t> mPixels;
+    int mWidth = 0;
+    int mHeight = 0;
+
+public:
+    void Present(const uint8_t* rgba, int width, int height) override;
+
+    // empty until the first Present()
+    const uint8_t* Pixels() const { return mPixels.data(); }
+    int Width() const { return mWidth; }
+    int Height() const { return mHeight; }
+    Color GetPixel(int x, int y) const;
+
+    // binary PPM, alpha is dropped
+    bool SavePpm(const std::string& path) const;
+    // binary PPM with 8 bit channels, like SavePpm() writes; alpha becomes opaque
+    bool LoadPpm(const std::string& path);
+};
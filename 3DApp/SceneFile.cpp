@@ -0,0 +1,219 @@
+#include "SceneFile.h"
+#include "MeshFile.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "Meshlets.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+namespace
+{
+    const uint32_t UNUSED = 0xffffffffu;
+
+    bool Fail(const std::string& path, const char* reason)
+    {
+        std::cerr << "SceneFile: " << path << ": " << reason << std::endl;
+        return false;
+    }
+
+    using Range = std::pair<size_t, size_t>;
+
+    // median splits of triangles[begin, end) along the longest axis of the centroids
+    void Partition(std::vector<uint32_t>& triangles, const std::vector<glm::vec3>& centroids,
+        size_t begin, size_t end, size_t limit, std::vector<Range>& chunks)
+    {
+        if (end - begin <= limit)
+        {
+            chunks.push_back(Range(begin, end));
+            return;
+        }
+
+        glm::vec3 lo = centroids[triangles[begin]];
+        glm::vec3 hi = lo;
+        for (size_t i = begin + 1; i < end; i++)
+        {
+            lo = glm::min(lo, centroids[triangles[i]]);
+            hi = glm::max(hi, centroids[triangles[i]]);
+        }
+        const glm::vec3 extent = hi - lo;
+        const int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+
+        const size_t mid = begin + (end - begin) / 2;
+        std::nth_element(triangles.begin() + begin, triangles.begin() + mid, triangles.begin() + end,
+            [&](uint32_t a, uint32_t b) { return centroids[a][axis] < centroids[b][axis]; });
+        Partition(triangles, centroids, begin, mid, limit, chunks);
+        Partition(triangles, centroids, mid, end, limit, chunks);
+    }
+
+    // the triangles as a mesh of their own with just the vertices they use; `remap` has
+    // one UNUSED entry per source vertex and is left that way
+    Mesh ExtractChunk(const Mesh& mesh, const uint32_t* triangles, size_t count, std::vector<uint32_t>& remap)
+    {
+        Mesh chunk;
+        std::vector<uint32_t> used;
+        chunk.mIndices.reserve(count * 3);
+        for (size_t t = 0; t < count; t++)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                const uint32_t v = mesh.mIndices[triangles[t] * 3 + k];
+                if (remap[v] == UNUSED)
+                {
+                    remap[v] = static_cast<uint32_t>(used.size());
+                    used.push_back(v);
+                }
+                chunk.mIndices.push_back(remap[v]);
+            }
+        }
+
+        auto gather = [&](const std::vector<float>& source, std::vector<float>& target) {
+            if (source.empty())
+                return;
+            target.resize(used.size());
+            for (size_t i = 0; i < used.size(); i++)
+                target[i] = source[used[i]];
+        };
+        gather(mesh.mX, chunk.mX);
+        gather(mesh.mY, chunk.mY);
+        gather(mesh.mZ, chunk.mZ);
+        gather(mesh.mNX, chunk.mNX);
+        gather(mesh.mNY, chunk.mNY);
+        gather(mesh.mNZ, chunk.mNZ);
+        for (uint32_t v : used)
+            remap[v] = UNUSED;
+        chunk.ComputeBounds();
+        return chunk;
+    }
+
+    // BuildLodChain puts the coarsest level's vertices first, so it's a prefix
+    Mesh CoarsestLevel(const Mesh& chunk)
+    {
+        Mesh coarse;
+        if (chunk.mLods.empty())
+        {
+            coarse.mX = chunk.mX;
+            coarse.mY = chunk.mY;
+            coarse.mZ = chunk.mZ;
+            coarse.mNX = chunk.mNX;
+            coarse.mNY = chunk.mNY;
+            coarse.mNZ = chunk.mNZ;
+            coarse.mIndices = chunk.mIndices;
+            coarse.ComputeBounds();
+            return coarse;
+        }
+
+        const MeshLod& lod = chunk.mLods.back();
+        auto prefix = [&](const std::vector<float>& source, std::vector<float>& target) {
+            if (!source.empty())
+                target.assign(source.begin(), source.begin() + lod.mVertexCount);
+        };
+        prefix(chunk.mX, coarse.mX);
+        prefix(chunk.mY, coarse.mY);
+        prefix(chunk.mZ, coarse.mZ);
+        prefix(chunk.mNX, coarse.mNX);
+        prefix(chunk.mNY, coarse.mNY);
+        prefix(chunk.mNZ, coarse.mNZ);
+        const auto first = chunk.mLodIndices.begin() + lod.mFirstIndex;
+        coarse.mIndices.assign(first, first + lod.mIndexCount);
+        coarse.ComputeBounds();
+        return coarse;
+    }
+
+    void PadToAlignment(std::ostream& out)
+    {
+        const char padding[MESH_FILE_ALIGNMENT] = {};
+        const uint64_t position = static_cast<uint64_t>(out.tellp());
+        const uint64_t remainder = position % MESH_FILE_ALIGNMENT;
+        if (remainder != 0)
+            out.write(padding, static_cast<std::streamsize>(MESH_FILE_ALIGNMENT - remainder));
+    }
+}
+
+bool WriteSceneFile(const std::string& path, const Mesh& mesh, size_t chunkTriangles)
+{
+    const size_t triangleCount = mesh.TriangleCount();
+    if (triangleCount == 0)
+        return Fail(path, "empty mesh");
+
+    std::vector<uint32_t> triangles(triangleCount);
+    std::vector<glm::vec3> centroids(triangleCount);
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        triangles[t] = static_cast<uint32_t>(t);
+        centroids[t] = (mesh.Position(mesh.mIndices[t * 3]) + mesh.Position(mesh.mIndices[t * 3 + 1]) + mesh.Position(mesh.mIndices[t * 3 + 2])) / 3.0f;
+    }
+    std::vector<Range> ranges;
+    Partition(triangles, centroids, 0, triangleCount, std::max<size_t>(chunkTriangles, 1), ranges);
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out)
+        return Fail(path, "can't open for writing");
+
+    SceneFileHeader header = {};
+    std::memcpy(header.mMagic, SCENE_FILE_MAGIC, sizeof(SCENE_FILE_MAGIC));
+    header.mVersion = SCENE_FILE_VERSION;
+    header.mChunkCount = static_cast<uint32_t>(ranges.size());
+    std::vector<SceneChunk> chunks(ranges.size());
+    // placeholders, rewritten once the offsets are known
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(chunks.data()), static_cast<std::streamsize>(chunks.size() * sizeof(SceneChunk)));
+
+    std::ostringstream coarseImages(std::ios::binary);
+    std::vector<uint32_t> remap(mesh.VertexCount(), UNUSED);
+    Aabb sceneAabb;
+    for (size_t c = 0; c < ranges.size(); c++)
+    {
+        Mesh chunk = ExtractChunk(mesh, &triangles[ranges[c].first], ranges[c].second - ranges[c].first, remap);
+        OptimizeMesh(chunk);
+        BuildLodChain(chunk);
+        BuildMeshlets(chunk);
+
+        SceneChunk& entry = chunks[c];
+        for (int i = 0; i < 3; i++)
+        {
+            entry.mSphereCenter[i] = chunk.mBounds.mCenter[i];
+            entry.mAabbMin[i] = chunk.mAabb.mMin[i];
+            entry.mAabbMax[i] = chunk.mAabb.mMax[i];
+        }
+        entry.mSphereRadius = chunk.mBounds.mRadius;
+        sceneAabb.mMin = c == 0 ? chunk.mAabb.mMin : glm::min(sceneAabb.mMin, chunk.mAabb.mMin);
+        sceneAabb.mMax = c == 0 ? chunk.mAabb.mMax : glm::max(sceneAabb.mMax, chunk.mAabb.mMax);
+
+        PadToAlignment(out);
+        entry.mOffset = static_cast<uint64_t>(out.tellp());
+        if (!WriteMeshFile(out, chunk))
+            return Fail(path, "write failed");
+        entry.mSize = static_cast<uint64_t>(out.tellp()) - entry.mOffset;
+
+        // relative to the coarse block for now
+        PadToAlignment(coarseImages);
+        entry.mCoarseOffset = static_cast<uint64_t>(coarseImages.tellp());
+        WriteMeshFile(coarseImages, CoarsestLevel(chunk));
+        entry.mCoarseSize = static_cast<uint64_t>(coarseImages.tellp()) - entry.mCoarseOffset;
+    }
+
+    PadToAlignment(out);
+    const std::string coarse = coarseImages.str();
+    header.mCoarseOffset = static_cast<uint64_t>(out.tellp());
+    header.mCoarseSize = coarse.size();
+    out.write(coarse.data(), static_cast<std::streamsize>(coarse.size()));
+    for (SceneChunk& entry : chunks)
+        entry.mCoarseOffset += header.mCoarseOffset;
+    for (int i = 0; i < 3; i++)
+    {
+        header.mAabbMin[i] = sceneAabb.mMin[i];
+        header.mAabbMax[i] = sceneAabb.mMax[i];
+    }
+
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(chunks.data()), static_cast<std::streamsize>(chunks.size() * sizeof(SceneChunk)));
+    if (!out)
+        return Fail(path, "write failed");
+    return true;
+}
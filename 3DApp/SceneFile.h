@@ -0,0 +1,52 @@
+#pragma once
+#include <string>
+#include <cstddef>
+#include <cstdint>
+#include "Mesh.h"
+
+// Chunked scene (.r3ds) for meshes too large to keep in memory. The triangles are split
+// into spatially compact chunks, each stored as a complete .r3dm image plus a much
+// coarser .r3dm image of the same chunk. Layout, little endian:
+//   SceneFileHeader
+//   SceneChunk[mChunkCount]
+//   full chunk images
+//   coarse chunk images, contiguous so a reader can load all of them in one read
+// Every image starts on a MESH_FILE_ALIGNMENT boundary and has its section offsets
+// relative to its own start, so it can be read into a buffer and opened with
+// MeshFile::OpenMemory().
+constexpr char SCENE_FILE_MAGIC[4] = { 'R', '3', 'D', 'S' };
+constexpr uint32_t SCENE_FILE_VERSION = 1;
+constexpr size_t SCENE_CHUNK_TRIANGLES = 1 << 16;
+
+struct SceneFileHeader
+{
+    char mMagic[4];
+    uint32_t mVersion;
+    uint32_t mChunkCount;
+    uint32_t mReserved;
+    uint64_t mCoarseOffset; // the coarse images, from the start of the file
+    uint64_t mCoarseSize;
+    float mAabbMin[3];
+    float mAabbMax[3];
+};
+
+struct SceneChunk
+{
+    float mSphereCenter[3];
+    float mSphereRadius;
+    float mAabbMin[3];
+    float mAabbMax[3];
+    uint64_t mOffset; // full image, from the start of the file
+    uint64_t mSize;
+    uint64_t mCoarseOffset;
+    uint64_t mCoarseSize;
+};
+
+static_assert(sizeof(SceneFileHeader) == 56, "SceneFileHeader layout is part of the file format");
+static_assert(sizeof(SceneChunk) == 72, "SceneChunk layout is part of the file format");
+
+// Splits `mesh` at the median of its triangle centroids along the longest axis until
+// chunks have at most `chunkTriangles` triangles. Every chunk is optimized and gets
+// levels of detail and meshlets; its coarsest level becomes the coarse image.
+// The whole mesh is processed in memory, only reading the scene back is out of core.
+bool WriteSceneFile(const std::string& path, const Mesh& mesh, size_t chunkTriangles = SCENE_CHUNK_TRIANGLES);
@@ -0,0 +1,283 @@
+#include "SceneGraph.h"
+#include <algorithm>
+#include <type_traits>
+
+constexpr uint32_t SceneGraph::NONE;
+constexpr uint32_t SceneGraph::DEAD;
+
+SceneNode SceneGraph::CreateNode(SceneNode parent)
+{
+    SceneNode node;
+    if (!mFreeHandles.empty())
+    {
+        node = mFreeHandles.back();
+        mFreeHandles.pop_back();
+    }
+    else
+    {
+        node = static_cast<SceneNode>(mSlotOf.size());
+        mSlotOf.push_back(DEAD);
+        mParentOf.push_back(INVALID_NODE);
+        mDestroyed.push_back(0);
+    }
+
+    // appended for now, Rebuild() moves it next to its siblings
+    const uint32_t slot = static_cast<uint32_t>(mHandle.size());
+    mSlotOf[node] = slot;
+    mParentOf[node] = IsAlive(parent) ? parent : INVALID_NODE;
+    mDestroyed[node] = 0;
+    mHandle.push_back(node);
+    mParent.push_back(mParentOf[node] != INVALID_NODE ? mSlotOf[parent] : NONE);
+    mFirstChild.push_back(0);
+    mChildCount.push_back(0);
+    mPosition.push_back(glm::vec3(0.0f));
+    mRotation.push_back(glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
+    mScale.push_back(glm::vec3(1.0f));
+    mLocalBounds.push_back(BoundingSphere());
+    mWorld.push_back(glm::mat4(1.0f));
+    mWorldBounds.push_back(BoundingSphere());
+    mUpdatedPass.push_back(0);
+    mQueued.push_back(0);
+    mStructureChanged = true;
+    return node;
+}
+
+void SceneGraph::DestroyNode(SceneNode node)
+{
+    if (!IsAlive(node))
+        return;
+    // the subtree hangs off a destroyed node, so Rebuild() doesn't reach it
+    mDestroyed[node] = 1;
+    mStructureChanged = true;
+}
+
+bool SceneGraph::SetParent(SceneNode node, SceneNode parent)
+{
+    if (!IsAlive(node))
+        return false;
+    if (parent != INVALID_NODE)
+    {
+        if (!IsAlive(parent))
+            return false;
+        for (SceneNode n = parent; n != INVALID_NODE; n = mParentOf[n])
+        {
+            if (n == node)
+                return false;
+        }
+    }
+    if (mParentOf[node] != parent)
+    {
+        mParentOf[node] = parent;
+        mStructureChanged = true;
+    }
+    return true;
+}
+
+void SceneGraph::SetTransform(SceneNode node, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale)
+{
+    const uint32_t slot = mSlotOf[node];
+    mPosition[slot] = position;
+    mRotation[slot] = rotation;
+    mScale[slot] = scale;
+    MarkDirty(slot);
+}
+
+void SceneGraph::SetPosition(SceneNode node, const glm::vec3& position)
+{
+    const uint32_t slot = mSlotOf[node];
+    mPosition[slot] = position;
+    MarkDirty(slot);
+}
+
+void SceneGraph::SetRotation(SceneNode node, const glm::quat& rotation)
+{
+    const uint32_t slot = mSlotOf[node];
+    mRotation[slot] = rotation;
+    MarkDirty(slot);
+}
+
+void SceneGraph::SetScale(SceneNode node, const glm::vec3& scale)
+{
+    const uint32_t slot = mSlotOf[node];
+    mScale[slot] = scale;
+    MarkDirty(slot);
+}
+
+void SceneGraph::SetLocalBounds(SceneNode node, const BoundingSphere& bounds)
+{
+    const uint32_t slot = mSlotOf[node];
+    mLocalBounds[slot] = bounds;
+    MarkDirty(slot);
+}
+
+void SceneGraph::MarkDirty(uint32_t slot)
+{
+    if (mQueued[slot])
+        return;
+    mQueued[slot] = 1;
+    mDirty.push_back(slot);
+}
+
+void SceneGraph::Rebuild()
+{
+    const size_t handleCount = mSlotOf.size();
+
+    // children of every handle by counting sort, roots in the extra bucket at the end
+    std::vector<uint32_t> childStart(handleCount + 2, 0);
+    auto bucket = [&](SceneNode node) { return mParentOf[node] == INVALID_NODE ? handleCount : mParentOf[node]; };
+    for (size_t node = 0; node < handleCount; node++)
+    {
+        if (mSlotOf[node] != DEAD)
+            childStart[bucket(static_cast<SceneNode>(node)) + 1]++;
+    }
+    for (size_t i = 1; i < childStart.size(); i++)
+        childStart[i] += childStart[i - 1];
+    std::vector<SceneNode> children(childStart.back());
+    std::vector<uint32_t> fill(childStart.begin(), childStart.end() - 1);
+    for (size_t node = 0; node < handleCount; node++)
+    {
+        if (mSlotOf[node] != DEAD)
+            children[fill[bucket(static_cast<SceneNode>(node))]++] = static_cast<SceneNode>(node);
+    }
+
+    // breadth first from the live roots; whatever isn't reached was destroyed
+    std::vector<SceneNode> order;
+    std::vector<uint32_t> firstChild, childCount;
+    order.reserve(mHandle.size());
+    auto visit = [&](size_t parentBucket) {
+        const size_t first = order.size();
+        for (uint32_t i = childStart[parentBucket]; i < childStart[parentBucket + 1]; i++)
+        {
+            if (!mDestroyed[children[i]])
+                order.push_back(children[i]);
+        }
+        return static_cast<uint32_t>(order.size() - first);
+    };
+    visit(handleCount);
+    firstChild.resize(order.size());
+    childCount.resize(order.size());
+    for (size_t i = 0; i < order.size(); i++)
+    {
+        firstChild[i] = static_cast<uint32_t>(order.size());
+        const uint32_t count = visit(order[i]);
+        firstChild.resize(order.size());
+        childCount.resize(order.size());
+        childCount[i] = count;
+    }
+
+    std::vector<uint32_t> oldSlot(order.size());
+    for (size_t i = 0; i < order.size(); i++)
+        oldSlot[i] = mSlotOf[order[i]];
+    auto permute = [&](auto& values) {
+        std::remove_reference_t<decltype(values)> sorted(order.size());
+        for (size_t i = 0; i < order.size(); i++)
+            sorted[i] = values[oldSlot[i]];
+        values.swap(sorted);
+    };
+    permute(mPosition);
+    permute(mRotation);
+    permute(mScale);
+    permute(mLocalBounds);
+
+    for (SceneNode node : mHandle)
+        mSlotOf[node] = DEAD;
+    for (size_t i = 0; i < order.size(); i++)
+        mSlotOf[order[i]] = static_cast<uint32_t>(i);
+    for (SceneNode node : mHandle)
+    {
+        if (mSlotOf[node] == DEAD)
+        {
+            mParentOf[node] = INVALID_NODE;
+            mDestroyed[node] = 0;
+            mFreeHandles.push_back(node);
+        }
+    }
+
+    mHandle.swap(order);
+    mFirstChild.swap(firstChild);
+    mChildCount.swap(childCount);
+    mParent.resize(mHandle.size());
+    for (size_t i = 0; i < mHandle.size(); i++)
+        mParent[i] = mParentOf[mHandle[i]] == INVALID_NODE ? NONE : mSlotOf[mParentOf[mHandle[i]]];
+    mWorld.resize(mHandle.size());
+    mWorldBounds.resize(mHandle.size());
+    mUpdatedPass.assign(mHandle.size(), 0);
+    mQueued.assign(mHandle.size(), 0);
+    mPass = 0;
+    mStructureChanged = false;
+}
+
+void SceneGraph::UpdateNode(uint32_t slot)
+{
+    glm::mat4 local = glm::mat4_cast(mRotation[slot]);
+    local[0] *= mScale[slot].x;
+    local[1] *= mScale[slot].y;
+    local[2] *= mScale[slot].z;
+    local[3] = glm::vec4(mPosition[slot], 1.0f);
+    const glm::mat4& world = mWorld[slot] = mParent[slot] == NONE ? local : mWorld[mParent[slot]] * local;
+
+    // a sphere stays a sphere only up to the largest axis scale
+    const BoundingSphere& bounds = mLocalBounds[slot];
+    const float scale = glm::sqrt(std::max(std::max(glm::dot(glm::vec3(world[0]), glm::vec3(world[0])),
+        glm::dot(glm::vec3(world[1]), glm::vec3(world[1]))), glm::dot(glm::vec3(world[2]), glm::vec3(world[2]))));
+    mWorldBounds[slot].mCenter = glm::vec3(world * glm::vec4(bounds.mCenter, 1.0f));
+    mWorldBounds[slot].mRadius = bounds.mRadius * scale;
+    mUpdatedPass[slot] = mPass;
+    mUpdatedCount++;
+}
+
+void SceneGraph::UpdateSubtree(uint32_t slot)
+{
+    UpdateNode(slot);
+    // the children of a contiguous range are contiguous too, so each level is one range
+    uint32_t begin = mFirstChild[slot];
+    uint32_t end = begin + mChildCount[slot];
+    while (begin < end)
+    {
+        for (uint32_t i = begin; i < end; i++)
+            UpdateNode(i);
+        // children always follow their parents, so the next level starts at or after `end`
+        uint32_t next = end;
+        uint32_t last = end;
+        for (uint32_t i = begin; i < end; i++)
+        {
+            if (mChildCount[i] != 0)
+            {
+                if (last == end)
+                    next = mFirstChild[i];
+                last = mFirstChild[i] + mChildCount[i];
+            }
+        }
+        begin = next;
+        end = last;
+    }
+}
+
+void SceneGraph::Update()
+{
+    mUpdatedCount = 0;
+    if (mStructureChanged)
+    {
+        Rebuild();
+        mDirty.clear();
+        mPass++;
+        // breadth first order, parents are always done before their children
+        for (uint32_t slot = 0; slot < mHandle.size(); slot++)
+            UpdateNode(slot);
+        return;
+    }
+    if (mDirty.empty())
+        return;
+
+    // parents come before children, so a queued node inside an already updated subtree
+    // is skipped
+    std::sort(mDirty.begin(), mDirty.end());
+    mPass++;
+    for (uint32_t slot : mDirty)
+    {
+        mQueued[slot] = 0;
+        if (mUpdatedPass[slot] != mPass)
+            UpdateSubtree(slot);
+    }
+    mDirty.clear();
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include "glm/glm.hpp"
+#include "glm/gtc/quaternion.hpp"
+#include "Mesh.h"
+
+// Handle of a scene graph node. Handles of destroyed nodes are reused.
+using SceneNode = uint32_t;
+constexpr SceneNode INVALID_NODE = 0xffffffffu;
+
+// Transform hierarchy. Node data lives in SoA arrays in breadth-first order: sorted by
+// depth, and the children of a node are contiguous, so Update() reaches a node's
+// subtree range by range without chasing pointers. Setting a transform queues the
+// node; Update() recomputes world matrices and world bounds of queued subtrees only,
+// so a static scene costs nothing per frame. Creating, destroying and reparenting
+// nodes re-sorts the arrays on the next Update().
+class SceneGraph
+{
+public:
+    SceneNode CreateNode(SceneNode parent = INVALID_NODE);
+    // destroys the whole subtree; its handles are only reused after the next Update()
+    void DestroyNode(SceneNode node);
+    // false, and nothing changes, if `parent` is inside the node's subtree
+    bool SetParent(SceneNode node, SceneNode parent);
+    SceneNode Parent(SceneNode node) const { return mParentOf[node]; }
+    bool IsAlive(SceneNode node) const { return node < mSlotOf.size() && mSlotOf[node] != DEAD && !mDestroyed[node]; }
+
+    // local transform, applied as translate * rotate * scale
+    void SetTransform(SceneNode node, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale);
+    void SetPosition(SceneNode node, const glm::vec3& position);
+    void SetRotation(SceneNode node, const glm::quat& rotation);
+    void SetScale(SceneNode node, const glm::vec3& scale);
+    const glm::vec3& Position(SceneNode node) const { return mPosition[mSlotOf[node]]; }
+    const glm::quat& Rotation(SceneNode node) const { return mRotation[mSlotOf[node]]; }
+    const glm::vec3& Scale(SceneNode node) const { return mScale[mSlotOf[node]]; }
+    // object space bounds of what the node draws, a zero radius for nothing
+    void SetLocalBounds(SceneNode node, const BoundingSphere& bounds);
+
+    void Update();
+
+    // valid after Update()
+    const glm::mat4& WorldMatrix(SceneNode node) const { return mWorld[mSlotOf[node]]; }
+    const BoundingSphere& WorldBounds(SceneNode node) const { return mWorldBounds[mSlotOf[node]]; }
+
+    // nodes in array order, also valid after Update()
+    size_t NodeCount() const { return mHandle.size(); }
+    SceneNode NodeAt(size_t slot) const { return mHandle[slot]; }
+    const glm::mat4* WorldMatrices() const { return mWorld.data(); }
+    const BoundingSphere* WorldBoundsArray() const { return mWorldBounds.data(); }
+
+    // nodes whose world transform the last Update() recomputed
+    size_t UpdatedCount() const { return mUpdatedCount; }
+
+private:
+    static constexpr uint32_t NONE = 0xffffffffu;
+    static constexpr uint32_t DEAD = 0xfffffffeu;
+
+    // by handle
+    std::vector<uint32_t> mSlotOf; // DEAD for free handles
+    std::vector<SceneNode> mParentOf;
+    std::vector<uint8_t> mDestroyed; // freed, with its subtree, by the next Update()
+    std::vector<SceneNode> mFreeHandles;
+
+    // by slot
+    std::vector<SceneNode> mHandle;
+    std::vector<uint32_t> mParent; // slot, NONE for roots
+    std::vector<uint32_t> mFirstChild;
+    std::vector<uint32_t> mChildCount;
+    std::vector<glm::vec3> mPosition;
+    std::vector<glm::quat> mRotation;
+    std::vector<glm::vec3> mScale;
+    std::vector<BoundingSphere> mLocalBounds;
+    std::vector<glm::mat4> mWorld;
+    std::vector<BoundingSphere> mWorldBounds;
+    std::vector<uint32_t> mUpdatedPass;
+    std::vector<uint8_t> mQueued;
+
+    std::vector<uint32_t> mDirty; // slots whose subtree needs an update
+    uint32_t mPass = 0;
+    size_t mUpdatedCount = 0;
+    bool mStructureChanged = false;
+
+    void MarkDirty(uint32_t slot);
+    void Rebuild();
+    void UpdateNode(uint32_t slot);
+    void UpdateSubtree(uint32_t slot);
+};
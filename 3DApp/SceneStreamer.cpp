@@ -0,0 +1,324 @@
+#include "SceneStreamer.h"
+#include "CommandBuffer.h"
+#include "Frustum.h"
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace
+{
+    bool Fail(const std::string& path, const char* reason)
+    {
+        std::cerr << "SceneStreamer: " << path << ": " << reason << std::endl;
+        return false;
+    }
+
+    // distance to the nearest triangle the ray hits from either side, negative for none
+    float RaycastMesh(const MeshView& mesh, const glm::vec3& origin, const glm::vec3& direction)
+    {
+        float nearest = -1.0f;
+        for (size_t t = 0; t < mesh.TriangleCount(); t++)
+        {
+            const uint32_t i0 = mesh.Index(t * 3), i1 = mesh.Index(t * 3 + 1), i2 = mesh.Index(t * 3 + 2);
+            const glm::vec3 p0(mesh.mX[i0], mesh.mY[i0], mesh.mZ[i0]);
+            const glm::vec3 e1 = glm::vec3(mesh.mX[i1], mesh.mY[i1], mesh.mZ[i1]) - p0;
+            const glm::vec3 e2 = glm::vec3(mesh.mX[i2], mesh.mY[i2], mesh.mZ[i2]) - p0;
+            const glm::vec3 p = glm::cross(direction, e2);
+            const float det = glm::dot(e1, p);
+            if (glm::abs(det) < 1e-12f)
+                continue;
+            const float inverse = 1.0f / det;
+            const glm::vec3 s = origin - p0;
+            const float u = glm::dot(s, p) * inverse;
+            if (u < 0.0f || u > 1.0f)
+                continue;
+            const glm::vec3 q = glm::cross(s, e1);
+            const float v = glm::dot(direction, q) * inverse;
+            if (v < 0.0f || u + v > 1.0f)
+                continue;
+            const float distance = glm::dot(e2, q) * inverse;
+            if (distance >= 0.0f && (nearest < 0.0f || distance < nearest))
+                nearest = distance;
+        }
+        return nearest;
+    }
+}
+
+SceneStreamer::~SceneStreamer()
+{
+    Close();
+}
+
+bool SceneStreamer::Open(const std::string& path, uint64_t memoryBudget)
+{
+    Close();
+
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file)
+        return Fail(path, "can't open the file");
+    const uint64_t fileSize = static_cast<uint64_t>(file.tellg());
+    file.seekg(0);
+
+    SceneFileHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+        return Fail(path, "truncated header");
+    if (std::memcmp(header.mMagic, SCENE_FILE_MAGIC, sizeof(SCENE_FILE_MAGIC)) != 0)
+        return Fail(path, "not a scene file");
+    if (header.mVersion != SCENE_FILE_VERSION)
+        return Fail(path, "unsupported version");
+    if (sizeof(SceneFileHeader) + static_cast<uint64_t>(header.mChunkCount) * sizeof(SceneChunk) > fileSize)
+        return Fail(path, "truncated chunk table");
+    if (header.mCoarseOffset % MESH_FILE_ALIGNMENT != 0 || header.mCoarseOffset > fileSize || header.mCoarseSize > fileSize - header.mCoarseOffset)
+        return Fail(path, "coarse chunks out of bounds");
+
+    std::vector<SceneChunk> entries(header.mChunkCount);
+    if (!file.read(reinterpret_cast<char*>(entries.data()), static_cast<std::streamsize>(entries.size() * sizeof(SceneChunk))))
+        return Fail(path, "truncated chunk table");
+    for (const SceneChunk& entry : entries)
+    {
+        if (entry.mOffset % MESH_FILE_ALIGNMENT != 0 || entry.mOffset > fileSize || entry.mSize > fileSize - entry.mOffset)
+            return Fail(path, "chunk out of bounds");
+        if (entry.mCoarseOffset < header.mCoarseOffset || entry.mCoarseOffset % MESH_FILE_ALIGNMENT != 0
+            || entry.mCoarseOffset - header.mCoarseOffset > header.mCoarseSize
+            || entry.mCoarseSize > header.mCoarseSize - (entry.mCoarseOffset - header.mCoarseOffset))
+            return Fail(path, "coarse chunk out of bounds");
+    }
+
+    // every coarse chunk in one read, they stay resident
+    mCoarseData.reset(new unsigned char[static_cast<size_t>(header.mCoarseSize)]);
+    file.seekg(static_cast<std::streamoff>(header.mCoarseOffset));
+    if (!file.read(reinterpret_cast<char*>(mCoarseData.get()), static_cast<std::streamsize>(header.mCoarseSize)))
+    {
+        mCoarseData.reset();
+        return Fail(path, "can't read the coarse chunks");
+    }
+
+    mChunks.resize(entries.size());
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        Chunk& chunk = mChunks[i];
+        chunk.mEntry = entries[i];
+        chunk.mBounds.mCenter = glm::vec3(entries[i].mSphereCenter[0], entries[i].mSphereCenter[1], entries[i].mSphereCenter[2]);
+        chunk.mBounds.mRadius = entries[i].mSphereRadius;
+        const unsigned char* image = mCoarseData.get() + (entries[i].mCoarseOffset - header.mCoarseOffset);
+        if (!chunk.mCoarse.OpenMemory(image, static_cast<size_t>(entries[i].mCoarseSize), path + " (coarse chunk)"))
+        {
+            Close();
+            return Fail(path, "bad coarse chunk");
+        }
+    }
+
+    std::vector<Aabb> boxes(entries.size());
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        boxes[i].mMin = glm::vec3(entries[i].mAabbMin[0], entries[i].mAabbMin[1], entries[i].mAabbMin[2]);
+        boxes[i].mMax = glm::vec3(entries[i].mAabbMax[0], entries[i].mAabbMax[1], entries[i].mAabbMax[2]);
+    }
+    mChunkBvh.Build(boxes.data(), boxes.size());
+
+    mPath = path;
+    mHeader = header;
+    mMemoryBudget = memoryBudget;
+    mStop = false;
+    mIoThread = std::thread(&SceneStreamer::IoThread, this);
+    return true;
+}
+
+void SceneStreamer::Close()
+{
+    if (mIoThread.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mStop = true;
+        }
+        mWake.notify_one();
+        mIoThread.join();
+    }
+    mRequests.clear();
+    mLoaded.clear();
+    mChunks.clear();
+    mChunkBvh.Clear();
+    mCoarseData.reset();
+    mHeader = SceneFileHeader();
+    mResidentBytes = 0;
+    mQueuedBytes = 0;
+    mResidentCount = 0;
+    mFrame = 0;
+}
+
+void SceneStreamer::IoThread()
+{
+    // only this thread reads from here on, the render thread just swaps the queues
+    std::ifstream file(mPath, std::ios::binary);
+    for (;;)
+    {
+        uint32_t index;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mWake.wait(lock, [this] { return mStop || !mRequests.empty(); });
+            if (mStop)
+                return;
+            index = mRequests.back();
+            mRequests.pop_back();
+        }
+
+        const SceneChunk& entry = mChunks[index].mEntry;
+        std::unique_ptr<unsigned char[]> data(new unsigned char[static_cast<size_t>(entry.mSize)]);
+        file.clear();
+        file.seekg(static_cast<std::streamoff>(entry.mOffset));
+        if (!file.read(reinterpret_cast<char*>(data.get()), static_cast<std::streamsize>(entry.mSize)))
+            data.reset();
+
+        std::lock_guard<std::mutex> lock(mMutex);
+        mLoaded.push_back({ index, std::move(data) });
+    }
+}
+
+void SceneStreamer::Evict(Chunk& chunk)
+{
+    chunk.mFull.Close();
+    chunk.mData.reset();
+    chunk.mState = ChunkState::Coarse;
+    mResidentBytes -= chunk.mEntry.mSize;
+    mResidentCount--;
+}
+
+void SceneStreamer::Update(const glm::vec3& cameraPosition, const glm::mat4& viewProjection)
+{
+    if (mChunks.empty())
+        return;
+    mFrame++;
+
+    std::vector<LoadedChunk> loaded;
+    std::vector<uint32_t> unstarted;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        loaded.swap(mLoaded);
+        unstarted.swap(mRequests);
+    }
+
+    // requests the thread didn't get to are prioritized again below
+    for (uint32_t index : unstarted)
+    {
+        mChunks[index].mState = ChunkState::Coarse;
+        mQueuedBytes -= mChunks[index].mEntry.mSize;
+    }
+    for (LoadedChunk& result : loaded)
+    {
+        Chunk& chunk = mChunks[result.mChunk];
+        mQueuedBytes -= chunk.mEntry.mSize;
+        if (!result.mData)
+        {
+            Fail(mPath, "can't read a chunk, it stays coarse");
+            chunk.mState = ChunkState::Failed;
+        }
+        else if (!chunk.mFull.OpenMemory(result.mData.get(), static_cast<size_t>(chunk.mEntry.mSize), mPath + " (chunk)"))
+        {
+            chunk.mState = ChunkState::Failed;
+        }
+        else
+        {
+            chunk.mData = std::move(result.mData);
+            chunk.mState = ChunkState::Resident;
+            mResidentBytes += chunk.mEntry.mSize;
+            mResidentCount++;
+        }
+    }
+
+    // visible chunks first, nearest first within both groups
+    mVisible.clear();
+    mChunkBvh.QueryFrustum(Frustum::FromMatrix(viewProjection), mVisible);
+    std::vector<bool> visible(mChunks.size(), false);
+    for (uint32_t index : mVisible)
+    {
+        visible[index] = true;
+        mChunks[index].mLastVisible = mFrame;
+    }
+    std::vector<float> distance(mChunks.size());
+    mOrder.resize(mChunks.size());
+    for (size_t i = 0; i < mChunks.size(); i++)
+    {
+        const Chunk& chunk = mChunks[i];
+        distance[i] = std::max(glm::length(chunk.mBounds.mCenter - cameraPosition) - chunk.mBounds.mRadius, 0.0f);
+        mOrder[i] = static_cast<uint32_t>(i);
+    }
+    std::sort(mOrder.begin(), mOrder.end(), [&](uint32_t a, uint32_t b) {
+        if (visible[a] != visible[b])
+            return static_cast<bool>(visible[a]);
+        return distance[a] < distance[b];
+    });
+
+    // the chunks that fit the budget in that order should be resident
+    std::vector<bool> wanted(mChunks.size(), false);
+    uint64_t wantedBytes = 0;
+    for (uint32_t index : mOrder)
+    {
+        const Chunk& chunk = mChunks[index];
+        if (chunk.mState == ChunkState::Failed)
+            continue;
+        if (wantedBytes + chunk.mEntry.mSize > mMemoryBudget)
+            break;
+        wantedBytes += chunk.mEntry.mSize;
+        wanted[index] = true;
+    }
+
+    // make room by evicting what was visible longest ago
+    std::vector<uint32_t> evictable;
+    for (size_t i = 0; i < mChunks.size(); i++)
+    {
+        if (mChunks[i].mState == ChunkState::Resident && !wanted[i])
+            evictable.push_back(static_cast<uint32_t>(i));
+    }
+    std::sort(evictable.begin(), evictable.end(), [&](uint32_t a, uint32_t b) { return mChunks[a].mLastVisible < mChunks[b].mLastVisible; });
+
+    std::vector<uint32_t> requests;
+    size_t nextEviction = 0;
+    for (uint32_t index : mOrder)
+    {
+        Chunk& chunk = mChunks[index];
+        if (!wanted[index] || chunk.mState != ChunkState::Coarse)
+            continue;
+        while (mResidentBytes + mQueuedBytes + chunk.mEntry.mSize > mMemoryBudget && nextEviction < evictable.size())
+            Evict(mChunks[evictable[nextEviction++]]);
+        if (mResidentBytes + mQueuedBytes + chunk.mEntry.mSize > mMemoryBudget)
+            break;
+        chunk.mState = ChunkState::Queued;
+        mQueuedBytes += chunk.mEntry.mSize;
+        requests.push_back(index);
+    }
+
+    if (!requests.empty())
+    {
+        std::reverse(requests.begin(), requests.end());
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mRequests.swap(requests);
+        }
+        mWake.notify_one();
+    }
+}
+
+const MeshView& SceneStreamer::ChunkView(size_t chunk) const
+{
+    const Chunk& c = mChunks[chunk];
+    return c.mState == ChunkState::Resident ? c.mFull.View() : c.mCoarse.View();
+}
+
+uint32_t SceneStreamer::Pick(const glm::vec3& origin, const glm::vec3& direction, float* distance) const
+{
+    return mChunkBvh.Raycast(origin, direction, FLT_MAX, distance, [&](uint32_t chunk, float) {
+        return RaycastMesh(ChunkView(chunk), origin, direction);
+    });
+}
+
+void SceneStreamer::Draw(CommandBuffer& commands, const glm::mat4& model, Color color) const
+{
+    for (size_t i = 0; i < mChunks.size(); i++)
+    {
+        commands.BindMesh(ChunkView(i));
+        commands.Draw(model, color);
+    }
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include "glm/glm.hpp"
+#include "MeshFile.h"
+#include "SceneFile.h"
+#include "Bvh.h"
+#include "Color.h"
+
+class CommandBuffer;
+
+// Streams the chunks of a .r3ds scene in and out of memory. The coarse version of every
+// chunk is loaded by Open() and stays resident; full chunks are read by a background
+// I/O thread, nearest visible ones first, and the least recently visible ones are
+// evicted to stay under the memory budget. Chunks that aren't loaded yet are drawn
+// coarse, so the render loop never waits for the disk.
+class SceneStreamer
+{
+public:
+    SceneStreamer() = default;
+    SceneStreamer(const SceneStreamer&) = delete;
+    SceneStreamer& operator=(const SceneStreamer&) = delete;
+    ~SceneStreamer();
+
+    // `memoryBudget` bounds the bytes of full chunks held at once, loaded or being loaded.
+    bool Open(const std::string& path, uint64_t memoryBudget);
+    void Close();
+
+    // Once per frame, outside of any draw/Flush() pair since it may free chunks that were
+    // drawn before: takes finished loads, evicts and queues new loads for the camera, in
+    // scene space. `viewProjection` maps scene space to clip space, chunks it sees are
+    // loaded first and count as used.
+    void Update(const glm::vec3& cameraPosition, const glm::mat4& viewProjection);
+
+    // Binds and draws every chunk with `model`, at full detail where it's resident.
+    void Draw(CommandBuffer& commands, const glm::mat4& model, Color color = Color::White) const;
+
+    size_t ChunkCount() const { return mChunks.size(); }
+    size_t ResidentCount() const { return mResidentCount; }
+    uint64_t ResidentBytes() const { return mResidentBytes; }
+    uint64_t MemoryBudget() const { return mMemoryBudget; }
+    const SceneFileHeader& Header() const { return mHeader; }
+    // the full chunk if it's resident, else the coarse one
+    const MeshView& ChunkView(size_t chunk) const;
+    // Chunk with the nearest triangle the ray hits, at the detail it's drawn with, or
+    // INVALID_OBJECT. The ray is in scene space, `distance` in units of `direction`.
+    uint32_t Pick(const glm::vec3& origin, const glm::vec3& direction, float* distance = nullptr) const;
+
+private:
+    enum class ChunkState : uint8_t
+    {
+        Coarse,
+        Queued, // requested, possibly already being read
+        Resident,
+        Failed, // stays coarse
+    };
+
+    struct Chunk
+    {
+        SceneChunk mEntry;
+        BoundingSphere mBounds;
+        MeshFile mCoarse;
+        MeshFile mFull;
+        std::unique_ptr<unsigned char[]> mData; // image of mFull while resident
+        ChunkState mState = ChunkState::Coarse;
+        uint64_t mLastVisible = 0; // frame number, for LRU eviction
+    };
+
+    struct LoadedChunk
+    {
+        uint32_t mChunk;
+        std::unique_ptr<unsigned char[]> mData; // nullptr if the read failed
+    };
+
+    std::string mPath;
+    SceneFileHeader mHeader = {};
+    std::vector<Chunk> mChunks;
+    std::unique_ptr<unsigned char[]> mCoarseData;
+    uint64_t mMemoryBudget = 0;
+    uint64_t mResidentBytes = 0;
+    uint64_t mQueuedBytes = 0;
+    size_t mResidentCount = 0;
+    uint64_t mFrame = 0;
+    Bvh mChunkBvh; // over the chunk boxes, object ids are chunk indices
+    std::vector<uint32_t> mOrder; // Update() scratch
+    std::vector<uint32_t> mVisible;
+
+    // shared with the I/O thread, under mMutex
+    std::mutex mMutex;
+    std::condition_variable mWake;
+    std::vector<uint32_t> mRequests; // highest priority last
+    std::vector<LoadedChunk> mLoaded;
+    bool mStop = false;
+    std::thread mIoThread;
+
+    void IoThread();
+    void Evict(Chunk& chunk);
+};
@@ -0,0 +1,313 @@
+#include "StatsOverlay.h"
+#include <cctype>
+#include <cstring>
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+    constexpr int GLYPH_WIDTH = 5;
+    constexpr int GLYPH_HEIGHT = 7;
+    constexpr int ADVANCE = GLYPH_WIDTH + 1;
+    constexpr int LINE_HEIGHT = GLYPH_HEIGHT + 2;
+
+    const char GLYPH_CHARS[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ.:/%-,()+<";
+    // a row per byte, top first, bit 4 is the leftmost pixel
+    const uint8_t GLYPHS[][GLYPH_HEIGHT] = {
+        { 0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E }, // 0
+        { 0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E }, // 1
+        { 0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F }, // 2
+        { 0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E }, // 3
+        { 0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02 }, // 4
+        { 0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E }, // 5
+        { 0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E }, // 6
+        { 0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08 }, // 7
+        { 0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E }, // 8
+        { 0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C }, // 9
+        { 0x0E, 0x11, 0x11, 0x11, 0x1F, 0x11, 0x11 }, // A
+        { 0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E }, // B
+        { 0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E }, // C
+        { 0x1C, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1C }, // D
+        { 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F }, // E
+        { 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10 }, // F
+        { 0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F }, // G
+        { 0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11 }, // H
+        { 0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E }, // I
+        { 0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C }, // J
+        { 0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11 }, // K
+        { 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F }, // L
+        { 0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11 }, // M
+        { 0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11 }, // N
+        { 0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E }, // O
+        { 0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10 }, // P
+        { 0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D }, // Q
+        { 0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11 }, // R
+        { 0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E }, // S
+        { 0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 }, // T
+        { 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E }, // U
+        { 0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04 }, // V
+        { 0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A }, // W
+        { 0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11 }, // X
+        { 0x11, 0x11, 0x11, 0x0A, 0x04, 0x04, 0x04 }, // Y
+        { 0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F }, // Z
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C }, // .
+        { 0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00 }, // :
+        { 0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00 }, // /
+        { 0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03 }, // %
+        { 0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00 }, // -
+        { 0x00, 0x00, 0x00, 0x00, 0x0C, 0x04, 0x08 }, // ,
+        { 0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02 }, // (
+        { 0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08 }, // )
+        { 0x00, 0x04, 0x04, 0x1F, 0x04, 0x04, 0x00 }, // +
+        { 0x02, 0x04, 0x08, 0x10, 0x08, 0x04, 0x02 }, // <
+    };
+
+    void SetPixel(uint8_t* rgba, int width, int height, int x, int y, Color color)
+    {
+        if (x < 0 || y < 0 || x >= width || y >= height)
+            return;
+        uint8_t* pixel = &rgba[(static_cast<size_t>(y) * width + x) * 4];
+        pixel[0] = color.r;
+        pixel[1] = color.g;
+        pixel[2] = color.b;
+        pixel[3] = 255;
+    }
+
+    // darkens the rectangle to a third, clipped to the image
+    void DarkenRect(uint8_t* rgba, int width, int height, int x0, int y0, int x1, int y1)
+    {
+        for (int y = std::max(y0, 0); y < std::min(y1, height); y++)
+        {
+            for (int x = std::max(x0, 0); x < std::min(x1, width); x++)
+            {
+                uint8_t* pixel = &rgba[(static_cast<size_t>(y) * width + x) * 4];
+                pixel[0] /= 3;
+                pixel[1] /= 3;
+                pixel[2] /= 3;
+            }
+        }
+    }
+
+    void FillRect(uint8_t* rgba, int width, int height, int x0, int y0, int x1, int y1, Color color)
+    {
+        for (int y = std::max(y0, 0); y < std::min(y1, height); y++)
+        {
+            for (int x = std::max(x0, 0); x < std::min(x1, width); x++)
+                SetPixel(rgba, width, height, x, y, color);
+        }
+    }
+
+    // with a black shadow, readable on any heat color
+    void DrawLabel(uint8_t* rgba, int width, int height, int x, int y, const std::string& text)
+    {
+        DrawText(rgba, width, height, x + 1, y + 1, text, Color::Black);
+        DrawText(rgba, width, height, x, y, text, Color::White);
+    }
+
+    // 0 black, then blue, cyan, green, yellow, red, 1 white
+    Color HeatColor(float t)
+    {
+        static const Color STOPS[] = {
+            Color(0, 0, 0), Color(0, 0, 255), Color(0, 255, 255), Color(0, 255, 0),
+            Color(255, 255, 0), Color(255, 0, 0), Color(255, 255, 255),
+        };
+        const int last = static_cast<int>(sizeof(STOPS) / sizeof(STOPS[0])) - 1;
+        const float position = std::min(std::max(t, 0.0f), 1.0f) * last;
+        const int stop = std::min(static_cast<int>(position), last - 1);
+        const float f = position - stop;
+        const Color& a = STOPS[stop];
+        const Color& b = STOPS[stop + 1];
+        return Color(
+            static_cast<uint8_t>(a.r + (b.r - a.r) * f),
+            static_cast<uint8_t>(a.g + (b.g - a.g) * f),
+            static_cast<uint8_t>(a.b + (b.b - a.b) * f));
+    }
+
+    // logarithmic, counts from HEATMAP_MAX_COUNT up are white
+    Color CountColor(uint32_t count)
+    {
+        return HeatColor(std::log2(count + 1.0f) / std::log2(HEATMAP_MAX_COUNT + 1.0f));
+    }
+
+    // 1234, 12.3K, 1.23M
+    std::string Count(uint64_t value)
+    {
+        char text[32];
+        if (value < 10000)
+            std::snprintf(text, sizeof(text), "%llu", static_cast<unsigned long long>(value));
+        else if (value < 10000000)
+            std::snprintf(text, sizeof(text), "%.1fK", value / 1e3);
+        else
+            std::snprintf(text, sizeof(text), "%.2fM", value / 1e6);
+        return text;
+    }
+
+    std::string Ms(double ms)
+    {
+        char text[32];
+        std::snprintf(text, sizeof(text), "%.2f", ms);
+        return text;
+    }
+}
+
+void DrawText(uint8_t* rgba, int width, int height, int x, int y, const std::string& text, Color color)
+{
+    for (size_t i = 0; i < text.size(); i++)
+    {
+        const char c = static_cast<char>(std::toupper(static_cast<unsigned char>(text[i])));
+        const char* found = c != 0 ? std::strchr(GLYPH_CHARS, c) : nullptr;
+        if (!found)
+            continue;
+        const uint8_t* glyph = GLYPHS[found - GLYPH_CHARS];
+        const int left = x + static_cast<int>(i) * ADVANCE;
+        for (int row = 0; row < GLYPH_HEIGHT; row++)
+        {
+            for (int column = 0; column < GLYPH_WIDTH; column++)
+            {
+                if (glyph[row] & (0x10 >> column))
+                    SetPixel(rgba, width, height, left + column, y + row, color);
+            }
+        }
+    }
+}
+
+void DrawStatsOverlay(uint8_t* rgba, int width, int height, const PipelineStats& stats)
+{
+    const double frameMs = stats.mClearMs + stats.mDrawMs + stats.mRasterMs + stats.mPyramidMs + stats.mPresentMs;
+    const std::vector<std::string> lines = {
+        "tris " + Count(stats.mTrianglesSubmitted) + " binned " + Count(stats.mTrianglesBinned)
+            + " clipped " + Count(stats.mTrianglesClipped) + " tiles " + Count(stats.mTileTriangles),
+        "culled inst " + Count(stats.mTrianglesInstanceCulled) + " frus " + Count(stats.mTrianglesFrustumCulled)
+            + " back " + Count(stats.mTrianglesBackfaceCulled) + " occl " + Count(stats.mTrianglesOcclusionCulled),
+        "       offscreen " + Count(stats.mTrianglesOffscreen) + " degenerate " + Count(stats.mTrianglesDegenerate)
+            + " malformed " + Count(stats.mTrianglesMalformed),
+        "pixels tested " + Count(stats.mPixelsTested) + " passed " + Count(stats.mPixelsPassed)
+            + " shaded " + Count(stats.mPixelsShaded),
+        "       written " + Count(stats.mPixelsWritten) + " blended " + Count(stats.mPixelsBlended),
+        "ms clear " + Ms(stats.mClearMs) + " draw " + Ms(stats.mDrawMs) + " raster " + Ms(stats.mRasterMs),
+        "   pyramid " + Ms(stats.mPyramidMs) + " present " + Ms(stats.mPresentMs) + " total " + Ms(frameMs),
+    };
+
+    size_t longest = 0;
+    for (const std::string& line : lines)
+        longest = std::max(longest, line.size());
+    DarkenRect(rgba, width, height, 0, 0, 4 + static_cast<int>(longest) * ADVANCE, 4 + static_cast<int>(lines.size()) * LINE_HEIGHT);
+    for (size_t i = 0; i < lines.size(); i++)
+        DrawText(rgba, width, height, 3, 3 + static_cast<int>(i) * LINE_HEIGHT, lines[i], Color::White);
+}
+
+void DrawCountHeatmap(uint8_t* rgba, int width, int height, const uint16_t* counts, const std::string& label)
+{
+    for (size_t i = 0; i < static_cast<size_t>(width) * height; i++)
+    {
+        const Color color = CountColor(counts[i]);
+        rgba[i * 4 + 0] = color.r;
+        rgba[i * 4 + 1] = color.g;
+        rgba[i * 4 + 2] = color.b;
+        rgba[i * 4 + 3] = 255;
+    }
+
+    // legend along the bottom: a swatch per power of two
+    const int top = height - LINE_HEIGHT - 3;
+    DarkenRect(rgba, width, height, 0, top - 2, width, height);
+    DrawText(rgba, width, height, 3, top, label, Color::White);
+    int x = 3 + (static_cast<int>(label.size()) + 1) * ADVANCE;
+    for (uint32_t count = 0; count <= HEATMAP_MAX_COUNT; count = count == 0 ? 1 : count * 2)
+    {
+        const std::string text = std::to_string(count) + (count == HEATMAP_MAX_COUNT ? "+" : "");
+        FillRect(rgba, width, height, x, top, x + GLYPH_HEIGHT, top + GLYPH_HEIGHT, CountColor(count));
+        DrawText(rgba, width, height, x + GLYPH_HEIGHT + 2, top, text, Color::White);
+        x += GLYPH_HEIGHT + 2 + (static_cast<int>(text.size()) + 1) * ADVANCE;
+    }
+}
+
+void DrawTileHeatmap(uint8_t* rgba, int width, int height, int tileSize, const double* tileMs)
+{
+    const int tilesX = (width + tileSize - 1) / tileSize;
+    const int tilesY = (height + tileSize - 1) / tileSize;
+    double slowest = 0.0;
+    double total = 0.0;
+    for (int tile = 0; tile < tilesX * tilesY; tile++)
+    {
+        slowest = std::max(slowest, tileMs[tile]);
+        total += tileMs[tile];
+    }
+
+    for (int ty = 0; ty < tilesY; ty++)
+    {
+        for (int tx = 0; tx < tilesX; tx++)
+        {
+            const double ms = tileMs[tx + ty * tilesX];
+            const Color heat = HeatColor(slowest > 0.0 ? static_cast<float>(ms / slowest) : 0.0f);
+            const int x0 = tx * tileSize;
+            const int y0 = ty * tileSize;
+            const int x1 = std::min(x0 + tileSize, width);
+            const int y1 = std::min(y0 + tileSize, height);
+            // the image stays faintly visible under the heat, to see what made a tile slow
+            for (int y = y0; y < y1; y++)
+            {
+                for (int x = x0; x < x1; x++)
+                {
+                    uint8_t* pixel = &rgba[(static_cast<size_t>(y) * width + x) * 4];
+                    const int gray = (pixel[0] + pixel[1] + pixel[2]) / 3;
+                    pixel[0] = static_cast<uint8_t>((heat.r * 3 + gray) / 4);
+                    pixel[1] = static_cast<uint8_t>((heat.g * 3 + gray) / 4);
+                    pixel[2] = static_cast<uint8_t>((heat.b * 3 + gray) / 4);
+                    pixel[3] = 255;
+                }
+            }
+            // tile borders
+            FillRect(rgba, width, height, x0, y0, x1, y0 + 1, Color::Black);
+            FillRect(rgba, width, height, x0, y0, x0 + 1, y1, Color::Black);
+            DrawLabel(rgba, width, height, x0 + 3, y0 + 3, Ms(ms));
+        }
+    }
+
+    const int top = height - LINE_HEIGHT - 3;
+    DarkenRect(rgba, width, height, 0, top - 2, width, height);
+    DrawText(rgba, width, height, 3, top, "tile raster ms, slowest " + Ms(slowest) + " total " + Ms(total), Color::White);
+}
+
+void DrawTriangleSizeHistogram(uint8_t* rgba, int width, int height, const uint64_t* buckets, int bucketCount)
+{
+    uint64_t total = 0;
+    uint64_t largest = 1;
+    for (int i = 0; i < bucketCount; i++)
+    {
+        total += buckets[i];
+        largest = std::max(largest, buckets[i]);
+    }
+
+    DarkenRect(rgba, width, height, 0, 0, width, height);
+    DrawText(rgba, width, height, 3, 3, "triangle area in pixels, " + Count(total) + " binned", Color::White);
+
+    // a bar per bucket, its share of all triangles on top and its smallest area below
+    const int barWidth = std::max((width - 6) / bucketCount, 1);
+    const int chartTop = 3 + LINE_HEIGHT * 2;
+    const int chartBottom = height - LINE_HEIGHT - 3;
+    for (int i = 0; i < bucketCount; i++)
+    {
+        const int x0 = 3 + i * barWidth;
+        const int barHeight = static_cast<int>((chartBottom - chartTop - LINE_HEIGHT) * buckets[i] / largest);
+        // the smaller the triangles, the hotter: they cost setup and waste pixel work
+        FillRect(rgba, width, height, x0 + 1, chartBottom - barHeight, x0 + barWidth - 1, chartBottom,
+            HeatColor(1.0f - 0.8f * i / std::max(bucketCount - 1, 1)));
+        if (buckets[i] != 0)
+        {
+            const std::string share = std::to_string((buckets[i] * 100 + total / 2) / total) + "%";
+            DrawText(rgba, width, height, x0 + 1, chartBottom - barHeight - LINE_HEIGHT, share, Color::White);
+        }
+
+        std::string area = "<1";
+        if (i > 0)
+        {
+            const uint64_t smallest = uint64_t(1) << (i - 1);
+            area = smallest >= 1024 ? std::to_string(smallest / 1024) + "K" : std::to_string(smallest);
+            if (i == bucketCount - 1)
+                area += "+";
+        }
+        DrawText(rgba, width, height, x0 + 1, chartBottom + 2, area, Color::White);
+    }
+}
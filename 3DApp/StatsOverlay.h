@@ -0,0 +1,27 @@
+#pragma once
+#include <string>
+#include <cstdint>
+#include "Color.h"
+#include "PipelineStats.h"
+
+// Text drawn straight into RGBA pixels with a built-in 5x7 pixel font, so overlays look
+// the same in a window and in headless output. Knows digits, letters (lower case is
+// drawn as upper case) and . : / % - , ( ) + <; anything else is left blank.
+void DrawText(uint8_t* rgba, int width, int height, int x, int y, const std::string& text, Color color);
+
+// The counters and stage times of `stats` on a dark box in the top left corner.
+void DrawStatsOverlay(uint8_t* rgba, int width, int height, const PipelineStats& stats);
+
+// Counts at or above this are drawn in the hottest color of DrawCountHeatmap().
+constexpr uint32_t HEATMAP_MAX_COUNT = 16;
+
+// Replaces the image with one count per pixel on a logarithmic heat scale, from black for
+// none through blue, green, yellow and red to white, with a legend titled `label`.
+void DrawCountHeatmap(uint8_t* rgba, int width, int height, const uint16_t* counts, const std::string& label);
+
+// Tints every tile by its time relative to the slowest one and labels it in ms.
+void DrawTileHeatmap(uint8_t* rgba, int width, int height, int tileSize, const double* tileMs);
+
+// A bar chart of `buckets` over the darkened image: bucket 0 counts triangles under a
+// pixel, bucket i those of 2^(i-1) to 2^i pixels, and the last one everything larger.
+void DrawTriangleSizeHistogram(uint8_t* rgba, int width, int height, const uint64_t* buckets, int bucketCount);
@@ -0,0 +1,173 @@
+#include "Trace.h"
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+    struct Zone
+    {
+        const char* mName;
+        uint64_t mStart;
+        uint64_t mEnd;
+        int32_t mValue;
+    };
+
+    // written only by the thread that holds it, mCount is what makes zones visible to WriteTrace()
+    struct Lane
+    {
+        std::unique_ptr<Zone[]> mZones;
+        std::atomic<uint64_t> mCount{ 0 }; // zones ever recorded, the last TRACE_BUFFER_ZONES are kept
+    };
+
+    struct Registry
+    {
+        std::mutex mMutex;
+        std::vector<std::unique_ptr<Lane>> mLanes;
+        std::vector<uint32_t> mFreeLanes;
+        // where the ticks are converted to microseconds from
+        uint64_t mStartTicks = TraceTicks();
+        std::chrono::steady_clock::time_point mStartTime = std::chrono::steady_clock::now();
+    };
+
+    Registry& GetRegistry()
+    {
+        static Registry registry;
+        return registry;
+    }
+
+    // the lane of the calling thread, given back when the thread exits
+    struct ThreadLane
+    {
+        Lane* mLane = nullptr;
+        uint32_t mIndex = 0;
+
+        ~ThreadLane()
+        {
+            if (!mLane)
+                return;
+            Registry& registry = GetRegistry();
+            std::lock_guard<std::mutex> lock(registry.mMutex);
+            registry.mFreeLanes.push_back(mIndex);
+        }
+
+        Lane& Get()
+        {
+            if (mLane)
+                return *mLane;
+            Registry& registry = GetRegistry();
+            std::lock_guard<std::mutex> lock(registry.mMutex);
+            if (registry.mFreeLanes.empty())
+            {
+                mIndex = static_cast<uint32_t>(registry.mLanes.size());
+                registry.mLanes.emplace_back(new Lane());
+                registry.mLanes.back()->mZones.reset(new Zone[TRACE_BUFFER_ZONES]);
+            }
+            else
+            {
+                // the lowest one, so lanes keep their order when threads come and go
+                auto lowest = std::min_element(registry.mFreeLanes.begin(), registry.mFreeLanes.end());
+                mIndex = *lowest;
+                registry.mFreeLanes.erase(lowest);
+            }
+            mLane = registry.mLanes[mIndex].get();
+            return *mLane;
+        }
+    };
+
+    thread_local ThreadLane tLane;
+
+    double TicksPerMicrosecond(Registry& registry)
+    {
+        // too short a span doesn't tell the counter's rate
+        const auto minimum = std::chrono::milliseconds(10);
+        while (std::chrono::steady_clock::now() - registry.mStartTime < minimum)
+        {
+        }
+        const uint64_t ticks = TraceTicks() - registry.mStartTicks;
+        const double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - registry.mStartTime).count();
+        return ticks / us;
+    }
+}
+
+void TraceRecord(const char* name, uint64_t start, uint64_t end, int32_t value)
+{
+    Lane& lane = tLane.Get();
+    const uint64_t count = lane.mCount.load(std::memory_order_relaxed);
+    lane.mZones[count & (TRACE_BUFFER_ZONES - 1)] = { name, start, end, value };
+    lane.mCount.store(count + 1, std::memory_order_release);
+}
+
+void WriteTrace(std::ostream& out)
+{
+    Registry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mMutex);
+    const double ticksPerUs = TicksPerMicrosecond(registry);
+
+    // zones of each lane, oldest first
+    std::vector<std::pair<const Zone*, uint64_t>> ranges; // first zone, count
+    uint64_t origin = UINT64_MAX;
+    for (const auto& lane : registry.mLanes)
+    {
+        const uint64_t count = lane->mCount.load(std::memory_order_acquire);
+        const uint64_t kept = std::min<uint64_t>(count, TRACE_BUFFER_ZONES);
+        ranges.emplace_back(lane->mZones.get(), count);
+        for (uint64_t i = count - kept; i < count; i++)
+            origin = std::min(origin, lane->mZones[i & (TRACE_BUFFER_ZONES - 1)].mStart);
+    }
+
+    out.setf(std::ios::fixed);
+    out.precision(3);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    for (size_t lane = 0; lane < ranges.size(); lane++)
+    {
+        out << (first ? "\n" : ",\n");
+        first = false;
+        out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << lane
+            << ",\"args\":{\"name\":\"thread " << lane << "\"}}";
+
+        const Zone* zones = ranges[lane].first;
+        const uint64_t count = ranges[lane].second;
+        for (uint64_t i = count - std::min<uint64_t>(count, TRACE_BUFFER_ZONES); i < count; i++)
+        {
+            const Zone& zone = zones[i & (TRACE_BUFFER_ZONES - 1)];
+            out << ",\n{\"name\":\"" << zone.mName << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << lane
+                << ",\"ts\":" << (zone.mStart - origin) / ticksPerUs
+                << ",\"dur\":" << (zone.mEnd - zone.mStart) / ticksPerUs;
+            if (zone.mValue >= 0)
+                out << ",\"args\":{\"value\":" << zone.mValue << "}";
+            out << "}";
+        }
+    }
+    out << "\n]}\n";
+}
+
+bool WriteTrace(const std::string& path)
+{
+    std::ofstream file(path);
+    if (!file)
+    {
+        std::cerr << "Trace: " << path << ": cannot open for writing" << std::endl;
+        return false;
+    }
+    WriteTrace(file);
+    if (!file)
+    {
+        std::cerr << "Trace: " << path << ": write failed" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void ClearTrace()
+{
+    Registry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mMutex);
+    for (const auto& lane : registry.mLanes)
+        lane->mCount.store(0, std::memory_order_relaxed);
+}
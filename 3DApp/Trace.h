@@ -0,0 +1,72 @@
+#pragma once
+#include <string>
+#include <ostream>
+#include <cstdint>
+#include <chrono>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define RASTER_TRACE_TSC
+#elif defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#define RASTER_TRACE_TSC
+#endif
+
+// Timeline of what every thread did, for load imbalance between workers and idle gaps
+// that averaged stage times hide. TRACE_ZONE("name") records the enclosing scope as a zone
+// on the calling thread; each thread writes into its own ring buffer without locks, the
+// oldest zones get overwritten once TRACE_BUFFER_ZONES are recorded. WriteTrace() exports
+// the Chrome trace event format, which about://tracing and ui.perfetto.dev open.
+// Zones are only recorded when RASTER3D_TRACE is defined, otherwise the macros are empty.
+#ifdef RASTER3D_TRACE
+constexpr bool TRACE_ENABLED = true;
+#else
+constexpr bool TRACE_ENABLED = false;
+#endif
+constexpr uint32_t TRACE_BUFFER_ZONES = 1 << 16; // per thread
+
+// the time stamp counter where there is one, nanoseconds otherwise; converted to
+// microseconds on export
+inline uint64_t TraceTicks()
+{
+#ifdef RASTER_TRACE_TSC
+    return __rdtsc();
+#else
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+// `name` has to outlive the export, string literals do; `value` < 0 means none
+void TraceRecord(const char* name, uint64_t start, uint64_t end, int32_t value);
+
+// Only while no thread records, e.g. between frames. Threads show up as lanes: a thread
+// that exits hands its lane to the next new one, so workers restarted for a new thread
+// count keep their place in the timeline.
+void WriteTrace(std::ostream& out);
+bool WriteTrace(const std::string& path);
+void ClearTrace();
+
+class TraceZone
+{
+public:
+    explicit TraceZone(const char* name, int32_t value = -1) : mName(name), mValue(value), mStart(TraceTicks()) {}
+    ~TraceZone() { TraceRecord(mName, mStart, TraceTicks(), mValue); }
+
+    TraceZone(const TraceZone&) = delete;
+    TraceZone& operator=(const TraceZone&) = delete;
+
+private:
+    const char* mName;
+    int32_t mValue;
+    uint64_t mStart;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#ifdef RASTER3D_TRACE
+#define TRACE_ZONE(name) TraceZone TRACE_CONCAT(traceZone, __LINE__)(name)
+#define TRACE_ZONE_VALUE(name, value) TraceZone TRACE_CONCAT(traceZone, __LINE__)(name, static_cast<int32_t>(value))
+#else
+#define TRACE_ZONE(name) ((void)0)
+#define TRACE_ZONE_VALUE(name, value) ((void)0)
+#endif
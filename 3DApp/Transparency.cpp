@@ -0,0 +1,61 @@
+#include "Transparency.h"
+#include <algorithm>
+#include <cmath>
+
+WeightedBlendedOit::WeightedBlendedOit(int width, int height)
+    : mWidth(width),
+      mHeight(height),
+      mAccumR(static_cast<size_t>(width) * height, 0.0f),
+      mAccumG(static_cast<size_t>(width) * height, 0.0f),
+      mAccumB(static_cast<size_t>(width) * height, 0.0f),
+      mAccumA(static_cast<size_t>(width) * height, 0.0f),
+      mRevealage(static_cast<size_t>(width) * height, 1.0f)
+{
+}
+
+float WeightedBlendedOit::Weight(float zDepth, float alpha)
+{
+    // eq. (7) of the paper, nearer fragments get a larger weight
+    const float z = std::fabs(zDepth) / 200.0f;
+    const float w = 0.03f / (1e-5f + z * z * z * z);
+    return alpha * std::min(std::max(w, 1e-2f), 3e3f);
+}
+
+void WeightedBlendedOit::ClearRect(int x0, int y0, int x1, int y1)
+{
+    for (int y = y0; y < y1; y++)
+    {
+        const size_t begin = static_cast<size_t>(x0) + static_cast<size_t>(y) * mWidth;
+        const size_t end = begin + (x1 - x0);
+        std::fill(mAccumR.begin() + begin, mAccumR.begin() + end, 0.0f);
+        std::fill(mAccumG.begin() + begin, mAccumG.begin() + end, 0.0f);
+        std::fill(mAccumB.begin() + begin, mAccumB.begin() + end, 0.0f);
+        std::fill(mAccumA.begin() + begin, mAccumA.begin() + end, 0.0f);
+        std::fill(mRevealage.begin() + begin, mRevealage.begin() + end, 1.0f);
+    }
+}
+
+void WeightedBlendedOit::CompositeRow(int y, int x0, int x1, unsigned char* rgba) const
+{
+    const size_t row = static_cast<size_t>(y) * mWidth;
+    const float* __restrict accumR = mAccumR.data() + row;
+    const float* __restrict accumG = mAccumG.data() + row;
+    const float* __restrict accumB = mAccumB.data() + row;
+    const float* __restrict accumA = mAccumA.data() + row;
+    const float* __restrict revealage = mRevealage.data() + row;
+
+    // branch free so the compiler can vectorize it, untouched pixels have
+    // accum == 0 and revealage == 1 and resolve to the opaque color
+    for (int x = x0; x < x1; x++)
+    {
+        unsigned char* dst = rgba + (x - x0) * 4;
+        const float rev = revealage[x];
+        const float scale = 255.0f * (1.0f - rev) / std::max(accumA[x], 1e-5f);
+        const float r = accumR[x] * scale + dst[0] * rev;
+        const float g = accumG[x] * scale + dst[1] * rev;
+        const float b = accumB[x] * scale + dst[2] * rev;
+        dst[0] = static_cast<unsigned char>(std::min(r + 0.5f, 255.0f));
+        dst[1] = static_cast<unsigned char>(std::min(g + 0.5f, 255.0f));
+        dst[2] = static_cast<unsigned char>(std::min(b + 0.5f, 255.0f));
+    }
+}
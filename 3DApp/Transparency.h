@@ -0,0 +1,46 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+
+// Weighted blended order-independent transparency (McGuire & Bavoil 2013).
+// Transparent fragments are accumulated unsorted into two extra targets:
+//  - accum: weighted, premultiplied rgb and weighted alpha
+//  - revealage: product of (1 - alpha), i.e. how much of the opaque image stays visible
+// A composite pass then resolves them over the opaque color.
+class WeightedBlendedOit
+{
+private:
+    int mWidth;
+    int mHeight;
+    // SoA so the resolve loop runs over contiguous floats
+    std::vector<float> mAccumR;
+    std::vector<float> mAccumG;
+    std::vector<float> mAccumB;
+    std::vector<float> mAccumA;
+    std::vector<float> mRevealage;
+
+public:
+    WeightedBlendedOit(int width, int height);
+
+    static float Weight(float zDepth, float alpha);
+
+    // Resets the accumulation targets of the rectangle [x0, x1) x [y0, y1).
+    void ClearRect(int x0, int y0, int x1, int y1);
+
+    // r, g, b, alpha in [0, 1], not premultiplied.
+    void Accumulate(int x, int y, float zDepth, float r, float g, float b, float alpha)
+    {
+        const size_t i = static_cast<size_t>(x) + static_cast<size_t>(y) * mWidth;
+        const float w = Weight(zDepth, alpha);
+        const float aw = alpha * w;
+        mAccumR[i] += r * aw;
+        mAccumG[i] += g * aw;
+        mAccumB[i] += b * aw;
+        mAccumA[i] += aw;
+        mRevealage[i] *= 1.0f - alpha;
+    }
+
+    // Resolves one row segment [x0, x1) of the accumulation targets over the opaque
+    // colors in `rgba` (8 bit RGBA, one entry per pixel of the segment), in place.
+    void CompositeRow(int y, int x0, int x1, unsigned char* rgba) const;
+};
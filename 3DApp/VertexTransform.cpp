@@ -0,0 +1,66 @@
+#include "VertexTransform.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RASTER_USE_SSE 1
+#include <emmintrin.h>
+#endif
+
+void TransformPositions(
+    const glm::mat4& m,
+    const float* x, const float* y, const float* z,
+    size_t count,
+    float* outX, float* outY, float* outZ)
+{
+    size_t i = 0;
+#ifdef RASTER_USE_SSE
+    const __m128 m00 = _mm_set1_ps(m[0][0]), m10 = _mm_set1_ps(m[1][0]), m20 = _mm_set1_ps(m[2][0]), m30 = _mm_set1_ps(m[3][0]);
+    const __m128 m01 = _mm_set1_ps(m[0][1]), m11 = _mm_set1_ps(m[1][1]), m21 = _mm_set1_ps(m[2][1]), m31 = _mm_set1_ps(m[3][1]);
+    const __m128 m02 = _mm_set1_ps(m[0][2]), m12 = _mm_set1_ps(m[1][2]), m22 = _mm_set1_ps(m[2][2]), m32 = _mm_set1_ps(m[3][2]);
+    for (; i + 4 <= count; i += 4)
+    {
+        const __m128 px = _mm_loadu_ps(x + i);
+        const __m128 py = _mm_loadu_ps(y + i);
+        const __m128 pz = _mm_loadu_ps(z + i);
+        _mm_storeu_ps(outX + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(m00, px), _mm_mul_ps(m10, py)), _mm_add_ps(_mm_mul_ps(m20, pz), m30)));
+        _mm_storeu_ps(outY + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(m01, px), _mm_mul_ps(m11, py)), _mm_add_ps(_mm_mul_ps(m21, pz), m31)));
+        _mm_storeu_ps(outZ + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(m02, px), _mm_mul_ps(m12, py)), _mm_add_ps(_mm_mul_ps(m22, pz), m32)));
+    }
+#endif
+    for (; i < count; i++)
+    {
+        outX[i] = (m[0][0] * x[i] + m[1][0] * y[i]) + (m[2][0] * z[i] + m[3][0]);
+        outY[i] = (m[0][1] * x[i] + m[1][1] * y[i]) + (m[2][1] * z[i] + m[3][1]);
+        outZ[i] = (m[0][2] * x[i] + m[1][2] * y[i]) + (m[2][2] * z[i] + m[3][2]);
+    }
+}
+
+void TransformQuantizedPositions(
+    const glm::mat4& m,
+    const uint16_t* x, const uint16_t* y, const uint16_t* z,
+    size_t count,
+    float* outX, float* outY, float* outZ)
+{
+    size_t i = 0;
+#ifdef RASTER_USE_SSE
+    const __m128 m00 = _mm_set1_ps(m[0][0]), m10 = _mm_set1_ps(m[1][0]), m20 = _mm_set1_ps(m[2][0]), m30 = _mm_set1_ps(m[3][0]);
+    const __m128 m01 = _mm_set1_ps(m[0][1]), m11 = _mm_set1_ps(m[1][1]), m21 = _mm_set1_ps(m[2][1]), m31 = _mm_set1_ps(m[3][1]);
+    const __m128 m02 = _mm_set1_ps(m[0][2]), m12 = _mm_set1_ps(m[1][2]), m22 = _mm_set1_ps(m[2][2]), m32 = _mm_set1_ps(m[3][2]);
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 4 <= count; i += 4)
+    {
+        const __m128 px = _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(x + i)), zero));
+        const __m128 py = _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(y + i)), zero));
+        const __m128 pz = _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(z + i)), zero));
+        _mm_storeu_ps(outX + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(m00, px), _mm_mul_ps(m10, py)), _mm_add_ps(_mm_mul_ps(m20, pz), m30)));
+        _mm_storeu_ps(outY + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(m01, px), _mm_mul_ps(m11, py)), _mm_add_ps(_mm_mul_ps(m21, pz), m31)));
+        _mm_storeu_ps(outZ + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(m02, px), _mm_mul_ps(m12, py)), _mm_add_ps(_mm_mul_ps(m22, pz), m32)));
+    }
+#endif
+    for (; i < count; i++)
+    {
+        const float px = x[i], py = y[i], pz = z[i];
+        outX[i] = (m[0][0] * px + m[1][0] * py) + (m[2][0] * pz + m[3][0]);
+        outY[i] = (m[0][1] * px + m[1][1] * py) + (m[2][1] * pz + m[3][1]);
+        outZ[i] = (m[0][2] * px + m[1][2] * py) + (m[2][2] * pz + m[3][2]);
+    }
+}
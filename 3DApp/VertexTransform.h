@@ -0,0 +1,20 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "glm/glm.hpp"
+
+// out = (m * vec4(p, 1)).xyz for `count` SoA positions, four at a time where SSE is available.
+// w is dropped to match what DrawTriangle expects.
+void TransformPositions(
+    const glm::mat4& m,
+    const float* x, const float* y, const float* z,
+    size_t count,
+    float* outX, float* outY, float* outZ);
+
+// Same for 16 bit quantized positions, converted on the fly. Fold the dequantization
+// into `m` (m * CompressedMeshView::Dequantize()) so decode and transform is one pass.
+void TransformQuantizedPositions(
+    const glm::mat4& m,
+    const uint16_t* x, const uint16_t* y, const uint16_t* z,
+    size_t count,
+    float* outX, float* outY, float* outZ);
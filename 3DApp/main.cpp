@@ -1,235 +1,145 @@
 #include <SFML/Graphics.hpp>
 #include <SFML/Graphics/Transform.hpp>
 #include <iostream>
+#include <fstream>
 #include <algorithm>
 #include <functional>
 #include "glm/glm.hpp"
 #include "glm/gtc/matrix_transform.hpp"
 #include "glm/gtc/type_ptr.hpp"
-#include <algorithm>
-
-constexpr int CANVAS_WIDTH = 400;
-constexpr int CANVAS_HEIGHT = 300;
-
-using Vector3 = glm::vec3;
-
-struct Triangle {
-    Triangle(Vector3 p1, Vector3 p2, Vector3 p3)
-        : mP1(p1), mP2(p2), mP3(p3)
-    {
-    }
-    Vector3 mP1;
-    Vector3 mP2;
-    Vector3 mP3;
-};
-
-sf::Color ShaderFunction(int x, int y, float depth, const glm::mat4& invProj)
-{
-    float ndcX = (2.0f * x) / CANVAS_WIDTH + 0.5f;
-    float ndcY = (2.0f * y) / CANVAS_HEIGHT + 0.5f;
-
-    glm::vec4 clipSpacePos(ndcX, ndcY, depth, 1.0f);
-    glm::vec4 worldPos = invProj * clipSpacePos;
-
-    sf::Uint8 red = static_cast<sf::Uint8>(glm::clamp(((worldPos.x) * 255.0f), 0.0f, 255.0f));
-    sf::Uint8 green = static_cast<sf::Uint8>(glm::clamp(((worldPos.y) * 255.0f), 0.0f, 255.0f));
-    sf::Uint8 blue = static_cast<sf::Uint8>(glm::clamp(((worldPos.z) * 255.0f), 0.0f, 255.0f));
-
-    return sf::Color(red, green, blue);
-}
-
-class Rasterizer
+#include "Rasterizer.h"
+#include "CommandBuffer.h"
+#include "MeshFile.h"
+#include "ObjImporter.h"
+#include "MeshSimplifier.h"
+#include "Meshlets.h"
+#include "SceneStreamer.h"
+#include "SceneGraph.h"
+#include "Frustum.h"
+#include "RenderTarget.h"
+#include "StatsOverlay.h"
+#include "Trace.h"
+#include "FrameCapture.h"
+#include "AutoTune.h"
+
+// uploads every flushed frame to the texture the window shows
+class TextureTarget : public RenderTarget
 {
-private:
-    sf::Image* mCanvas;
-    Triangle* currentTriangle = nullptr;
-    float* zDepthBuffer;
-    std::function<sf::Color(const Triangle*, const glm::vec3)> mColorCb;
-
 public:
-    glm::mat4 proj;
-    glm::mat4 invProj;
-
-    float LerpZ(int startY, int endY, int currentY, float startZ, float endZ) {
-        float t = (currentY - startY) / static_cast<float>(endY - startY);
-        return startZ + (endZ - startZ) * t;
-    }
+    sf::Texture mTexture;
+    // drawn over the frame if set; Present() runs inside Flush(), so these are the
+    // previous frame's
+    const PipelineStats* mOverlayStats = nullptr;
 
-    void SetPixel(int x, int y, float zDepth, sf::Color color)
+    void Present(const uint8_t* rgba, int width, int height) override
     {
-        if (zDepthBuffer[x + y * CANVAS_WIDTH] > zDepth)
+        if (mTexture.getSize() != sf::Vector2u(width, height))
+            mTexture.create(width, height);
+        if (mOverlayStats)
         {
-            zDepthBuffer[x + y * CANVAS_WIDTH] = zDepth;
-            sf::Color computedColor = ShaderFunction(x, y, zDepth, invProj);
-            mCanvas->setPixel(x, y, computedColor);
-        }
-    }
-
-    void DrawLine(int sx, int sy, int ex, float sz, float ez, sf::Color color)
-    {
-        if (sy < 0 || sy >= CANVAS_HEIGHT) return;
-
-        sx = std::max(0, std::min(sx, CANVAS_WIDTH - 1));
-        ex = std::max(0, std::min(ex, CANVAS_WIDTH - 1));
-
-        if (sx > ex) {
-            std::swap(sx, ex);
-            std::swap(sz, ez);
-        }
-
-        for (int cx = sx; cx <= ex; ++cx) {
-            float z = LerpZ(sx, ex, cx, sz, ez);
-            SetPixel(cx, sy, z, sf::Color::White); 
+            mOverlayPixels.assign(rgba, rgba + static_cast<size_t>(width) * height * 4);
+            DrawStatsOverlay(mOverlayPixels.data(), width, height, *mOverlayStats);
+            rgba = mOverlayPixels.data();
         }
+        mTexture.update(rgba);
     }
 
-    void DrawLine(int sx, int sy, int ex, float sz, float ez)
-    {
-        DrawLine(sx, sy, ex, sz, ez, sf::Color::Red);
-    }
+private:
+    std::vector<uint8_t> mOverlayPixels;
+};
 
-    inline static int Lerp(const Vector3 A, const Vector3 distance, int y)
-    {
-        int dis = y - A.y;
-        return A.x + (distance.x) * dis / distance.y;
-    }
+int main(int argc, char** argv)
+{
+    //set framerate limit
+    sf::RenderWindow window(sf::VideoMode(CANVAS_WIDTH, CANVAS_HEIGHT), "Basic renderer test");
+    TextureTarget canvas;
+    sf::Sprite mySprite;
+    Rasterizer rast(&canvas, [&](const Triangle* triangle, glm::vec3 pos) {
+        return Color::Red;
+    });
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)CANVAS_WIDTH / (float)CANVAS_HEIGHT, 0.1f, 100.0f);;
+    rast.proj = projection;
+    rast.invProj = glm::inverse(projection);
+    // measured once per machine, then read from the cache
+    TuneSettings tuned = AutoTune(rast);
+    std::cout << "Tile size " << tuned.mTileSize << ", " << tuned.mThreadCount << " threads" << std::endl;
 
-    Triangle NDCTriangle(Triangle tWS)
-    {
-        Vector3 ndcA = Vector3(
-            static_cast<int>((tWS.mP1.x + 1.0f) * 0.5f * CANVAS_WIDTH),
-            static_cast<int>((tWS.mP1.y + 1.0f) * 0.5f * CANVAS_HEIGHT),
-            tWS.mP1.z
-        );
-        Vector3 ndcB = Vector3(
-            static_cast<int>((tWS.mP2.x + 1.0f) * 0.5f * CANVAS_WIDTH),
-            static_cast<int>((tWS.mP2.y + 1.0f) * 0.5f * CANVAS_HEIGHT),
-            tWS.mP2.z
-        );
-        Vector3 ndcC = Vector3(
-            static_cast<int>((tWS.mP3.x + 1.0f) * 0.5f * CANVAS_WIDTH),
-            static_cast<int>((tWS.mP3.y + 1.0f) * 0.5f * CANVAS_HEIGHT),
-            tWS.mP3.z
-        );
-        Triangle tNDC = { ndcA, ndcB, ndcC };
-        return tNDC;
-    }
 
-    void DrawTriangle(Triangle tWS)
+    Cube c;
+    Mesh cubeMesh = Mesh::FromTriangles(c.triangles, 12);
+    CommandBuffer commands;
+
+    // optional .obj, .r3dm or .r3ds file to show instead of the cube, uncompressed .r3dm
+    // is used straight from the mapping and .r3ds is streamed within argv[2] MB
+    MeshFile meshFile;
+    SceneStreamer scene;
+    Mesh loadedMesh;
+    MeshView mesh = cubeMesh.View();
+    if (argc > 1)
     {
-
-        Triangle tNDC = NDCTriangle(tWS);
-        //sort so we got the points on the top, as p1..p2, 
-        if (tNDC.mP2.y > tNDC.mP3.y) std::swap(tNDC.mP2, tNDC.mP3);
-        if (tNDC.mP1.y > tNDC.mP2.y) std::swap(tNDC.mP1, tNDC.mP2);
-        if (tNDC.mP2.y > tNDC.mP3.y) std::swap(tNDC.mP2, tNDC.mP3);
-
-        //longerSide = tNDC.mP1 -> tNDC.mP3;
-        //shorterSide = tNDC.mP1 -> tNDC.mP2;
-        //bottomSide = tNDC.mP2 -> tNDC.mP3;
-        for (int i = tNDC.mP1.y; i < tNDC.mP2.y; i++)
+        const std::string path = argv[1];
+        auto hasExtension = [&](const std::string& extension) {
+            return path.size() > extension.size() && path.compare(path.size() - extension.size(), extension.size(), extension) == 0;
+        };
+        if (hasExtension(".r3ds"))
         {
-            int sx = Lerp(tNDC.mP1, tNDC.mP1 - tNDC.mP3, i);
-            int ex = Lerp(tNDC.mP2, tNDC.mP1 - tNDC.mP2, i);
-            float sz = LerpZ(tNDC.mP1.y, tNDC.mP3.y, i, tNDC.mP1.z, tNDC.mP3.z);
-            float ez = LerpZ(tNDC.mP1.y, tNDC.mP2.y, i, tNDC.mP1.z, tNDC.mP2.z);
-            if (sx > ex)
-            {
-                std::swap(sx, ex);
-                std::swap(sz, ez);
-            }
-            DrawLine(sx, i, ex, sz, ez);
+            const uint64_t budgetMb = argc > 2 ? std::stoull(argv[2]) : 1024;
+            if (!scene.Open(path, budgetMb << 20))
+                return 1;
         }
-        for (int i = tNDC.mP2.y; i < tNDC.mP3.y; i++)
+        else if (hasExtension(".obj"))
         {
-            int sx = Lerp(tNDC.mP1, tNDC.mP1 - tNDC.mP3, i);
-            int ex = Lerp(tNDC.mP2, tNDC.mP2 - tNDC.mP3, i);
-            float sz = LerpZ(tNDC.mP1.y, tNDC.mP3.y, i, tNDC.mP1.z, tNDC.mP3.z);
-            float ez = LerpZ(tNDC.mP2.y, tNDC.mP3.y, i, tNDC.mP2.z, tNDC.mP3.z);
-            if (sx > ex)
+            if (!ImportObj(path, loadedMesh))
+                return 1;
+            BuildLodChain(loadedMesh);
+            BuildMeshlets(loadedMesh);
+            mesh = loadedMesh.View();
+        }
+        else
+        {
+            if (!meshFile.Open(path))
+                return 1;
+            if (meshFile.IsCompressed())
+            {
+                loadedMesh = DecodeMesh(meshFile.CompressedView());
+                BuildMeshlets(loadedMesh);
+                mesh = loadedMesh.View();
+            }
+            else
             {
-                std::swap(sx, ex);
-                std::swap(sz, ez);
+                mesh = meshFile.View();
             }
-            DrawLine(sx, i, ex, sz, ez);
         }
     }
 
-    void Clear()
-    {
-        for (size_t i = 0; i < CANVAS_WIDTH * CANVAS_HEIGHT; i++)
-            zDepthBuffer[i] = 999.0f;
-        mCanvas->create(CANVAS_WIDTH, CANVAS_HEIGHT, sf::Color::Black);
-    }
-
-    Rasterizer(
-        sf::Image* canvas,
-        std::function<sf::Color(const Triangle*, const glm::vec3)> colorCb = [](const Triangle*, const glm::vec3){ return sf::Color::Green; },
-        bool useDebugColors = false
-       ) : 
-        mCanvas(canvas),
-        mColorCb(colorCb)
+    // animated root with the object and its translucent shell under it
+    SceneGraph graph;
+    const SceneNode root = graph.CreateNode();
+    const SceneNode object = graph.CreateNode(root);
+    const SceneNode shell = graph.CreateNode(root);
+    graph.SetScale(shell, glm::vec3(1.6f));
+    if (scene.ChunkCount() != 0)
     {
-        zDepthBuffer = new float[CANVAS_WIDTH * CANVAS_HEIGHT];
+        // scaled to fit like the cube, the camera is at the view space origin
+        const SceneFileHeader& header = scene.Header();
+        const glm::vec3 lo(header.mAabbMin[0], header.mAabbMin[1], header.mAabbMin[2]);
+        const glm::vec3 hi(header.mAabbMax[0], header.mAabbMax[1], header.mAabbMax[2]);
+        const float scale = 1.0f / glm::max(glm::length(hi - lo), 1e-6f);
+        graph.SetTransform(object, -(lo + hi) * 0.5f * scale, glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(scale));
     }
-    ~Rasterizer()
-    {
-        delete zDepthBuffer;
-    }
-};
-
-
-class Cube {
-public:
-    Triangle triangles[12] = {
-        Triangle(glm::vec3(-0.5, -0.5, 0.5), glm::vec3(0.5, -0.5, 0.5), glm::vec3(0.5, 0.5, 0.5)),
-        Triangle(glm::vec3(-0.5, -0.5, 0.5), glm::vec3(-0.5, 0.5, 0.5), glm::vec3(0.5, 0.5, 0.5)),
-
-        // Back face
-        Triangle(glm::vec3(-0.5, -0.5, -0.5), glm::vec3(-0.5, 0.5, -0.5), glm::vec3(0.5, 0.5, -0.5)),
-        Triangle(glm::vec3(-0.5, -0.5, -0.5), glm::vec3(0.5, -0.5, -0.5), glm::vec3(0.5, 0.5, -0.5)),
-
-        // Left face
-        Triangle(glm::vec3(-0.5, -0.5, -0.5), glm::vec3(-0.5, -0.5, 0.5), glm::vec3(-0.5, 0.5, 0.5)),
-        Triangle(glm::vec3(-0.5, -0.5, -0.5), glm::vec3(-0.5, 0.5, -0.5), glm::vec3(-0.5, 0.5, 0.5)),
-
-        // Right face
-        Triangle(glm::vec3(0.5, -0.5, -0.5), glm::vec3(0.5, 0.5, -0.5), glm::vec3(0.5, 0.5, 0.5)),
-        Triangle(glm::vec3(0.5, -0.5, -0.5), glm::vec3(0.5, 0.5, 0.5), glm::vec3(0.5, -0.5, 0.5)),
-
-        // Top face
-        Triangle(glm::vec3(-0.5, 0.5, -0.5), glm::vec3(-0.5, 0.5, 0.5), glm::vec3(0.5, 0.5, 0.5)),
-        Triangle(glm::vec3(-0.5, 0.5, -0.5), glm::vec3(0.5, 0.5, 0.5), glm::vec3(0.5, 0.5, -0.5)),
-
-        // Bottom face
-        Triangle(glm::vec3(-0.5, -0.5, -0.5), glm::vec3(0.5, -0.5, -0.5), glm::vec3(0.5, -0.5, 0.5)),
-        Triangle(glm::vec3(-0.5, -0.5, -0.5), glm::vec3(0.5, -0.5, 0.5), glm::vec3(-0.5, -0.5, 0.5))
-    };
-};
-
-
-int main()
-{
-    //set framerate limit
-    sf::RenderWindow window(sf::VideoMode(CANVAS_WIDTH, CANVAS_HEIGHT), "Basic renderer test");
-    sf::Image canvasBuffer;
-    sf::Texture texture;
-    sf::Sprite mySprite;
-    Rasterizer rast(&canvasBuffer, [&](const Triangle* triangle, glm::vec3 pos) {
-        return sf::Color::Red;
-    });
-    glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)CANVAS_WIDTH / (float)CANVAS_HEIGHT, 0.1f, 100.0f);;
-    rast.proj = projection;
-    rast.invProj = glm::inverse(projection);
-
-
-    Cube c;
     sf::Clock clk;
 
-    canvasBuffer.create(CANVAS_WIDTH, CANVAS_HEIGHT, sf::Color::Black);
-    texture.loadFromImage(canvasBuffer);
+    // S toggles the stats overlay, C starts and stops writing them to stats.csv,
+    // T writes the trace zones of the last frames to trace.json, V cycles the debug views,
+    // F captures the next frame to frame.r3dc for Benchmark --replay, K calibrates the
+    // tile size and thread count again
+    std::ofstream statsCsv;
+    bool captureFrame = false;
+    uint64_t frame = 0;
+
+    canvas.mTexture.create(CANVAS_WIDTH, CANVAS_HEIGHT);
     window.setFramerateLimit(60);
-    mySprite.setTexture(texture);
+    mySprite.setTexture(canvas.mTexture);
 
     while (window.isOpen())
     {
@@ -240,28 +150,97 @@ int main()
             {
                 window.close();
             }
+            else if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::S)
+            {
+                canvas.mOverlayStats = canvas.mOverlayStats ? nullptr : &rast.GetPipelineStats();
+            }
+            else if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::C)
+            {
+                if (statsCsv.is_open())
+                {
+                    statsCsv.close();
+                    std::cout << "Stopped writing stats.csv" << std::endl;
+                }
+                else
+                {
+                    statsCsv.open("stats.csv");
+                    statsCsv << "frame," << PipelineStats::CsvHeader() << "\n";
+                    std::cout << "Writing stats.csv" << std::endl;
+                }
+            }
+            else if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::V)
+            {
+                const DebugView view = static_cast<DebugView>((static_cast<int>(rast.GetDebugView()) + 1) % (static_cast<int>(DebugView::TriangleSizes) + 1));
+                rast.SetDebugView(view);
+                std::cout << "Debug view: " << Rasterizer::DebugViewName(view) << std::endl;
+            }
+            else if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::F)
+            {
+                captureFrame = true;
+            }
+            else if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::K)
+            {
+                tuned = AutoTune(rast, DEFAULT_TUNE_CACHE, true);
+                std::cout << "Tile size " << tuned.mTileSize << ", " << tuned.mThreadCount << " threads" << std::endl;
+            }
+            else if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::T)
+            {
+                if (!TRACE_ENABLED)
+                    std::cout << "Built without RASTER3D_TRACE, no trace zones were recorded" << std::endl;
+                else if (WriteTrace("trace.json"))
+                    std::cout << "Wrote trace.json" << std::endl;
+            }
+            else if (event.type == sf::Event::MouseButtonPressed && event.mouseButton.button == sf::Mouse::Left && scene.ChunkCount() != 0)
+            {
+                const sf::Vector2f pixel = window.mapPixelToCoords(sf::Vector2i(event.mouseButton.x, event.mouseButton.y));
+                const SceneFileHeader& header = scene.Header();
+                const glm::vec3 lo(header.mAabbMin[0], header.mAabbMin[1], header.mAabbMin[2]);
+                const glm::vec3 hi(header.mAabbMax[0], header.mAabbMax[1], header.mAabbMax[2]);
+                glm::vec3 origin, direction;
+                ClipRay(projection * graph.WorldMatrix(object), pixel.x * 2.0f / CANVAS_WIDTH - 1.0f, pixel.y * 2.0f / CANVAS_HEIGHT - 1.0f,
+                    (lo + hi) * 0.5f, glm::length(hi - lo), origin, direction);
+                const uint32_t chunk = scene.Pick(origin, direction);
+                if (chunk != INVALID_OBJECT)
+                    std::cout << "Picked chunk " << chunk << std::endl;
+            }
         }
 
         window.clear();
-        rast.Clear();
 
-        glm::mat4 model = glm::mat4(1.0f);
-        model = glm::scale(model, glm::vec3(0.2f));
-        float timeFactor = glm::sin(clk.getElapsedTime().asSeconds());
-        model = glm::translate(model, glm::vec3(1.0f * timeFactor));
-        model = glm::rotate(model, 6.28f * glm::sin(clk.getElapsedTime().asSeconds() / 2.0f), glm::vec3(1.0f, 1.0f, 1.0f));
+        const float seconds = clk.getElapsedTime().asSeconds();
+        graph.SetTransform(root, glm::vec3(0.2f * glm::sin(seconds)),
+            glm::angleAxis(6.28f * glm::sin(seconds / 2.0f), glm::normalize(glm::vec3(1.0f))), glm::vec3(0.2f));
+        graph.Update();
 
-        for (auto& element : c.triangles)
+        commands.Reset();
+        if (scene.ChunkCount() != 0)
+        {
+            const glm::mat4& sceneModel = graph.WorldMatrix(object);
+            scene.Update(glm::vec3(glm::inverse(sceneModel) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)), projection * sceneModel);
+            scene.Draw(commands, sceneModel);
+        }
+        else
         {
-            glm::vec3 A = projection * model * glm::vec4(element.mP1, 1.0f);
-            glm::vec3 B = projection * model * glm::vec4(element.mP2, 1.0f);
-            glm::vec3 C = projection * model * glm::vec4(element.mP3, 1.0f);
-            Triangle t = { A, B, C };
-            rast.DrawTriangle(t);
+            commands.BindMesh(mesh);
+            commands.Draw(graph.WorldMatrix(object));
+
+            // translucent shell around the cube, drawn unsorted through the OIT path
+            commands.SetBlendMode(BlendMode::WeightedBlended);
+            commands.Draw(graph.WorldMatrix(shell), Color(120, 180, 255, 90));
+            commands.SetBlendMode(BlendMode::Opaque);
         }
 
-        texture.loadFromImage(canvasBuffer);
-        mySprite.setTexture(texture);
+        if (captureFrame && commands.Capture(rast, "frame.r3dc"))
+            std::cout << "Captured frame.r3dc" << std::endl;
+        captureFrame = false;
+        commands.Submit(rast);
+        if (statsCsv.is_open())
+        {
+            statsCsv << frame << ",";
+            rast.GetPipelineStats().WriteCsv(statsCsv);
+            statsCsv << "\n";
+        }
+        frame++;
 
         window.draw(mySprite);
         window.display();
@@ -0,0 +1,176 @@
+#include "Scenes.h"
+#include <cmath>
+#include <cstdint>
+#include "glm/gtc/matrix_transform.hpp"
+
+namespace
+{
+    const float PI = 3.14159265f;
+
+    // small LCG, so every platform builds the same scenes
+    class Random
+    {
+    public:
+        explicit Random(uint32_t seed) : mState(seed) {}
+
+        // [0, 1)
+        float Next()
+        {
+            mState = mState * 1664525u + 1013904223u;
+            return (mState >> 8) * (1.0f / 16777216.0f);
+        }
+
+        float Range(float lo, float hi) { return lo + (hi - lo) * Next(); }
+
+    private:
+        uint32_t mState;
+    };
+
+    uint32_t AddVertex(Mesh& mesh, float x, float y, float z)
+    {
+        mesh.mX.push_back(x);
+        mesh.mY.push_back(y);
+        mesh.mZ.push_back(z);
+        return static_cast<uint32_t>(mesh.mX.size() - 1);
+    }
+
+    void AddTriangle(Mesh& mesh, uint32_t a, uint32_t b, uint32_t c)
+    {
+        mesh.mIndices.push_back(a);
+        mesh.mIndices.push_back(b);
+        mesh.mIndices.push_back(c);
+    }
+
+    // rings * segments * 2 triangles, the ones at the poles are degenerate
+    void BuildSphere(Mesh& mesh, int rings, int segments)
+    {
+        for (int ring = 0; ring <= rings; ring++)
+        {
+            const float theta = PI * ring / rings;
+            for (int segment = 0; segment <= segments; segment++)
+            {
+                const float phi = 2.0f * PI * segment / segments;
+                AddVertex(mesh, 0.5f * std::sin(theta) * std::cos(phi), 0.5f * std::cos(theta), 0.5f * std::sin(theta) * std::sin(phi));
+            }
+        }
+        for (int ring = 0; ring < rings; ring++)
+        {
+            for (int segment = 0; segment < segments; segment++)
+            {
+                const uint32_t a = ring * (segments + 1) + segment;
+                const uint32_t b = a + segments + 1;
+                AddTriangle(mesh, a, b, a + 1);
+                AddTriangle(mesh, a + 1, b, b + 1);
+            }
+        }
+    }
+
+    // full screen quads, farthest first so every layer passes the depth test
+    void BuildOverdraw(Mesh& mesh, int layers)
+    {
+        for (int layer = 0; layer < layers; layer++)
+        {
+            const float z = 0.9f - 1.8f * layer / (layers - 1);
+            const uint32_t a = AddVertex(mesh, -1.0f, -1.0f, z);
+            const uint32_t b = AddVertex(mesh, 1.0f, -1.0f, z);
+            const uint32_t c = AddVertex(mesh, 1.0f, 1.0f, z);
+            const uint32_t d = AddVertex(mesh, -1.0f, 1.0f, z);
+            AddTriangle(mesh, a, b, c);
+            AddTriangle(mesh, a, c, d);
+        }
+    }
+
+    // long triangles at random angles, a fraction of a pixel wide at 400x300
+    void BuildSlivers(Mesh& mesh, int count)
+    {
+        Random random(1);
+        for (int i = 0; i < count; i++)
+        {
+            const glm::vec2 center(random.Range(-0.5f, 0.5f), random.Range(-0.5f, 0.5f));
+            const float angle = random.Range(0.0f, PI);
+            const glm::vec2 along(std::cos(angle), std::sin(angle));
+            const glm::vec2 across(-along.y, along.x);
+            const glm::vec2 start = center - along;
+            const glm::vec2 end = center + along;
+            const glm::vec2 side = end + across * 0.002f;
+            const float z = random.Range(-0.9f, 0.9f);
+            AddTriangle(mesh, AddVertex(mesh, start.x, start.y, z), AddVertex(mesh, end.x, end.y, z), AddVertex(mesh, side.x, side.y, z));
+        }
+    }
+
+    // a grid over the whole screen, cells of about a pixel and a quarter at 400x300
+    void BuildSmallTriangles(Mesh& mesh, int columns, int rows)
+    {
+        Random random(2);
+        for (int row = 0; row <= rows; row++)
+        {
+            for (int column = 0; column <= columns; column++)
+                AddVertex(mesh, -1.0f + 2.0f * column / columns, -1.0f + 2.0f * row / rows, random.Range(-0.9f, 0.9f));
+        }
+        for (int row = 0; row < rows; row++)
+        {
+            for (int column = 0; column < columns; column++)
+            {
+                const uint32_t a = row * (columns + 1) + column;
+                const uint32_t b = a + columns + 1;
+                AddTriangle(mesh, a, a + 1, b + 1);
+                AddTriangle(mesh, a, b + 1, b);
+            }
+        }
+    }
+}
+
+glm::mat4 BenchScene::Projection(int width, int height) const
+{
+    if (!mAnimated)
+        return glm::mat4(1.0f);
+    return glm::perspective(glm::radians(45.0f), static_cast<float>(width) / height, 0.1f, 100.0f);
+}
+
+glm::mat4 BenchScene::Model(int frame) const
+{
+    if (!mAnimated)
+        return glm::mat4(1.0f);
+    return glm::rotate(glm::scale(glm::mat4(1.0f), glm::vec3(0.6f)), 0.05f * frame, glm::normalize(glm::vec3(1.0f, 1.0f, 0.0f)));
+}
+
+const std::vector<std::string>& SceneNames()
+{
+    static const std::vector<std::string> names = { "cube", "sphere1m", "overdraw", "slivers", "smalltris" };
+    return names;
+}
+
+bool BuildScene(const std::string& name, BenchScene& scene)
+{
+    scene = BenchScene();
+    scene.mName = name;
+    if (name == "cube")
+    {
+        Cube c;
+        scene.mMesh = Mesh::FromTriangles(c.triangles, 12);
+        scene.mAnimated = true;
+    }
+    else if (name == "sphere1m")
+    {
+        BuildSphere(scene.mMesh, 500, 1000);
+        scene.mAnimated = true;
+    }
+    else if (name == "overdraw")
+    {
+        BuildOverdraw(scene.mMesh, 64);
+    }
+    else if (name == "slivers")
+    {
+        BuildSlivers(scene.mMesh, 20000);
+    }
+    else if (name == "smalltris")
+    {
+        BuildSmallTriangles(scene.mMesh, 320, 240);
+    }
+    else
+    {
+        return false;
+    }
+    scene.mMesh.ComputeBounds();
+    return true;
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "glm/glm.hpp"
+#include "Mesh.h"
+
+// A standard benchmark workload: one mesh, drawn once per frame.
+struct BenchScene
+{
+    std::string mName;
+    Mesh mMesh;
+    // spins in front of the demo's perspective projection like the 3DApp cube, otherwise
+    // the mesh is already in clip space and drawn as it is
+    bool mAnimated = false;
+
+    glm::mat4 Projection(int width, int height) const;
+    glm::mat4 Model(int frame) const;
+};
+
+// names BuildScene() accepts, in the order the benchmark runs them
+const std::vector<std::string>& SceneNames();
+// false for an unknown name
+bool BuildScene(const std::string& name, BenchScene& scene);
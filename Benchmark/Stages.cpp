@@ -0,0 +1,289 @@
+#include "Stages.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <functional>
+#include <chrono>
+#include <random>
+#include <cstdint>
+#include <cfloat>
+#include "glm/gtc/matrix_transform.hpp"
+#include "Rasterizer.h"
+#include "RenderTarget.h"
+#include "Bvh.h"
+
+namespace
+{
+    struct StageResult
+    {
+        std::string mName;
+        size_t mOps;
+        double mNsPerOp;
+    };
+
+    // keeps the compiler from dropping work whose result is otherwise unused
+    volatile uint32_t gSink;
+
+    Color FlatShader(int, int, float, const glm::mat4&, int, int)
+    {
+        return Color::White;
+    }
+
+    class StageRunner
+    {
+    public:
+        explicit StageRunner(double secondsPerStage) : mSecondsPerStage(secondsPerStage) {}
+
+        // `batch` does `ops` operations and is timed, `setup` runs before every batch
+        // and isn't. Reports the median of five samples, each as many batches as fit
+        // into a fifth of the time.
+        void Measure(const std::string& name, size_t ops, const std::function<void()>& setup, const std::function<void()>& batch)
+        {
+            using Clock = std::chrono::steady_clock;
+            setup();
+            const auto start = Clock::now();
+            batch();
+            const double once = std::max(std::chrono::duration<double>(Clock::now() - start).count(), 1e-9);
+            const size_t batches = std::max<size_t>(1, static_cast<size_t>(mSecondsPerStage / 5.0 / once));
+
+            std::vector<double> samples;
+            for (int sample = 0; sample < 5; sample++)
+            {
+                double seconds = 0.0;
+                for (size_t i = 0; i < batches; i++)
+                {
+                    setup();
+                    const auto batchStart = Clock::now();
+                    batch();
+                    seconds += std::chrono::duration<double>(Clock::now() - batchStart).count();
+                }
+                samples.push_back(seconds * 1e9 / (batches * ops));
+            }
+            std::sort(samples.begin(), samples.end());
+            mResults.push_back({ name, batches * ops * samples.size(), samples[samples.size() / 2] });
+            std::cerr << name << ": " << mResults.back().mNsPerOp << " ns" << std::endl;
+        }
+
+        const std::vector<StageResult>& Results() const { return mResults; }
+
+    private:
+        double mSecondsPerStage;
+        std::vector<StageResult> mResults;
+    };
+
+    // clip space triangle of about `size` pixels at `center`
+    Triangle ShapedTriangle(const std::string& shape, float size, const glm::vec2& center, int width, int height)
+    {
+        const glm::vec2 pixel(2.0f / width, 2.0f / height);
+        auto at = [&](float x, float y) { return glm::vec3(center + glm::vec2(x, y) * size * pixel, 0.5f); };
+        if (shape == "flat")
+            return Triangle(at(-0.5f, -0.5f), at(0.5f, -0.5f), at(0.0f, 0.5f));
+        if (shape == "tilted")
+            return Triangle(at(-0.5f, -0.3f), at(0.4f, -0.5f), at(0.1f, 0.5f));
+        // "sliver": long and a pixel or less wide
+        return Triangle(at(-0.5f, -0.5f), at(0.5f, 0.5f), at(0.5f, 0.5f) + glm::vec3(pixel.x, 0.0f, 0.0f));
+    }
+
+    bool ReadBaseline(const std::string& path, std::map<std::string, double>& nsPerOp)
+    {
+        std::ifstream file(path);
+        if (!file)
+        {
+            std::cerr << "Benchmark: " << path << ": cannot open" << std::endl;
+            return false;
+        }
+        // one stage per line, as WriteStages() writes them
+        std::string line;
+        while (std::getline(file, line))
+        {
+            const size_t name = line.find("\"name\": \"");
+            const size_t ns = line.find("\"ns_per_op\": ");
+            if (name == std::string::npos || ns == std::string::npos)
+                continue;
+            const size_t nameStart = name + 9;
+            const size_t nameEnd = line.find('"', nameStart);
+            nsPerOp[line.substr(nameStart, nameEnd - nameStart)] = std::stod(line.substr(ns + 13));
+        }
+        return true;
+    }
+
+    void WriteStages(std::ostream& out, const std::vector<StageResult>& results, const std::map<std::string, double>& baseline)
+    {
+        out.setf(std::ios::fixed);
+        out.precision(3);
+        out << "{\n  \"stages\": [";
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            const StageResult& result = results[i];
+            out << (i == 0 ? "\n" : ",\n");
+            out << "    { \"name\": \"" << result.mName << "\", \"ops\": " << result.mOps << ", \"ns_per_op\": " << result.mNsPerOp;
+            const auto old = baseline.find(result.mName);
+            if (old != baseline.end())
+                out << ", \"baseline_ns_per_op\": " << old->second << ", \"speedup\": " << old->second / result.mNsPerOp;
+            out << " }";
+        }
+        out << "\n  ]\n}\n";
+    }
+}
+
+int RunStages(double secondsPerStage, const std::string& baseline, const std::string& output)
+{
+    std::map<std::string, double> baselineNs;
+    if (!baseline.empty() && !ReadBaseline(baseline, baselineNs))
+        return 1;
+
+    StageRunner runner(secondsPerStage);
+    ImageTarget canvas;
+    Rasterizer rast(&canvas);
+    rast.SetThreadCount(1);
+    rast.proj = glm::mat4(1.0f);
+    rast.invProj = glm::mat4(1.0f);
+    auto noSetup = [] {};
+
+    // one frame's depth and color reset, and presenting the frame to a headless target
+    const int sizes[][2] = { { 400, 300 }, { 1920, 1080 } };
+    for (const auto& size : sizes)
+    {
+        const std::string suffix = std::to_string(size[0]) + "x" + std::to_string(size[1]);
+        rast.Resize(size[0], size[1]);
+        runner.Measure("clear/" + suffix, 1, noSetup, [&] { rast.Clear(); });
+
+        std::vector<uint8_t> frame(static_cast<size_t>(size[0]) * size[1] * 4, 128);
+        runner.Measure("present/" + suffix, 1, noSetup, [&] { canvas.Present(frame.data(), size[0], size[1]); });
+    }
+    rast.Resize(CANVAS_WIDTH, CANVAS_HEIGHT);
+    const int width = rast.Width();
+    const int height = rast.Height();
+
+    // setup alone, then setup and binning, of 256 triangles of one shape and size spread
+    // over the screen
+    const char* shapes[] = { "flat", "tilted", "sliver" };
+    const float triangleSizes[] = { 1.0f, 16.0f, 256.0f };
+    for (const char* shape : shapes)
+    {
+        for (float triangleSize : triangleSizes)
+        {
+            std::vector<Triangle> triangles;
+            for (int i = 0; i < 256; i++)
+            {
+                const glm::vec2 center(-0.8f + 1.6f * ((i * 37) % 256) / 255.0f, -0.8f + 1.6f * ((i * 101) % 256) / 255.0f);
+                triangles.push_back(ShapedTriangle(shape, triangleSize, center, width, height));
+            }
+            const std::string suffix = std::string(shape) + "/" + std::to_string(static_cast<int>(triangleSize)) + "px";
+            runner.Measure("setup/" + suffix, triangles.size(), noSetup, [&] {
+                float sum = 0.0f;
+                for (const Triangle& triangle : triangles)
+                    sum += rast.NDCTriangle(triangle).mP3.y;
+                gSink = static_cast<uint32_t>(sum);
+            });
+            runner.Measure("bin/" + suffix, triangles.size(), [&] { rast.Clear(); }, [&] {
+                for (const Triangle& triangle : triangles)
+                    rast.DrawTriangle(triangle);
+            });
+        }
+    }
+
+    // Spans of one length covering the screen once per batch. Right after Clear() every
+    // pixel passes the depth test; behind a nearer screen every one fails.
+    const int spanLengths[] = { 1, 8, 64, 400 };
+    const ShaderFn shaders[] = { ShaderFunction, FlatShader };
+    const char* shaderNames[] = { "shaded", "flat" };
+    for (int length : spanLengths)
+    {
+        for (int shader = 0; shader < 2; shader++)
+        {
+            const std::string suffix = std::to_string(length) + "px/" + shaderNames[shader];
+            const size_t spansPerRow = width / length;
+            auto fill = [&](float z) {
+                for (int y = 0; y < height; y++)
+                {
+                    for (size_t x = 0; x + length <= static_cast<size_t>(width); x += length)
+                        rast.DrawLine(static_cast<int>(x), y, static_cast<int>(x) + length - 1, z, z);
+                }
+            };
+            rast.SetShader(shaders[shader]);
+            runner.Measure("span/pass/" + suffix, spansPerRow * height, [&] { rast.Clear(); }, [&] { fill(0.5f); });
+            rast.Clear();
+            fill(0.0f);
+            runner.Measure("span/fail/" + suffix, spansPerRow * height, noSetup, [&] { fill(0.5f); });
+        }
+    }
+
+    // the depth test and write of single pixels, and the shader on its own
+    for (int shader = 0; shader < 2; shader++)
+    {
+        const std::string suffix = shaderNames[shader];
+        rast.SetShader(shaders[shader]);
+        auto fill = [&](float z) {
+            for (int y = 0; y < height; y++)
+            {
+                for (int x = 0; x < width; x++)
+                    rast.SetPixel(x, y, z, Color::White);
+            }
+        };
+        runner.Measure("pixel/pass/" + suffix, static_cast<size_t>(width) * height, [&] { rast.Clear(); }, [&] { fill(0.5f); });
+        rast.Clear();
+        fill(0.0f);
+        runner.Measure("pixel/fail/" + suffix, static_cast<size_t>(width) * height, noSetup, [&] { fill(0.5f); });
+    }
+    rast.SetShader(ShaderFunction);
+
+    runner.Measure("shader", static_cast<size_t>(width) * height, noSetup, [&] {
+        uint32_t sum = 0;
+        for (int y = 0; y < height; y++)
+        {
+            for (int x = 0; x < width; x++)
+                sum += ShaderFunction(x, y, 0.5f, rast.invProj, width, height).r;
+        }
+        gSink = sum;
+    });
+
+    // Bvh over 1M random boxes, built once as building takes seconds: a frustum query
+    // over about 2.5% of them, a refit and raycasts from the middle of the volume
+    const size_t boxCount = 1000000;
+    std::mt19937 random(39);
+    std::uniform_real_distribution<float> position(-50.0f, 50.0f);
+    std::uniform_real_distribution<float> size(0.0f, 0.5f);
+    std::vector<Aabb> boxes(boxCount);
+    for (Aabb& box : boxes)
+    {
+        box.mMin = glm::vec3(position(random), position(random), position(random));
+        box.mMax = box.mMin + glm::vec3(size(random), size(random), size(random));
+    }
+    Bvh bvh;
+    bvh.Build(boxes.data(), boxes.size());
+
+    const Frustum frustum = Frustum::FromMatrix(glm::scale(glm::mat4(1.0f), glm::vec3(1.0f / 8.0f, 1.0f / 8.0f, 1.0f)));
+    std::vector<uint32_t> visible;
+    runner.Measure("bvh/frustum/1M", 1, [&] { visible.clear(); }, [&] { bvh.QueryFrustum(frustum, visible); });
+    std::cerr << "bvh/frustum/1M: " << visible.size() << " boxes visible" << std::endl;
+
+    runner.Measure("bvh/refit/1M", 1, noSetup, [&] { bvh.Refit(); });
+
+    std::vector<glm::vec3> directions(256);
+    for (glm::vec3& direction : directions)
+        direction = glm::normalize(glm::vec3(position(random), position(random), position(random)) + glm::vec3(1e-3f));
+    runner.Measure("bvh/raycast/1M", directions.size(), noSetup, [&] {
+        uint32_t sum = 0;
+        for (const glm::vec3& direction : directions)
+            sum += bvh.Raycast(glm::vec3(0.0f), direction, FLT_MAX);
+        gSink = sum;
+    });
+
+    if (output.empty())
+    {
+        WriteStages(std::cout, runner.Results(), baselineNs);
+        return 0;
+    }
+    std::ofstream file(output);
+    WriteStages(file, runner.Results(), baselineNs);
+    if (!file)
+    {
+        std::cerr << "Benchmark: " << output << ": write failed" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,9 @@
+#pragma once
+#include <string>
+
+// Times the stages of a frame one by one on synthetic input: Clear(), triangle setup
+// and binning, span filling, the per-pixel depth test, the shader and presenting.
+// Results go to `output` as JSON, or stdout if it's empty. With a `baseline` file
+// written by an earlier run, e.g. of an older build, every stage also reports its
+// speedup over that run. Returns the process exit code.
+int RunStages(double secondsPerStage, const std::string& baseline, const std::string& output);
@@ -0,0 +1,398 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <cmath>
+#include <functional>
+#include "Rasterizer.h"
+#include "CommandBuffer.h"
+#include "RenderTarget.h"
+#include "Scenes.h"
+#include "Stages.h"
+#include "Trace.h"
+#include "FrameCapture.h"
+#include "AutoTune.h"
+
+namespace
+{
+    struct Resolution
+    {
+        int mWidth;
+        int mHeight;
+    };
+
+    struct Result
+    {
+        std::string mScene;
+        Resolution mResolution;
+        unsigned mThreads;
+        size_t mTriangles;
+        std::vector<double> mFrameMs; // sorted
+        PipelineStats mStats; // of all timed frames
+        bool mReplay = false;
+        uint64_t mImageHash = 0; // of replays, whose frames all have to match
+    };
+
+    void PrintUsage()
+    {
+        std::cerr << "usage: Benchmark [--frames N] [--warmup N] [--scenes name,...] [--resolutions WxH,...] [--threads N,...] [--output file.json] [--stats file.csv] [--trace file.json] [--pin]" << std::endl;
+        std::cerr << "       Benchmark --replay capture.r3dc [--frames N] [--warmup N] [--threads N,...] [--output file.json] [--stats file.csv] [--trace file.json] [--pin]" << std::endl;
+        std::cerr << "       Benchmark --stages [--seconds S] [--baseline old.json] [--output file.json]" << std::endl;
+        std::cerr << "       Benchmark --tune [--resolutions WxH,...] [--output cache.txt]" << std::endl;
+        std::cerr << "scenes:";
+        for (const std::string& name : SceneNames())
+            std::cerr << " " << name;
+        std::cerr << std::endl;
+    }
+
+    std::vector<std::string> Split(const std::string& list)
+    {
+        std::vector<std::string> items;
+        std::stringstream stream(list);
+        std::string item;
+        while (std::getline(stream, item, ','))
+        {
+            if (!item.empty())
+                items.push_back(item);
+        }
+        return items;
+    }
+
+    bool ParseResolution(const std::string& text, Resolution& resolution)
+    {
+        char x = 0;
+        std::stringstream stream(text);
+        return (stream >> resolution.mWidth >> x >> resolution.mHeight) && x == 'x'
+            && resolution.mWidth > 0 && resolution.mHeight > 0;
+    }
+
+    // nearest rank
+    double Percentile(const std::vector<double>& sorted, double p)
+    {
+        const size_t rank = static_cast<size_t>(std::ceil(p * sorted.size()));
+        return sorted[std::min(std::max(rank, size_t(1)), sorted.size()) - 1];
+    }
+
+    double Mean(const std::vector<double>& values)
+    {
+        double sum = 0.0;
+        for (double value : values)
+            sum += value;
+        return sum / values.size();
+    }
+
+    // FNV-1a
+    uint64_t HashImage(const ImageTarget& image)
+    {
+        uint64_t hash = 14695981039346656037ull;
+        const uint8_t* pixels = image.Pixels();
+        for (size_t i = 0; i < static_cast<size_t>(image.Width()) * image.Height() * 4; i++)
+            hash = (hash ^ pixels[i]) * 1099511628211ull;
+        return hash;
+    }
+
+    // Renders warmup + frames frames, `submit` draws the given one. Stats of the timed
+    // frames go to `stats` if it is open.
+    Result RunFrames(Rasterizer& rast, ImageTarget& canvas, const std::string& name, int frames, int warmup,
+        std::ofstream& stats, bool replay, const std::function<void(int)>& submit)
+    {
+        Result result;
+        result.mScene = name;
+        result.mResolution = { rast.Width(), rast.Height() };
+        result.mThreads = rast.GetThreadCount();
+        result.mReplay = replay;
+        for (int frame = 0; frame < warmup + frames; frame++)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            submit(frame);
+            const auto end = std::chrono::steady_clock::now();
+            if (frame < warmup)
+                continue;
+            result.mFrameMs.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+            result.mStats.Add(rast.GetPipelineStats());
+            if (stats.is_open())
+            {
+                stats << name << "," << rast.Width() << "," << rast.Height() << "," << rast.GetThreadCount() << "," << frame - warmup << ",";
+                rast.GetPipelineStats().WriteCsv(stats);
+                stats << "\n";
+            }
+            if (replay)
+            {
+                const uint64_t hash = HashImage(canvas);
+                if (frame == warmup)
+                    result.mImageHash = hash;
+                else if (hash != result.mImageHash)
+                    std::cerr << "Benchmark: " << name << ": frame " << frame - warmup << " differs from the first one" << std::endl;
+            }
+        }
+        std::sort(result.mFrameMs.begin(), result.mFrameMs.end());
+        std::cerr << name << " " << rast.Width() << "x" << rast.Height() << " " << rast.GetThreadCount() << " threads: "
+            << Mean(result.mFrameMs) << " ms mean, " << Percentile(result.mFrameMs, 0.99) << " ms p99" << std::endl;
+        return result;
+    }
+
+    void WriteJson(std::ostream& out, const std::vector<Result>& results, int frames, int warmup)
+    {
+        out.setf(std::ios::fixed);
+        out.precision(4);
+        out << "{\n";
+        out << "  \"frames\": " << frames << ",\n";
+        out << "  \"warmup\": " << warmup << ",\n";
+        out << "  \"hardware_threads\": " << std::thread::hardware_concurrency() << ",\n";
+        out << "  \"results\": [";
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            const Result& result = results[i];
+            const double meanMs = Mean(result.mFrameMs);
+            const double pixels = static_cast<double>(result.mResolution.mWidth) * result.mResolution.mHeight;
+            out << (i == 0 ? "\n" : ",\n");
+            out << "    {\n";
+            out << "      \"scene\": \"" << result.mScene << "\",\n";
+            out << "      \"width\": " << result.mResolution.mWidth << ",\n";
+            out << "      \"height\": " << result.mResolution.mHeight << ",\n";
+            out << "      \"threads\": " << result.mThreads << ",\n";
+            out << "      \"triangles\": " << result.mTriangles << ",\n";
+            out << "      \"mean_ms\": " << meanMs << ",\n";
+            out << "      \"p50_ms\": " << Percentile(result.mFrameMs, 0.5) << ",\n";
+            out << "      \"p99_ms\": " << Percentile(result.mFrameMs, 0.99) << ",\n";
+            out << "      \"min_ms\": " << result.mFrameMs.front() << ",\n";
+            out << "      \"max_ms\": " << result.mFrameMs.back() << ",\n";
+            out << "      \"mtris_per_s\": " << result.mTriangles / meanMs / 1000.0 << ",\n";
+            out << "      \"mpixels_per_s\": " << pixels / meanMs / 1000.0 << ",\n";
+            // stage means
+            const double frameCount = static_cast<double>(result.mFrameMs.size());
+            out << "      \"clear_ms\": " << result.mStats.mClearMs / frameCount << ",\n";
+            out << "      \"draw_ms\": " << result.mStats.mDrawMs / frameCount << ",\n";
+            out << "      \"raster_ms\": " << result.mStats.mRasterMs / frameCount << ",\n";
+            out << "      \"pyramid_ms\": " << result.mStats.mPyramidMs / frameCount << ",\n";
+            out << "      \"present_ms\": " << result.mStats.mPresentMs / frameCount;
+            if (result.mReplay)
+                out << ",\n      \"image_hash\": \"" << std::hex << result.mImageHash << std::dec << "\"";
+            out << "\n";
+            out << "    }";
+        }
+        out << "\n  ]\n}\n";
+    }
+
+    // calibrates every resolution again, for the cache programs read on startup
+    int RunTune(const std::vector<Resolution>& resolutions, const std::string& cachePath)
+    {
+        ImageTarget canvas;
+        Rasterizer rast(&canvas);
+        for (const Resolution& resolution : resolutions)
+        {
+            rast.Resize(resolution.mWidth, resolution.mHeight);
+            const TuneSettings settings = AutoTune(rast, cachePath, true);
+            std::cerr << TuneKey(resolution.mWidth, resolution.mHeight) << ": tile size " << settings.mTileSize << ", "
+                << settings.mThreadCount << " threads, " << settings.mFrameMs << " ms" << std::endl;
+        }
+        return 0;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    int frames = 100;
+    int warmup = 5;
+    std::vector<std::string> scenes = SceneNames();
+    std::vector<Resolution> resolutions = { { 400, 300 }, { 800, 600 }, { 1920, 1080 } };
+    std::vector<unsigned> threads = { 1 };
+    if (std::thread::hardware_concurrency() > 1)
+        threads.push_back(std::thread::hardware_concurrency());
+    std::string output;
+    std::string statsPath;
+    std::string tracePath;
+    std::string replayPath;
+    bool stages = false;
+    bool tune = false;
+    bool pinWorkers = false;
+    double secondsPerStage = 0.5;
+    std::string baseline;
+
+    for (int arg = 1; arg < argc; arg++)
+    {
+        const std::string option = argv[arg];
+        if (option == "--stages")
+        {
+            stages = true;
+            continue;
+        }
+        if (option == "--tune")
+        {
+            tune = true;
+            continue;
+        }
+        if (option == "--pin")
+        {
+            pinWorkers = true;
+            continue;
+        }
+        if (arg + 1 >= argc)
+        {
+            PrintUsage();
+            return 1;
+        }
+        const std::string value = argv[++arg];
+        if (option == "--frames")
+        {
+            frames = std::stoi(value);
+        }
+        else if (option == "--warmup")
+        {
+            warmup = std::stoi(value);
+        }
+        else if (option == "--scenes")
+        {
+            scenes = Split(value);
+        }
+        else if (option == "--resolutions")
+        {
+            resolutions.clear();
+            for (const std::string& item : Split(value))
+            {
+                Resolution resolution;
+                if (!ParseResolution(item, resolution))
+                {
+                    PrintUsage();
+                    return 1;
+                }
+                resolutions.push_back(resolution);
+            }
+        }
+        else if (option == "--threads")
+        {
+            threads.clear();
+            for (const std::string& item : Split(value))
+                threads.push_back(static_cast<unsigned>(std::max(std::stoi(item), 1)));
+        }
+        else if (option == "--output")
+        {
+            output = value;
+        }
+        else if (option == "--stats")
+        {
+            statsPath = value;
+        }
+        else if (option == "--replay")
+        {
+            replayPath = value;
+        }
+        else if (option == "--trace")
+        {
+            tracePath = value;
+        }
+        else if (option == "--seconds")
+        {
+            secondsPerStage = std::stod(value);
+        }
+        else if (option == "--baseline")
+        {
+            baseline = value;
+        }
+        else
+        {
+            PrintUsage();
+            return 1;
+        }
+    }
+    if (stages)
+        return RunStages(secondsPerStage, baseline, output);
+    if (tune)
+        return RunTune(resolutions, output.empty() ? DEFAULT_TUNE_CACHE : output);
+    if (frames < 1 || warmup < 0 || scenes.empty() || resolutions.empty() || threads.empty())
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    // pipeline stats of every timed frame
+    std::ofstream stats;
+    if (!statsPath.empty())
+    {
+        stats.open(statsPath);
+        if (!stats)
+        {
+            std::cerr << "Benchmark: " << statsPath << ": cannot open for writing" << std::endl;
+            return 1;
+        }
+        stats << "scene,width,height,threads,frame," << PipelineStats::CsvHeader() << "\n";
+    }
+
+    if (!tracePath.empty() && !TRACE_ENABLED)
+        std::cerr << "Benchmark: built without RASTER3D_TRACE, " << tracePath << " will have no zones" << std::endl;
+
+    ImageTarget canvas;
+    Rasterizer rast(&canvas);
+    rast.SetPinWorkers(pinWorkers);
+    CommandBuffer commands;
+    std::vector<Result> results;
+    if (!replayPath.empty())
+    {
+        // the captured frame at its own resolution, once per thread count
+        FrameReplay replay;
+        if (!replay.Open(replayPath))
+            return 1;
+        for (unsigned threadCount : threads)
+        {
+            rast.SetThreadCount(threadCount);
+            rast.Resize(replay.Width(), replay.Height());
+            Result result = RunFrames(rast, canvas, replayPath, frames, warmup, stats, true, [&](int) {
+                replay.Submit(rast);
+            });
+            result.mTriangles = replay.TriangleCount();
+            results.push_back(std::move(result));
+        }
+        scenes.clear();
+    }
+
+    for (const std::string& name : scenes)
+    {
+        BenchScene scene;
+        if (!BuildScene(name, scene))
+        {
+            std::cerr << "Benchmark: unknown scene " << name << std::endl;
+            PrintUsage();
+            return 1;
+        }
+
+        for (const Resolution& resolution : resolutions)
+        {
+            for (unsigned threadCount : threads)
+            {
+                rast.Resize(resolution.mWidth, resolution.mHeight);
+                rast.SetThreadCount(threadCount);
+                rast.proj = scene.Projection(resolution.mWidth, resolution.mHeight);
+                rast.invProj = glm::inverse(rast.proj);
+
+                Result result = RunFrames(rast, canvas, name, frames, warmup, stats, false, [&](int frame) {
+                    commands.Reset();
+                    commands.BindMesh(&scene.mMesh);
+                    commands.Draw(scene.Model(frame));
+                    commands.Submit(rast);
+                });
+                result.mTriangles = scene.mMesh.TriangleCount();
+                results.push_back(std::move(result));
+            }
+        }
+    }
+
+    if (!tracePath.empty() && !WriteTrace(tracePath))
+        return 1;
+    if (output.empty())
+    {
+        WriteJson(std::cout, results, frames, warmup);
+        return 0;
+    }
+    std::ofstream file(output);
+    WriteJson(file, results, frames, warmup);
+    if (!file)
+    {
+        std::cerr << "Benchmark: " << output << ": write failed" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,133 @@
+#include <iostream>
+#include <string>
+#include "Mesh.h"
+#include "MeshFile.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "Meshlets.h"
+#include "ObjImporter.h"
+#include "SceneFile.h"
+
+static void PrintUsage()
+{
+    std::cerr << "usage: MeshConverter [--optimize] [--lods] [--meshlets] [--compress | --scene] <input.obj | --cube> <output.r3dm | output.r3ds>" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    int arg = 1;
+    bool compress = false;
+    bool optimize = false;
+    bool lods = false;
+    bool meshlets = false;
+    bool scene = false;
+    for (; arg < argc && argv[arg][0] == '-' && argv[arg][1] == '-'; arg++)
+    {
+        const std::string option = argv[arg];
+        if (option == "--cube")
+            break;
+
+        if (option == "--compress")
+        {
+            compress = true;
+        }
+        else if (option == "--optimize")
+        {
+            optimize = true;
+        }
+        else if (option == "--lods")
+        {
+            lods = true;
+        }
+        else if (option == "--meshlets")
+        {
+            meshlets = true;
+        }
+        else if (option == "--scene")
+        {
+            scene = true;
+        }
+        else
+        {
+            PrintUsage();
+            return 1;
+        }
+    }
+    if (argc - arg != 2)
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    const std::string input = argv[arg];
+    const std::string output = argv[arg + 1];
+
+    Mesh mesh;
+    if (input == "--cube")
+    {
+        Cube c;
+        mesh = Mesh::FromTriangles(c.triangles, 12);
+    }
+    else if (!ImportObj(input, mesh))
+    {
+        return 1;
+    }
+    mesh.ComputeBounds();
+
+    // chunks get optimized, levels of detail and meshlets of their own
+    if (scene)
+    {
+        if (compress || optimize || lods || meshlets)
+            std::cerr << "--scene processes every chunk itself, other options are ignored" << std::endl;
+        if (!WriteSceneFile(output, mesh))
+            return 1;
+        std::cout << output << ": " << mesh.VertexCount() << " vertices, " << mesh.TriangleCount() << " triangles" << std::endl;
+        return 0;
+    }
+
+    if (optimize)
+    {
+        const float before = ComputeAcmr(mesh.mIndices.data(), mesh.mIndices.size(), mesh.VertexCount());
+        OptimizeMesh(mesh);
+        const float after = ComputeAcmr(mesh.mIndices.data(), mesh.mIndices.size(), mesh.VertexCount());
+        std::cout << "ACMR (16 entry FIFO): " << before << " -> " << after << std::endl;
+    }
+
+    if (lods)
+    {
+        if (compress)
+            std::cerr << "compressed files don't store levels of detail, --lods is ignored" << std::endl;
+        else
+            BuildLodChain(mesh);
+        for (size_t i = 0; i < mesh.mLods.size(); i++)
+            std::cout << "LOD " << i + 1 << ": " << mesh.mLods[i].mIndexCount / 3 << " triangles, error " << mesh.mLods[i].mError << std::endl;
+    }
+
+    if (meshlets)
+    {
+        if (compress)
+        {
+            std::cerr << "compressed files don't store meshlets, --meshlets is ignored" << std::endl;
+        }
+        else
+        {
+            BuildMeshlets(mesh);
+            std::cout << mesh.mMeshlets.size() << " meshlets, " << mesh.mMeshletVertices.size() / static_cast<float>(mesh.VertexCount())
+                << " meshlet vertices per vertex" << std::endl;
+        }
+    }
+
+    if (compress)
+    {
+        const CompressedMesh compressed = EncodeMesh(mesh);
+        if (!WriteMeshFile(output, compressed))
+            return 1;
+    }
+    else if (!WriteMeshFile(output, mesh))
+    {
+        return 1;
+    }
+
+    std::cout << output << ": " << mesh.VertexCount() << " vertices, " << mesh.TriangleCount() << " triangles" << std::endl;
+    return 0;
+}
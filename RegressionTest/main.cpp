@@ -0,0 +1,572 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cerrno>
+#include <cfloat>
+#include <random>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+#include "glm/gtc/matrix_transform.hpp"
+#include "Rasterizer.h"
+#include "CommandBuffer.h"
+#include "RenderTarget.h"
+#include "Meshlets.h"
+#include "Bvh.h"
+#include "Scenes.h"
+
+namespace
+{
+    // small enough to keep the golden images in the repository, with partial tiles on two sides
+    constexpr int IMAGE_WIDTH = 256;
+    constexpr int IMAGE_HEIGHT = 160;
+    // animated scenes are checked at this frame
+    constexpr int CHECKED_FRAME = 10;
+    // every image is rendered with each of these, the result mustn't depend on it
+    const unsigned IMAGE_THREADS[] = { 1, 3 };
+
+    struct Options
+    {
+        std::string mOutput = "regression";
+        bool mUpdate = false;
+        int mTolerance = 2; // per channel
+        double mMaxBadPixels = 0.0005; // share of the image allowed beyond the tolerance
+        double mMaxSlowdown = 1.3;
+        int mFrames = 5;
+    };
+
+    // one checked workload: a standard benchmark scene, or one of them drawn through the
+    // transparency or meshlet paths
+    struct TestCase
+    {
+        std::string mName;
+        BenchScene mScene;
+        bool mTransparentShell = false;
+    };
+
+    void PrintUsage()
+    {
+        std::cerr << "usage: RegressionTest images <golden dir> [--update] [--tolerance N] [--max-bad-pixels share] [--output dir]" << std::endl;
+        std::cerr << "       RegressionTest perf <baseline.json> [--update] [--max-slowdown X] [--frames N] [--output dir]" << std::endl;
+        std::cerr << "       RegressionTest bvh" << std::endl;
+    }
+
+    std::vector<TestCase> BuildCases()
+    {
+        std::vector<TestCase> cases;
+        for (const std::string& name : SceneNames())
+        {
+            TestCase test;
+            test.mName = name;
+            BuildScene(name, test.mScene);
+            cases.push_back(std::move(test));
+        }
+
+        TestCase oit;
+        oit.mName = "cube_oit";
+        BuildScene("cube", oit.mScene);
+        oit.mTransparentShell = true;
+        cases.push_back(std::move(oit));
+
+        TestCase meshlets;
+        meshlets.mName = "sphere_meshlets";
+        BuildScene("sphere1m", meshlets.mScene);
+        BuildMeshlets(meshlets.mScene.mMesh);
+        cases.push_back(std::move(meshlets));
+        return cases;
+    }
+
+    // renders `frame` of the case, returns the milliseconds Submit() took
+    double Render(Rasterizer& rast, CommandBuffer& commands, const TestCase& test, int frame)
+    {
+        rast.proj = test.mScene.Projection(rast.Width(), rast.Height());
+        rast.invProj = glm::inverse(rast.proj);
+        const glm::mat4 model = test.mScene.Model(frame);
+
+        commands.Reset();
+        commands.BindMesh(&test.mScene.mMesh);
+        commands.Draw(model);
+        if (test.mTransparentShell)
+        {
+            // like the 3DApp demo: a translucent, larger copy around the mesh
+            commands.SetBlendMode(BlendMode::WeightedBlended);
+            commands.Draw(glm::scale(model, glm::vec3(1.4f)), Color(120, 180, 255, 90));
+            commands.Draw(glm::scale(model, glm::vec3(1.8f)), Color(255, 160, 60, 60));
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        commands.Submit(rast);
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    struct ImageDiff
+    {
+        int mMaxDifference = 0;
+        size_t mBadPixels = 0; // beyond the tolerance
+    };
+
+    // also draws the differences into `diff`: the expected image darkened, bad pixels red
+    ImageDiff Compare(const ImageTarget& actual, const ImageTarget& expected, int tolerance, std::vector<uint8_t>& diff)
+    {
+        ImageDiff result;
+        const size_t pixelCount = static_cast<size_t>(actual.Width()) * actual.Height();
+        diff.resize(pixelCount * 4);
+        for (size_t i = 0; i < pixelCount; i++)
+        {
+            const uint8_t* a = actual.Pixels() + i * 4;
+            const uint8_t* e = expected.Pixels() + i * 4;
+            int difference = 0;
+            for (int channel = 0; channel < 3; channel++)
+                difference = std::max(difference, std::abs(a[channel] - e[channel]));
+            result.mMaxDifference = std::max(result.mMaxDifference, difference);
+
+            uint8_t* d = &diff[i * 4];
+            if (difference > tolerance)
+            {
+                result.mBadPixels++;
+                d[0] = static_cast<uint8_t>(std::min(128 + difference, 255));
+                d[1] = 0;
+                d[2] = 0;
+            }
+            else
+            {
+                const uint8_t gray = static_cast<uint8_t>((e[0] + e[1] + e[2]) / 9);
+                d[0] = gray;
+                d[1] = gray;
+                d[2] = gray;
+            }
+            d[3] = 255;
+        }
+        return result;
+    }
+
+    // only the last component is created
+    bool MakeDirectory(const std::string& path)
+    {
+#ifdef _WIN32
+        const int result = _mkdir(path.c_str());
+#else
+        const int result = mkdir(path.c_str(), 0755);
+#endif
+        if (result != 0 && errno != EEXIST)
+        {
+            std::cerr << "RegressionTest: " << path << ": cannot create" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    int RunImages(const std::string& golden, const Options& options)
+    {
+        if (!MakeDirectory(options.mOutput))
+            return 1;
+
+        ImageTarget canvas;
+        Rasterizer rast(&canvas);
+        rast.Resize(IMAGE_WIDTH, IMAGE_HEIGHT);
+        CommandBuffer commands;
+        std::ofstream report(options.mOutput + "/images.json");
+        report.setf(std::ios::fixed);
+        report.precision(3);
+        report << "{\n  \"images\": [";
+
+        bool first = true;
+        int failures = 0;
+        for (const TestCase& test : BuildCases())
+        {
+            const std::string goldenPath = golden + "/" + test.mName + ".ppm";
+            ImageTarget expected;
+            if (!options.mUpdate && !expected.LoadPpm(goldenPath))
+            {
+                failures++;
+                continue;
+            }
+
+            for (unsigned threads : IMAGE_THREADS)
+            {
+                rast.SetThreadCount(threads);
+                // the second frame culls against the first one's depth, like a running app
+                Render(rast, commands, test, CHECKED_FRAME - 1);
+                const double ms = Render(rast, commands, test, CHECKED_FRAME);
+
+                if (options.mUpdate && threads == IMAGE_THREADS[0])
+                {
+                    if (!canvas.SavePpm(goldenPath) || !expected.LoadPpm(goldenPath))
+                        return 1;
+                }
+                if (expected.Width() != canvas.Width() || expected.Height() != canvas.Height())
+                {
+                    std::cerr << "RegressionTest: " << goldenPath << ": expected " << IMAGE_WIDTH << "x" << IMAGE_HEIGHT << std::endl;
+                    failures++;
+                    break;
+                }
+
+                std::vector<uint8_t> diffPixels;
+                const ImageDiff diff = Compare(canvas, expected, options.mTolerance, diffPixels);
+                const size_t allowed = static_cast<size_t>(options.mMaxBadPixels * IMAGE_WIDTH * IMAGE_HEIGHT);
+                const bool pass = diff.mBadPixels <= allowed;
+                const std::string label = test.mName + " " + std::to_string(threads) + "t";
+                std::cerr << (pass ? "PASS " : "FAIL ") << label << ": " << diff.mBadPixels << " pixels beyond "
+                    << options.mTolerance << " (" << allowed << " allowed), max difference " << diff.mMaxDifference
+                    << ", " << ms << " ms" << std::endl;
+                if (!pass)
+                {
+                    failures++;
+                    const std::string prefix = options.mOutput + "/" + test.mName + "_" + std::to_string(threads) + "t";
+                    canvas.SavePpm(prefix + "_actual.ppm");
+                    ImageTarget diffImage;
+                    diffImage.Present(diffPixels.data(), IMAGE_WIDTH, IMAGE_HEIGHT);
+                    diffImage.SavePpm(prefix + "_diff.ppm");
+                    std::cerr << "     wrote " << prefix << "_actual.ppm and " << prefix << "_diff.ppm" << std::endl;
+                }
+
+                report << (first ? "\n" : ",\n");
+                first = false;
+                report << "    { \"case\": \"" << test.mName << "\", \"threads\": " << threads << ", \"pass\": " << (pass ? "true" : "false")
+                    << ", \"bad_pixels\": " << diff.mBadPixels << ", \"max_difference\": " << diff.mMaxDifference << ", \"ms\": " << ms << " }";
+            }
+        }
+        report << "\n  ]\n}\n";
+        if (failures != 0)
+            std::cerr << failures << " image checks failed" << std::endl;
+        return failures == 0 ? 0 : 1;
+    }
+
+    // one case per line, as RunPerf() writes them
+    bool ReadBaseline(const std::string& path, std::map<std::string, double>& ms)
+    {
+        std::ifstream file(path);
+        if (!file)
+            return false;
+        std::string line;
+        while (std::getline(file, line))
+        {
+            const size_t name = line.find("\"case\": \"");
+            const size_t time = line.find("\"ms\": ");
+            if (name == std::string::npos || time == std::string::npos)
+                continue;
+            const size_t nameStart = name + 9;
+            const size_t nameEnd = line.find('"', nameStart);
+            ms[line.substr(nameStart, nameEnd - nameStart)] = std::stod(line.substr(time + 6));
+        }
+        return true;
+    }
+
+    int RunPerf(const std::string& baselinePath, const Options& options)
+    {
+        std::map<std::string, double> baseline;
+        const bool haveBaseline = !options.mUpdate && ReadBaseline(baselinePath, baseline);
+        if (!haveBaseline)
+            std::cerr << "RegressionTest: " << baselinePath << ": recording a new baseline" << std::endl;
+
+        // single threaded at the default size, the least noisy configuration
+        ImageTarget canvas;
+        Rasterizer rast(&canvas);
+        rast.SetThreadCount(1);
+        CommandBuffer commands;
+        std::ostringstream results;
+        results.setf(std::ios::fixed);
+        results.precision(3);
+        bool first = true;
+        int failures = 0;
+        for (const TestCase& test : BuildCases())
+        {
+            std::vector<double> frameMs;
+            Render(rast, commands, test, CHECKED_FRAME - 1);
+            for (int frame = 0; frame < options.mFrames; frame++)
+                frameMs.push_back(Render(rast, commands, test, CHECKED_FRAME));
+            std::sort(frameMs.begin(), frameMs.end());
+            const double median = frameMs[frameMs.size() / 2];
+
+            const auto old = baseline.find(test.mName);
+            const bool pass = old == baseline.end() || median <= old->second * options.mMaxSlowdown;
+            std::cerr << (pass ? "PASS " : "FAIL ") << test.mName << ": " << median << " ms";
+            if (old != baseline.end())
+                std::cerr << ", baseline " << old->second << " ms, " << median / old->second << "x";
+            std::cerr << std::endl;
+            failures += pass ? 0 : 1;
+
+            results << (first ? "\n" : ",\n");
+            first = false;
+            results << "    { \"case\": \"" << test.mName << "\", \"ms\": " << median;
+            if (old != baseline.end())
+                results << ", \"baseline_ms\": " << old->second << ", \"slowdown\": " << median / old->second;
+            results << " }";
+        }
+
+        const std::string report = "{\n  \"width\": " + std::to_string(rast.Width()) + ",\n  \"height\": "
+            + std::to_string(rast.Height()) + ",\n  \"results\": [" + results.str() + "\n  ]\n}\n";
+        if (MakeDirectory(options.mOutput))
+            std::ofstream(options.mOutput + "/perf.json") << report;
+        if (!haveBaseline)
+        {
+            std::ofstream file(baselinePath);
+            file << report;
+            if (!file)
+            {
+                std::cerr << "RegressionTest: " << baselinePath << ": write failed" << std::endl;
+                return 1;
+            }
+        }
+        if (failures != 0)
+            std::cerr << failures << " cases got slower than " << options.mMaxSlowdown << "x their baseline" << std::endl;
+        return failures == 0 ? 0 : 1;
+    }
+
+    Aabb RandomBox(std::mt19937& random)
+    {
+        std::uniform_real_distribution<float> position(-10.0f, 10.0f);
+        std::uniform_real_distribution<float> size(0.0f, 1.5f);
+        Aabb box;
+        box.mMin = glm::vec3(position(random), position(random), position(random));
+        box.mMax = box.mMin + glm::vec3(size(random), size(random), size(random));
+        return box;
+    }
+
+    // distance along the ray to where it enters the box, or a negative value if it misses;
+    // the same slab test as Bvh::Raycast()
+    float RayEntry(const Aabb& box, const glm::vec3& origin, const glm::vec3& inverse)
+    {
+        const glm::vec3 t0 = (box.mMin - origin) * inverse;
+        const glm::vec3 t1 = (box.mMax - origin) * inverse;
+        const glm::vec3 lo = glm::min(t0, t1);
+        const glm::vec3 hi = glm::max(t0, t1);
+        const float entry = std::max(std::max(lo.x, lo.y), std::max(lo.z, 0.0f));
+        const float exit = std::min(std::min(hi.x, hi.y), hi.z);
+        return entry <= exit ? entry : -1.0f;
+    }
+
+    // The queries of `bvh` against testing every box in `boxes` that is `alive`, indexed by
+    // object id. Boxes touching a frustum plane may go either way, rounding differs there.
+    // Returns the number of mismatches.
+    int CheckBvh(const Bvh& bvh, const std::vector<Aabb>& boxes, const std::vector<uint8_t>& alive, std::mt19937& random)
+    {
+        const int QUERIES = 50;
+        std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+        int failures = 0;
+        std::vector<uint32_t> found;
+        std::vector<uint32_t> expected;
+
+        for (int query = 0; query < QUERIES; query++)
+        {
+            Aabb box = RandomBox(random);
+            box.mMax += glm::vec3(3.0f);
+            found.clear();
+            bvh.QueryBox(box, found);
+            expected.clear();
+            for (uint32_t object = 0; object < boxes.size(); object++)
+            {
+                const Aabb& b = boxes[object];
+                if (alive[object] && b.mMin.x <= box.mMax.x && b.mMax.x >= box.mMin.x
+                    && b.mMin.y <= box.mMax.y && b.mMax.y >= box.mMin.y
+                    && b.mMin.z <= box.mMax.z && b.mMax.z >= box.mMin.z)
+                    expected.push_back(object);
+            }
+            std::sort(found.begin(), found.end());
+            if (found != expected)
+                failures++;
+        }
+
+        for (int query = 0; query < QUERIES; query++)
+        {
+            // a window of a few units somewhere across the boxes, seen from any direction
+            const glm::vec3 axis = glm::normalize(glm::vec3(unit(random), unit(random), unit(random)) + glm::vec3(0.0f, 0.0f, 1e-3f));
+            glm::mat4 m = glm::scale(glm::mat4(1.0f), glm::vec3(0.2f + 0.2f * unit(random), 0.2f + 0.2f * unit(random), 1.0f));
+            m = glm::rotate(m, 3.14159f * unit(random), axis);
+            m = glm::translate(m, glm::vec3(5.0f * unit(random), 5.0f * unit(random), 5.0f * unit(random)));
+            const Frustum frustum = Frustum::FromMatrix(m);
+            found.clear();
+            bvh.QueryFrustum(frustum, found);
+            std::sort(found.begin(), found.end());
+            if (std::adjacent_find(found.begin(), found.end()) != found.end())
+                failures++;
+            for (uint32_t object = 0; object < boxes.size(); object++)
+            {
+                // the corner furthest along each plane, like the tree tests
+                float distance = FLT_MAX;
+                for (const Plane& plane : frustum.mPlanes)
+                {
+                    const glm::vec3 corner(plane.mNormal.x >= 0.0f ? boxes[object].mMax.x : boxes[object].mMin.x,
+                        plane.mNormal.y >= 0.0f ? boxes[object].mMax.y : boxes[object].mMin.y,
+                        plane.mNormal.z >= 0.0f ? boxes[object].mMax.z : boxes[object].mMin.z);
+                    distance = std::min(distance, plane.SignedDistance(corner) / glm::length(plane.mNormal));
+                }
+                const bool isFound = std::binary_search(found.begin(), found.end(), object);
+                if (isFound && (!alive[object] || distance < -1e-3f))
+                    failures++;
+                else if (!isFound && alive[object] && distance > 1e-3f)
+                    failures++;
+            }
+        }
+
+        for (int query = 0; query < QUERIES; query++)
+        {
+            const glm::vec3 origin(12.0f * unit(random), 12.0f * unit(random), 12.0f * unit(random));
+            const glm::vec3 direction = glm::normalize(glm::vec3(unit(random), unit(random), unit(random)) + glm::vec3(1e-3f));
+            const glm::vec3 inverse = 1.0f / direction;
+            float nearest = FLT_MAX;
+            for (uint32_t object = 0; object < boxes.size(); object++)
+            {
+                const float entry = alive[object] ? RayEntry(boxes[object], origin, inverse) : -1.0f;
+                if (entry >= 0.0f)
+                    nearest = std::min(nearest, entry);
+            }
+            float distance = 0.0f;
+            const uint32_t hit = bvh.Raycast(origin, direction, FLT_MAX, &distance);
+            if (hit == INVALID_OBJECT)
+            {
+                if (nearest != FLT_MAX)
+                    failures++;
+            }
+            else if (hit >= boxes.size() || !alive[hit] || distance != nearest || RayEntry(boxes[hit], origin, inverse) != nearest)
+            {
+                failures++;
+            }
+        }
+        return failures;
+    }
+
+    // Bvh queries after Build(), and after each of the ways the tree changes without one
+    int RunBvh()
+    {
+        std::mt19937 random(39);
+        std::vector<Aabb> boxes;
+        std::vector<uint8_t> alive;
+        int failures = 0;
+        auto check = [&](const std::string& step, const Bvh& bvh) {
+            const size_t live = static_cast<size_t>(std::count(alive.begin(), alive.end(), 1));
+            const int differing = CheckBvh(bvh, boxes, alive, random) + (bvh.ObjectCount() == live ? 0 : 1);
+            std::cout << (differing == 0 ? "PASS" : "FAIL") << " bvh " << step << ": " << live << " objects, "
+                << bvh.NodeCount() << " nodes, " << differing << " mismatches" << std::endl;
+            failures += differing != 0;
+        };
+
+        // grown by Insert() alone, from empty
+        Bvh inserted;
+        for (int i = 0; i < 1000; i++)
+        {
+            boxes.push_back(RandomBox(random));
+            alive.push_back(1);
+            if (inserted.Insert(boxes.back()) != boxes.size() - 1)
+                failures++;
+        }
+        check("insert into empty", inserted);
+
+        boxes.clear();
+        alive.clear();
+        for (int i = 0; i < 2000; i++)
+        {
+            boxes.push_back(RandomBox(random));
+            alive.push_back(1);
+        }
+        Bvh bvh;
+        bvh.Build(boxes.data(), boxes.size());
+        check("build", bvh);
+
+        for (int i = 0; i < 500; i++)
+        {
+            boxes.push_back(RandomBox(random));
+            alive.push_back(1);
+            if (bvh.Insert(boxes.back()) != boxes.size() - 1)
+                failures++;
+        }
+        check("insert", bvh);
+
+        std::vector<uint32_t> removed;
+        for (uint32_t object = 0; object < boxes.size(); object += 3)
+        {
+            bvh.Remove(object);
+            alive[object] = 0;
+            removed.push_back(object);
+        }
+        check("remove", bvh);
+
+        // removed ids come back before new ones
+        for (size_t i = 0; i < removed.size() / 2; i++)
+        {
+            const Aabb box = RandomBox(random);
+            const uint32_t object = bvh.Insert(box);
+            if (object >= boxes.size() || alive[object])
+            {
+                std::cout << "FAIL bvh reinsert: got id " << object << ", not a removed one" << std::endl;
+                return 1;
+            }
+            boxes[object] = box;
+            alive[object] = 1;
+        }
+        check("reinsert", bvh);
+
+        // every other object moves somewhere else entirely
+        for (uint32_t object = 0; object < boxes.size(); object += 2)
+        {
+            boxes[object] = RandomBox(random);
+            bvh.SetBounds(object, boxes[object]);
+        }
+        bvh.Refit();
+        check("refit", bvh);
+
+        bvh.Clear();
+        std::fill(alive.begin(), alive.end(), 0);
+        check("clear", bvh);
+        return failures == 0 ? 0 : 1;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc == 2 && std::string(argv[1]) == "bvh")
+        return RunBvh();
+    if (argc < 3)
+    {
+        PrintUsage();
+        return 1;
+    }
+    const std::string mode = argv[1];
+    const std::string path = argv[2];
+    Options options;
+    for (int arg = 3; arg < argc; arg++)
+    {
+        const std::string option = argv[arg];
+        if (option == "--update")
+        {
+            options.mUpdate = true;
+            continue;
+        }
+        if (arg + 1 >= argc)
+        {
+            PrintUsage();
+            return 1;
+        }
+        const std::string value = argv[++arg];
+        if (option == "--output")
+            options.mOutput = value;
+        else if (option == "--tolerance")
+            options.mTolerance = std::stoi(value);
+        else if (option == "--max-bad-pixels")
+            options.mMaxBadPixels = std::stod(value);
+        else if (option == "--max-slowdown")
+            options.mMaxSlowdown = std::stod(value);
+        else if (option == "--frames")
+            options.mFrames = std::max(std::stoi(value), 1);
+        else
+        {
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    if (mode == "images")
+        return RunImages(path, options);
+    if (mode == "perf")
+        return RunPerf(path, options);
+    PrintUsage();
+    return 1;
+}
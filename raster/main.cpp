@@ -1,144 +1,64 @@
 #include <SFML/Graphics.hpp>
 #include <iostream>
-#include <algorithm>
-#include <functional>
+#include <cmath>
+#include "Rasterizer.h"
+#include "RenderTarget.h"
 
-struct Triangle
-{
-    Triangle(sf::Vector2i p1, sf::Vector2i p2, sf::Vector2i p3)
-        : mP1(p1), mP2(p2), mP3(p3)
-    {
-    }
-    sf::Vector2i mP1;
-    sf::Vector2i mP2;
-    sf::Vector2i mP3;
-};
+// 2D test of the triangle setup: drag the corners of a triangle with the mouse
 
+constexpr int WINDOW_WIDTH = 1600;
+constexpr int WINDOW_HEIGHT = 900;
 
-class Rasterizer 
+// uploads every flushed frame to the texture the window shows
+class TextureTarget : public RenderTarget
 {
-private:
-    sf::Image* mCanvas;
-    bool mDebugColors;
-    std::function<sf::Color(int, int)> mColorCb;
-
 public:
+    sf::Texture mTexture;
 
-    void DrawLine(uint16_t sx, uint16_t sy, uint16_t ex, const sf::Color& color)
-    {
-        ex = std::min(static_cast<uint16_t>(mCanvas->getSize().x), ex);
-
-        for (uint16_t cx = sx; cx < ex; cx++)
-        {
-            mCanvas->setPixel(cx, sy, color);
-        }
-    }
-
-    void DrawLine(uint16_t sx, uint16_t sy, uint16_t ex)
-    {
-        ex = std::min(static_cast<uint16_t>(mCanvas->getSize().x), ex);
-
-        for (uint16_t cx = sx; cx < ex; cx++)
-        {
-            mCanvas->setPixel(cx, sy, mColorCb(cx, sy));
-        }
-    }
-
-    inline static int LerpVer(const sf::Vector2i& A, const sf::Vector2i distance, int y)
-    {
-        int dis = y - A.y;
-        return A.x + (distance.x) * dis / distance.y;
-    }
-
-    void DrawTriangle(Triangle t)
-    {
-        //sort so we got the points on the top, as p1..p2, 
-        if (t.mP2.y > t.mP3.y) std::swap(t.mP2, t.mP3);
-        if (t.mP1.y > t.mP2.y) std::swap(t.mP1, t.mP2);
-        if (t.mP2.y > t.mP3.y) std::swap(t.mP2, t.mP3);
-
-        //pick the longer side
-        std::pair<sf::Vector2i&, sf::Vector2i> longerPair = {
-            t.mP1,
-            //std::abs(t.mP1.x - t.mP2.x) + std::abs(t.mP1.y - t.mP2.y) > std::abs(t.mP1.x - t.mP3.x) + std::abs(t.mP1.y - t.mP3.y) ?
-            t.mP3,
-        };
-
-
-        const sf::Vector2i longerSideDistance = t.mP1 - t.mP3;
-        const sf::Vector2i shorterSideDistance = t.mP1 - t.mP2;
-        const sf::Vector2i bottomSideDistance = t.mP2 - t.mP3;
-
-        for (size_t i = t.mP1.y; i < t.mP2.y; i++)
-        {
-            int sx = LerpVer(t.mP1, longerSideDistance, i);
-            int ex = LerpVer(t.mP2, shorterSideDistance, i);
-            if (sx > ex)
-                std::swap(sx, ex);
-
-           DrawLine(sx, i, ex);
-
-        }
-        for (size_t i = t.mP2.y; i < t.mP3.y; i++)
-        {
-            int sx = LerpVer(t.mP1, longerSideDistance, i);
-            int ex = LerpVer(t.mP2, bottomSideDistance, i);
-            if (sx > ex)
-                std::swap(sx, ex);
-
-            DrawLine(sx, i, ex);
-        }
-    }
-
-    Rasterizer(sf::Image* sourceImage, std::function<sf::Color(int, int)> colorCb = [](int x, int y) {return sf::Color::Green; }, bool useDebugColors = false)
-        : mBitmap(sourceImage),
-          mColorCb(colorCb),
-          mDebugColors(useDebugColors)
-    {
-
-    }
-    ~Rasterizer()
+    void Present(const uint8_t* rgba, int width, int height) override
     {
+        if (mTexture.getSize() != sf::Vector2u(width, height))
+            mTexture.create(width, height);
+        mTexture.update(rgba);
     }
 };
 
 int main()
 {
-
     sf::Vector2i A(7, 0);
     sf::Vector2i B(12, 11);
     sf::Vector2i C(1, 8);
-    sf::RenderWindow window(sf::VideoMode(1600, 900), "Basic renderer test");
+    sf::RenderWindow window(sf::VideoMode(WINDOW_WIDTH, WINDOW_HEIGHT), "Basic renderer test");
 
     A *= 20;
     B *= 20;
     C *= 20;
 
+    TextureTarget canvas;
+    Rasterizer rast(&canvas);
+    rast.Resize(WINDOW_WIDTH, WINDOW_HEIGHT);
+    rast.SetShader([](int, int, float, const glm::mat4&, int, int) { return Color::Red; });
 
-    sf::Image canvasBuffer;
-    canvasBuffer.create(1600, 900, sf::Color::White);
-
-    Triangle triangle = { C,B,A };
-    Rasterizer rast(&canvasBuffer, [&](int x, int y) {
-        return sf::Color::Red;
-    });
-
-    auto trianglePositions = { &triangle.mP1, &triangle.mP2, &triangle.mP3};
-
-    rast.DrawTriangle(triangle);
+    auto trianglePositions = { &C, &B, &A };
 
-    sf::Texture texture;
-    texture.loadFromImage(canvasBuffer);
-    sf::Sprite mySprite(texture);
-
-    auto Distance = [&](const sf::Vector2i& a, const sf::Vector2i& b)
+    // corners are in pixels, DrawTriangle() takes normalized device coordinates
+    auto DrawCanvas = [&]()
         {
-            return sqrtf((a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y));
+            auto ToNdc = [](const sf::Vector2i& p)
+                {
+                    return Vector3(p.x * 2.0f / WINDOW_WIDTH - 1.0f, p.y * 2.0f / WINDOW_HEIGHT - 1.0f, 0.0f);
+                };
+            rast.Clear();
+            rast.DrawTriangle(Triangle(ToNdc(C), ToNdc(B), ToNdc(A)));
+            rast.Flush();
         };
 
-    auto ClearCanvas = [](sf::Image& canvas)
+    DrawCanvas();
+    sf::Sprite mySprite(canvas.mTexture);
+
+    auto Distance = [&](const sf::Vector2i& a, const sf::Vector2i& b)
         {
-            canvas.create(1600, 900, sf::Color::White);
+            return std::sqrt(static_cast<float>((a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y)));
         };
 
 
@@ -170,10 +90,8 @@ int main()
                 {
                     focusedVertex->x = sf::Mouse::getPosition(window).x;
                     focusedVertex->y = sf::Mouse::getPosition(window).y;
-                    ClearCanvas(canvasBuffer);
-                    rast.DrawTriangle(triangle);
-                    texture.loadFromImage(canvasBuffer);
-                    mySprite.setTexture(texture);
+                    DrawCanvas();
+                    mySprite.setTexture(canvas.mTexture, true);
                 }
             }
 
@@ -194,7 +112,7 @@ int main()
             sf::CircleShape s;
             s.setPosition(sf::Vector2f(*p));
             s.setRadius(2.0f);
-            s.setFillColor(sf::Color::Black);
+            s.setFillColor(sf::Color::White);
             window.draw(s);
         }
 
@@ -202,4 +120,4 @@ int main()
     }
 
     return 0;
-}
\ No newline at end of file
+}